@@ -110,6 +110,7 @@ static class Sim86
         Segment = 0x4,
         Wide = 0x8,
         Far = 0x10,
+        RepNE = 0x20,
     };
 
     [Flags]
@@ -284,7 +285,7 @@ static class Sim86
         public static extern void Sim86_Get8086InstructionTable(out InstructionTable Dest);
     }
 
-    public const int Version = 3;
+    public const int Version = 4;
 
     public static uint GetVersion()
     {
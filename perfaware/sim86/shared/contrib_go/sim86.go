@@ -111,6 +111,7 @@ const (
 	InstSegment InstructionFlag = 0x04
 	InstWide    InstructionFlag = 0x08
 	InstFar     InstructionFlag = 0x10
+	InstRepNE   InstructionFlag = 0x20
 )
 
 type RegisterAccess struct {
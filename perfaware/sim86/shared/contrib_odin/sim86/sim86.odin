@@ -4,7 +4,7 @@ package sim86
 when ODIN_OS == .Windows { foreign import sim86 "./sim86_shared_debug.lib" }
 when ODIN_OS == .Linux { foreign import sim86 "./sim86_shared_debug.a" }
 
-SIM86_VERSION : u32 : 3
+SIM86_VERSION : u32 : 4
 
 Operation_Type :: enum u32 {
 	None,
@@ -140,6 +140,7 @@ Inst_Rep     : u32 : 0x2
 Inst_Segment : u32 : 0x4
 Inst_Wide    : u32 : 0x8
 Inst_Far     : u32 : 0x10
+Inst_RepNE   : u32 : 0x20
 
 Register_Access :: struct {
 	index: u32,
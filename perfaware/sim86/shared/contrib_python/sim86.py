@@ -8,7 +8,7 @@ from dataclasses import dataclass, fields
 
 ### public interface
 
-VERSION = 3
+VERSION = 4
 
 OperationType = IntEnum("OperationType", """
   none mov push pop xchg in out xlat lea lds les lahf sahf
@@ -21,7 +21,7 @@ OperationType = IntEnum("OperationType", """
 """.split(), start=0)
  
 InstructionFlag = IntFlag("InstructionFlag", """
-  lock rep segment wide far
+  lock rep segment wide far rep_ne
 """.split())
 
 EffectiveAddressFlag = IntFlag("EffectiveAddressFlag", """
@@ -11,6 +11,8 @@
    ======================================================================== */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "sim86_shared.h"
 #pragma comment (lib, "sim86_shared_debug.lib")
@@ -66,5 +68,75 @@ int main(void)
         }
     }
     
+    instruction Batch[256];
+    u32 BatchCount = 0;
+    u32 BatchBytesConsumed = 0;
+    Sim86_DecodeBuffer(sizeof(ExampleDisassembly), ExampleDisassembly, sizeof(Batch)/sizeof(Batch[0]), Batch, &BatchCount, &BatchBytesConsumed);
+    printf("Batch decode: %u instructions from %u of %u bytes\n", BatchCount, BatchBytesConsumed, (u32)sizeof(ExampleDisassembly));
+    
+    // NOTE: The stream passes must agree with the same buffer decoded by Sim86_DecodeBuffer.
+    u32 Capacity = sizeof(Batch)/sizeof(Batch[0]);
+    void *StreamMemory = malloc(Sim86_GetInstructionStreamBytes(Capacity));
+    instruction_stream Stream;
+    Sim86_InstructionStreamFromMemory(Capacity, StreamMemory, &Stream);
+    
+    u32 StreamCount = 0;
+    u32 StreamBytesConsumed = 0;
+    Sim86_DecodeBufferToStream(sizeof(ExampleDisassembly), ExampleDisassembly, &Stream, &StreamCount, &StreamBytesConsumed);
+    
+    u32 MismatchCount = (StreamCount != BatchCount) || (StreamBytesConsumed != BatchBytesConsumed);
+    
+    u32 Histogram[Op_Count] = {};
+    u32 ExpectedHistogram[Op_Count] = {};
+    u32 AddIndices[256];
+    u32 MemoryIndices[256];
+    u32 ExpectedAddCount = 0;
+    u32 ExpectedMemoryCount = 0;
+    u64 ExpectedSizes = 0;
+    
+    Sim86_CountOps(&Stream, Histogram);
+    u32 AddCount = Sim86_FilterByOp(&Stream, Op_add, AddIndices);
+    u32 MemoryCount = Sim86_FilterByOperandType(&Stream, Operand_Memory, MemoryIndices);
+    u64 Sizes = Sim86_SumSizes(&Stream);
+    
+    for(u32 Index = 0; Index < BatchCount; ++Index)
+    {
+        instruction Expected = Batch[Index];
+        if(Index < StreamCount)
+        {
+            instruction FromStream;
+            Sim86_GetStreamInstruction(&Stream, Index, &FromStream);
+            MismatchCount += (memcmp(&FromStream, &Expected, sizeof(Expected)) != 0);
+        }
+        
+        ++ExpectedHistogram[Expected.Op];
+        ExpectedSizes += Expected.Size;
+        
+        if(Expected.Op == Op_add)
+        {
+            MismatchCount += ((ExpectedAddCount >= AddCount) || (AddIndices[ExpectedAddCount] != Index));
+            ++ExpectedAddCount;
+        }
+        
+        if((Expected.Operands[0].Type == Operand_Memory) || (Expected.Operands[1].Type == Operand_Memory))
+        {
+            MismatchCount += ((ExpectedMemoryCount >= MemoryCount) || (MemoryIndices[ExpectedMemoryCount] != Index));
+            ++ExpectedMemoryCount;
+        }
+    }
+    
+    MismatchCount += (memcmp(Histogram, ExpectedHistogram, sizeof(Histogram)) != 0);
+    MismatchCount += (AddCount != ExpectedAddCount) + (MemoryCount != ExpectedMemoryCount) + (Sizes != ExpectedSizes);
+    
+    printf("Stream decode: %u instructions, %u add, %u with a memory operand, %llu bytes\n",
+           StreamCount, AddCount, MemoryCount, Sizes);
+    free(StreamMemory);
+    
+    if(MismatchCount)
+    {
+        printf("ERROR: The instruction stream does not match Sim86_DecodeBuffer.\n");
+        return -1;
+    }
+    
     return 0;
 }
@@ -10,7 +10,10 @@ typedef long long s64;
 
 typedef s32 b32;
 
-static u32 const SIM86_VERSION = 3;
+typedef float f32;
+typedef double f64;
+
+static u32 const SIM86_VERSION = 4;
 enum operation_type : u32
 {
     Op_None,
@@ -148,6 +151,7 @@ enum instruction_flag : u32
     Inst_Segment = 0x4,
     Inst_Wide = 0x8,
     Inst_Far = 0x10,
+    Inst_RepNE = 0x20,
 };
 
 struct register_access
@@ -262,8 +266,77 @@ struct instruction_table
     u32 MaxInstructionByteCount;
 };
 
+enum packed_operand_flag : u8
+{
+    PackedOperand_TypeMask = 0x3,
+    PackedOperand_RelativeJump0 = 0x10,
+    PackedOperand_RelativeJump1 = 0x20,
+    PackedOperand_Negative0 = 0x40,
+    PackedOperand_Negative1 = 0x80,
+};
+
+enum packed_register_flag : u8
+{
+    PackedRegister_IndexMask = 0xf,
+    PackedRegister_High = 0x10,
+    PackedRegister_Wide = 0x20,
+
+    PackedAddress_Intersegment = 0xff,
+};
+
+struct packed_instruction
+{
+    u32 Address;
+    u8 Op;
+    u8 SizeAndSegment;
+    u8 Flags;
+    u8 OperandTypes;
+    u8 OperandRegisters[2];
+    u16 OperandValues[2];
+    u16 Reserved;
+};
+
+enum instruction_stream_operand_flag : u8
+{
+    StreamOperand_TypeMask = 0x3,
+    StreamOperand_RelativeJump = 0x10,
+};
+
+struct instruction_stream
+{
+    u32 Capacity;
+    u32 Count;
+
+    u32 *Address;
+    u8 *Size;
+    u8 *Op;
+    u8 *Flags;
+    u8 *SegmentOverride;
+
+    u8 *OperandType[2];
+    u8 *OperandRegister[2];
+    s32 *Displacement[2];
+    s32 *Immediate[2];
+};
+
 extern "C" u32 Sim86_GetVersion(void);
 extern "C" void Sim86_Decode8086Instruction(u32 SourceSize, u8 *Source, instruction *Dest);
+extern "C" void Sim86_DecodeBuffer(u32 SourceSize, u8 *Source, u32 MaxCount, instruction *Dest,
+                                   u32 *OutCount, u32 *OutBytesConsumed);
+extern "C" void Sim86_DecodeBufferPacked(u32 SourceSize, u8 *Source, u32 MaxCount, packed_instruction *Dest,
+                                         u32 *OutCount, u32 *OutBytesConsumed);
+extern "C" u64 Sim86_GetInstructionStreamBytes(u32 Capacity);
+extern "C" void Sim86_InstructionStreamFromMemory(u32 Capacity, void *Memory, instruction_stream *Dest);
+extern "C" void Sim86_DecodeBufferToStream(u32 SourceSize, u8 *Source, instruction_stream *Stream,
+                                           u32 *OutCount, u32 *OutBytesConsumed);
+extern "C" void Sim86_GetStreamInstruction(instruction_stream *Stream, u32 Index, instruction *Dest);
+extern "C" void Sim86_CountOps(instruction_stream *Stream, u32 *Histogram);
+extern "C" u32 Sim86_FilterByOp(instruction_stream *Stream, operation_type Op, u32 *Indices);
+extern "C" u32 Sim86_FilterByOperandType(instruction_stream *Stream, operand_type Type, u32 *Indices);
+extern "C" u64 Sim86_SumSizes(instruction_stream *Stream);
+extern "C" u32 Sim86_CompressInstruction(instruction *Source, packed_instruction *Dest);
+extern "C" void Sim86_ExpandInstruction(packed_instruction *Source, instruction *Dest);
+extern "C" u32 Sim86_GetInstructionLength(u32 SourceSize, u8 *Source);
 extern "C" char const *Sim86_RegisterNameFromOperand(register_access *RegAccess);
 extern "C" char const *Sim86_MnemonicFromOperationType(operation_type Type);
 extern "C" void Sim86_Get8086InstructionTable(instruction_table *Dest);
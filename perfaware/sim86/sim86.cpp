@@ -24,6 +24,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #include "sim86_instruction.h"
@@ -31,16 +32,45 @@
 #include "sim86_memory.h"
 #include "sim86_text.h"
 #include "sim86_decode.h"
+#include "sim86_decode_specialized.h"
+#include "sim86_packed.h"
+#include "sim86_platform.h"
+#include "sim86_counters.h"
+#include "sim86_profiler.h"
+#include "sim86_disasm.h"
+#include "sim86_parallel.h"
+#include "sim86_pipeline.h"
+#include "sim86_index.h"
+#include "sim86_block_cache.h"
+#include "sim86_execute.h"
+#include "sim86_threaded.h"
+#include "sim86_jit.h"
 
 #include "sim86_instruction.cpp"
 #include "sim86_instruction_table.cpp"
 #include "sim86_memory.cpp"
 #include "sim86_text.cpp"
 #include "sim86_decode.cpp"
+#include "sim86_decode_specialized.cpp"
+#include "sim86_packed.cpp"
+#include "sim86_platform.cpp"
+#include "sim86_counters.cpp"
+#include "sim86_profiler.cpp"
+#include "sim86_disasm.cpp"
+#include "sim86_parallel.cpp"
+#include "sim86_pipeline.cpp"
+#include "sim86_index.cpp"
+#include "sim86_block_cache.cpp"
+#include "sim86_execute.cpp"
+#include "sim86_threaded.cpp"
+#include "sim86_jit.cpp"
 
-static u32 LoadMemoryFromFile(char *FileName, segmented_access SegMem, u32 AtOffset)
+static b32 LoadMemoryFromFile(char *FileName, segmented_access SegMem, u32 AtOffset, u32 *BytesRead)
 {
-    u32 Result = 0;
+    TimeFunction;
+    
+    b32 Result = false;
+    *BytesRead = 0;
     
     // NOTE(casey): Because we are simulating a machine, we only attempt to load as
     // much of a file as will fit into that machine's memory. 
@@ -52,13 +82,22 @@ static u32 LoadMemoryFromFile(char *FileName, segmented_access SegMem, u32 AtOff
     FILE *File = fopen(FileName, "rb");
     if(File)
     {
-        Result = fread(SegMem.Memory + BaseAddress, 1, MaxBytes, File);
+        *BytesRead = fread(SegMem.Memory + BaseAddress, 1, MaxBytes, File);
+        CountProfileBytes(*BytesRead);
         fclose(File);
+        Result = true;
     }
-    else
+    
+    // NOTE: The decoder can look up to 20 bytes past an instruction that is cut off by the
+    // end of the file. Those bytes are cleared so that what it finds does not depend on
+    // which file was loaded into this memory before (which would make -j output differ
+    // from a serial run).
+    u32 ClearCount = MaxBytes - *BytesRead;
+    if(ClearCount > 32)
     {
-        fprintf(stderr, "ERROR: Unable to open %s.\n", FileName);
+        ClearCount = 32;
     }
+    memset(SegMem.Memory + BaseAddress + *BytesRead, 0, ClearCount);
     
     return Result;
 }
@@ -78,60 +117,602 @@ static segmented_access AllocateMemoryPow2(u32 SizePow2)
     return Result;
 }
 
-static void DisAsm8086(u32 DisAsmByteCount, segmented_access DisAsmStart)
+static void ReportOpenFailure(text_buffer *Output, char *FileName)
+{
+    FlushTextBuffer(Output);
+    fprintf(stderr, "ERROR: Unable to open %s.\n", FileName);
+}
+
+struct file_job
+{
+    char *FileName;
+    b32 Opened;
+    disasm_stop Stop;
+    text_buffer Text;
+};
+
+struct file_jobs
+{
+    decode_instruction *Decode;
+    output_format Format;
+    segmented_access *ThreadMemory;
+    file_job *Jobs;
+};
+
+static void DisAsmFileJob(void *Context, u32 ThreadIndex, u32 JobIndex)
+{
+    file_jobs *Jobs = (file_jobs *)Context;
+    file_job *Job = &Jobs->Jobs[JobIndex];
+    segmented_access Memory = Jobs->ThreadMemory[ThreadIndex];
+    
+    u32 BytesRead;
+    Job->Opened = LoadMemoryFromFile(Job->FileName, Memory, 0, &BytesRead);
+    
+    // NOTE: The whole file's text is kept until it is this file's turn to be written, so the
+    // buffer is sized for the worst case (see GetMaxOutputPerByte). The file name appears
+    // twice in JSON output, and every byte of it may need escaping.
+    u64 TextSize = 64 + 16*strlen(Job->FileName) + (u64)GetMaxOutputPerByte(Jobs->Format)*BytesRead;
+    Job->Text = TextBuffer((u32)TextSize, (char *)malloc(TextSize));
+    if(Job->Text.Memory)
+    {
+        AppendDisAsmFileBegin(&Job->Text, Jobs->Format, Job->FileName);
+        Job->Stop = DisAsm8086(BytesRead, Memory, Jobs->Decode, &Job->Text, Jobs->Format);
+    }
+}
+
+static void DisAsmFilesInParallel(u32 FileCount, char **FileNames, decode_instruction *Decode,
+                                  u32 JobThreadCount, text_buffer *Output, output_format Format)
 {
-    segmented_access At = DisAsmStart;
+    // NOTE: Files are handed out to the threads in waves, a few per thread so that one big
+    // file does not hold everyone up, and each wave is written out in command line order
+    // once it is done. Every thread loads into its own copy of the 8086 memory.
+    u32 MaxJobCount = 4*JobThreadCount;
+    
+    file_jobs Jobs = {};
+    Jobs.Decode = Decode;
+    Jobs.Format = Format;
+    Jobs.ThreadMemory = (segmented_access *)calloc(JobThreadCount, sizeof(segmented_access));
+    Jobs.Jobs = (file_job *)calloc(MaxJobCount, sizeof(file_job));
     
-    instruction_table Table = Get8086InstructionTable();
+    b32 Allocated = (Jobs.ThreadMemory && Jobs.Jobs);
+    for(u32 ThreadIndex = 0; Allocated && (ThreadIndex < JobThreadCount); ++ThreadIndex)
+    {
+        Jobs.ThreadMemory[ThreadIndex] = AllocateMemoryPow2(20);
+        Allocated = IsValid(Jobs.ThreadMemory[ThreadIndex]);
+    }
     
-    u32 Count = DisAsmByteCount;
-    while(Count)
+    if(Allocated)
     {
-        instruction Instruction = DecodeInstruction(Table, At);
-        if(Instruction.Op)
+        for(u32 FirstFile = 0; FirstFile < FileCount; FirstFile += MaxJobCount)
         {
-            if(Count >= Instruction.Size)
+            u32 JobCount = FileCount - FirstFile;
+            if(JobCount > MaxJobCount)
             {
-                At = MoveBaseBy(At, Instruction.Size);
-                Count -= Instruction.Size;
+                JobCount = MaxJobCount;
             }
-            else
+            
+            for(u32 JobIndex = 0; JobIndex < JobCount; ++JobIndex)
             {
-                fprintf(stderr, "ERROR: Instruction extends outside disassembly region\n");
-                break;
+                Jobs.Jobs[JobIndex] = {};
+                Jobs.Jobs[JobIndex].FileName = FileNames[FirstFile + JobIndex];
             }
             
-            PrintInstruction(Instruction, stdout);
-            printf("\n");
+            RunInParallel(JobThreadCount, JobCount, DisAsmFileJob, &Jobs);
+            
+            for(u32 JobIndex = 0; JobIndex < JobCount; ++JobIndex)
+            {
+                file_job *Job = &Jobs.Jobs[JobIndex];
+                if(!Job->Opened)
+                {
+                    ReportOpenFailure(Output, Job->FileName);
+                }
+                
+                if(Job->Text.Memory)
+                {
+                    AppendText(Output, Job->Text.Used, Job->Text.Memory);
+                    ReportDisAsmStop(Output, Job->Stop);
+                    AppendDisAsmFileEnd(Output, Format, Job->FileName, Job->Stop);
+                    free(Job->Text.Memory);
+                }
+                else
+                {
+                    FlushTextBuffer(Output);
+                    fprintf(stderr, "ERROR: Unable to allocate memory for %s.\n", Job->FileName);
+                }
+            }
         }
-        else
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: Unable to allocate memory for -j.\n");
+    }
+    
+    if(Jobs.ThreadMemory)
+    {
+        for(u32 ThreadIndex = 0; ThreadIndex < JobThreadCount; ++ThreadIndex)
+        {
+            if(IsValid(Jobs.ThreadMemory[ThreadIndex]))
+            {
+                free(Jobs.ThreadMemory[ThreadIndex].Memory);
+            }
+        }
+    }
+    free(Jobs.ThreadMemory);
+    free(Jobs.Jobs);
+}
+
+static void ExecuteFile(char *FileName, segmented_access Memory, block_cache *Cache, threaded_code *Threaded,
+                        jit *Jit, b32 EagerFlags, u64 InstructionLimit, decode_instruction *Decode, text_buffer *Output)
+{
+    // NOTE: Every program starts from zeroed memory and registers, loaded at address 0.
+    memset(Memory.Memory, 0, GetHighestAddress(Memory) + 1);
+    
+    u32 BytesRead;
+    if(LoadMemoryFromFile(FileName, Memory, 0, &BytesRead))
+    {
+        cpu_8086 CPU = CPU8086(Memory, BytesRead);
+        CPU.Cache = Cache;
+        CPU.Threaded = Threaded;
+        CPU.Jit = Jit;
+        CPU.EagerFlags = EagerFlags;
+        CPU.InstructionLimit = InstructionLimit;
+        if(Cache)
+        {
+            Cache->Stats = {};
+        }
+        if(Threaded)
+        {
+            Threaded->Stats = {};
+        }
+        if(Jit)
+        {
+            Jit->Stats = {};
+        }
+        
+        f64 StartTime = GetWallClockSeconds();
+        execute_stop Stop = Execute8086(&CPU, Get8086InstructionTable(), Decode);
+        f64 Seconds = GetWallClockSeconds() - StartTime;
+        
+        FlushTextBuffer(Output);
+        fprintf(stdout, "--- %s execution ---\n", FileName);
+        fprintf(stdout, "Final registers:\n");
+        PrintRegisters(stdout, &CPU);
+        fflush(stdout);
+        
+        ReportExecuteStop(&CPU, Stop);
+        f64 MIPS = (Seconds > 0) ? ((f64)CPU.InstructionCount / (1000000.0*Seconds)) : 0;
+        fprintf(stderr, "%s: %llu instructions, %.3fs (%.1f MIPS)\n", FileName, CPU.InstructionCount, Seconds, MIPS);
+        if(Cache)
+        {
+            PrintBlockCacheStats(stderr, FileName, &Cache->Stats);
+        }
+        if(Threaded)
+        {
+            PrintThreadedStats(stderr, FileName, &Threaded->Stats);
+        }
+        if(Jit)
         {
-            fprintf(stderr, "ERROR: Unrecognized binary in instruction stream.\n");
-            break;
+            PrintJitStats(stderr, FileName, &Jit->Stats, CPU.InstructionCount);
         }
     }
+    else
+    {
+        ReportOpenFailure(Output, FileName);
+    }
 }
 
 int main(int ArgCount, char **Args)
 {
+    BeginProfile();
+    
+    decode_instruction *Decode = DecodeInstruction;
+    output_format Format = OutputFormat_Text;
+    b32 MapFiles = false;
+    b32 UseIndex = false;
+    u32 ThreadCount = 0;
+    u32 FormatThreadCount = 0;
+    u32 JobThreadCount = 0;
+    b32 ReadsStandardInput = false;
+    b32 UseCounters = false;
+    b32 Execute = false;
+    b32 UseBlockCache = true;
+    b32 UseJit = false;
+    b32 UseThreaded = false;
+    b32 EagerFlags = false;
+    
+    // NOTE: Programs that never halt (listing 41 loops forever once ZF is clear) would
+    // otherwise run until killed. Zero means no limit.
+    u64 InstructionLimit = 100000000;
+    b32 LimitGiven = false;
+    b32 ValidArgs = true;
+    
+    u32 FileCount = 0;
+    char **FileNames = (char **)malloc(ArgCount*sizeof(char *));
+    
+    for(int ArgIndex = 1; ArgIndex < ArgCount; ++ArgIndex)
+    {
+        char *Arg = Args[ArgIndex];
+        if(strcmp(Arg, "--decoder=table") == 0)
+        {
+            Decode = DecodeInstruction;
+        }
+        else if(strcmp(Arg, "--decoder=specialized") == 0)
+        {
+            Decode = DecodeInstructionSpecialized;
+        }
+        else if(strcmp(Arg, "--format=text") == 0)
+        {
+            Format = OutputFormat_Text;
+        }
+        else if(strcmp(Arg, "--format=bin") == 0)
+        {
+            Format = OutputFormat_Binary;
+        }
+        else if(strcmp(Arg, "--format=jsonl") == 0)
+        {
+            Format = OutputFormat_JSONLines;
+        }
+        else if(strcmp(Arg, "--mmap") == 0)
+        {
+            MapFiles = true;
+        }
+        else if(strcmp(Arg, "--index") == 0)
+        {
+            // NOTE: The index is built from, and checked against, the whole file, so it
+            // also works from a mapped file.
+            UseIndex = true;
+            MapFiles = true;
+        }
+        else if(strncmp(Arg, "--threads=", 10) == 0)
+        {
+            // NOTE: Parallel disassembly needs the whole image in a flat buffer, so it
+            // always works from a mapped file.
+            ThreadCount = atoi(Arg + 10);
+            MapFiles = true;
+            if((ThreadCount < 1) || (ThreadCount > 256))
+            {
+                fprintf(stderr, "ERROR: --threads must be between 1 and 256.\n");
+                ValidArgs = false;
+            }
+        }
+        else if(strncmp(Arg, "--pipeline=", 11) == 0)
+        {
+            // NOTE: The pipeline decodes from a flat buffer too. It runs a decode and a
+            // write thread besides the format threads.
+            FormatThreadCount = atoi(Arg + 11);
+            MapFiles = true;
+            if((FormatThreadCount < 1) || (FormatThreadCount > 254))
+            {
+                fprintf(stderr, "ERROR: --pipeline must be between 1 and 254.\n");
+                ValidArgs = false;
+            }
+        }
+        else if(strcmp(Arg, "--exec") == 0)
+        {
+            Execute = true;
+        }
+        else if(strcmp(Arg, "--no-block-cache") == 0)
+        {
+            UseBlockCache = false;
+        }
+        else if(strcmp(Arg, "--jit") == 0)
+        {
+            UseJit = true;
+        }
+        else if(strcmp(Arg, "--dispatch=switch") == 0)
+        {
+            UseThreaded = false;
+        }
+        else if(strcmp(Arg, "--dispatch=threaded") == 0)
+        {
+            UseThreaded = true;
+        }
+        else if(strncmp(Arg, "--limit=", 8) == 0)
+        {
+            char *End = 0;
+            InstructionLimit = strtoull(Arg + 8, &End, 10);
+            LimitGiven = true;
+            if((End == (Arg + 8)) || *End)
+            {
+                fprintf(stderr, "ERROR: --limit must be a number of instructions (0 for no limit).\n");
+                ValidArgs = false;
+            }
+        }
+        else if(strcmp(Arg, "--eager-flags") == 0)
+        {
+            EagerFlags = true;
+        }
+        else if(strcmp(Arg, "--counters") == 0)
+        {
+            UseCounters = true;
+        }
+        else if(strncmp(Arg, "-j", 2) == 0)
+        {
+            // NOTE: Accepts both "-j N" and "-jN".
+            char *Count = Arg + 2;
+            if(!*Count && ((ArgIndex + 1) < ArgCount))
+            {
+                Count = Args[++ArgIndex];
+            }
+            
+            JobThreadCount = atoi(Count);
+            if((JobThreadCount < 1) || (JobThreadCount > 256))
+            {
+                fprintf(stderr, "ERROR: -j must be between 1 and 256.\n");
+                ValidArgs = false;
+            }
+        }
+        else if(strncmp(Arg, "--", 2) == 0)
+        {
+            fprintf(stderr, "ERROR: Unrecognized option %s.\n", Arg);
+            ValidArgs = false;
+        }
+        else if(FileNames)
+        {
+            FileNames[FileCount++] = Arg;
+            ReadsStandardInput |= (strcmp(Arg, "-") == 0);
+        }
+    }
+    
+    if(JobThreadCount && MapFiles)
+    {
+        fprintf(stderr, "ERROR: -j cannot be combined with --mmap, --threads, --pipeline or --index.\n");
+        ValidArgs = false;
+    }
+    
+    if(UseIndex && (ThreadCount || FormatThreadCount))
+    {
+        fprintf(stderr, "ERROR: --index cannot be combined with --threads or --pipeline.\n");
+        ValidArgs = false;
+    }
+    
+    if(ThreadCount && FormatThreadCount)
+    {
+        fprintf(stderr, "ERROR: --threads cannot be combined with --pipeline.\n");
+        ValidArgs = false;
+    }
+    
+    if(JobThreadCount && ReadsStandardInput)
+    {
+        fprintf(stderr, "ERROR: -j cannot read from standard input.\n");
+        ValidArgs = false;
+    }
+    
+    if(UseCounters && (MapFiles || JobThreadCount || ReadsStandardInput))
+    {
+        fprintf(stderr, "ERROR: --counters only works on files loaded into 8086 memory (no --mmap, --threads, -j or -).\n");
+        ValidArgs = false;
+    }
+    
+    if(Execute && (MapFiles || JobThreadCount || ReadsStandardInput || UseCounters || (Format != OutputFormat_Text)))
+    {
+        fprintf(stderr, "ERROR: --exec only runs files loaded into 8086 memory (no --mmap, --threads, --pipeline, --index, -j, --counters, --format or -).\n");
+        ValidArgs = false;
+    }
+    
+    if(UseJit && !(Execute && UseBlockCache))
+    {
+        fprintf(stderr, "ERROR: --jit only works with --exec, and compiles blocks from the block cache (so not with --no-block-cache).\n");
+        ValidArgs = false;
+    }
+    
+    if(UseThreaded && !(Execute && UseBlockCache))
+    {
+        fprintf(stderr, "ERROR: --dispatch=threaded only works with --exec, and runs blocks from the block cache (so not with --no-block-cache).\n");
+        ValidArgs = false;
+    }
+    
+    if((EagerFlags || LimitGiven) && !Execute)
+    {
+        fprintf(stderr, "ERROR: --eager-flags and --limit only work with --exec.\n");
+        ValidArgs = false;
+    }
+    
     segmented_access MainMemory = AllocateMemoryPow2(20);
     if(IsValid(MainMemory))
     {
-        if(ArgCount > 1)
+        if(ValidArgs && FileCount)
         {
-            for(int ArgIndex = 1; ArgIndex < ArgCount; ++ArgIndex)
+            // NOTE: Disassembly is formatted into this buffer and written out in large
+            // blocks, rather than going through stdio a few bytes at a time.
+            static char OutputMemory[64*1024];
+            text_buffer Output = TextBuffer(sizeof(OutputMemory), OutputMemory, stdout);
+            
+            perf_counters Counters = {};
+            if(UseCounters)
+            {
+                Counters = OpenPerfCounters();
+                if(!AnyAvailable(&Counters))
+                {
+                    fprintf(stderr, "WARNING: No performance counters are available, so none will be reported.\n");
+                }
+            }
+            
+            if(Execute)
             {
-                char *FileName = Args[ArgIndex];
-                u32 BytesRead = LoadMemoryFromFile(FileName, MainMemory, 0);
+                // NOTE: The block cache is big enough (a few MB) that it is only allocated
+                // when it is going to be used.
+                block_cache *Cache = 0;
+                if(UseBlockCache)
+                {
+                    Cache = (block_cache *)calloc(1, sizeof(block_cache));
+                    if(!Cache)
+                    {
+                        fprintf(stderr, "WARNING: Unable to allocate the block cache, so instructions will be decoded every time they run.\n");
+                    }
+                }
                 
-                printf("; %s disassembly:\n", FileName);
-                printf("bits 16\n");
-                DisAsm8086(BytesRead, MainMemory);
+                threaded_code *Threaded = 0;
+                if(Cache && UseThreaded)
+                {
+                    Threaded = (threaded_code *)calloc(1, sizeof(threaded_code));
+                    if(!Threaded)
+                    {
+                        fprintf(stderr, "WARNING: Unable to allocate memory for threaded code, so blocks will be run with a switch.\n");
+                    }
+                }
+                
+                jit JitState = {};
+                jit *Jit = 0;
+                if(Cache && UseJit)
+                {
+                    if(CreateJit(&JitState))
+                    {
+                        Jit = &JitState;
+                    }
+                    else
+                    {
+                        fprintf(stderr, "WARNING: Unable to compile to native code here (it needs x86-64 and executable memory), so everything will be interpreted.\n");
+                    }
+                }
+                
+                for(u32 FileIndex = 0; FileIndex < FileCount; ++FileIndex)
+                {
+                    ExecuteFile(FileNames[FileIndex], MainMemory, Cache, Threaded, Jit, EagerFlags, InstructionLimit, Decode, &Output);
+                }
+                
+                if(Jit)
+                {
+                    DestroyJit(Jit);
+                }
+                free(Threaded);
+                free(Cache);
+            }
+            else if(JobThreadCount)
+            {
+                DisAsmFilesInParallel(FileCount, FileNames, Decode, JobThreadCount, &Output, Format);
+            }
+            else
+            {
+                for(u32 FileIndex = 0; FileIndex < FileCount; ++FileIndex)
+                {
+                    TimeBlock("File");
+                    
+                    char *FileName = FileNames[FileIndex];
+                    
+                    disasm_stop Stop = DisAsmStop_None;
+                    parallel_disasm_stats Stats = {};
+                    pipeline_disasm_stats PipelineStats = {};
+                    perf_counter_values LoadCounters = {};
+                    disasm_phase_counters Phases = {};
+                    u64 ImageSize = 0;
+                    b32 IsStandardInput = (strcmp(FileName, "-") == 0);
+                    if(IsStandardInput)
+                    {
+                        AppendDisAsmFileBegin(&Output, Format, "stdin");
+                        Stop = DisAsm8086Stream(Decode, &Output, Format);
+                    }
+                    else if(MapFiles)
+                    {
+                        mapped_file File;
+                        b32 Mapped = MapFileReadOnly(FileName, &File);
+                        if(!Mapped)
+                        {
+                            ReportOpenFailure(&Output, FileName);
+                        }
+                        ImageSize = File.Size;
+                        
+                        AppendDisAsmFileBegin(&Output, Format, FileName);
+                        if(File.Size > 0xffffffff)
+                        {
+                            // NOTE: Instruction addresses are 32 bits, so past 4GB the offsets
+                            // in bin and jsonl output (and in the index) would wrap.
+                            Stop = DisAsmStop_TooLarge;
+                        }
+                        else if(UseIndex && Mapped)
+                        {
+                            Stop = DisAsm8086Indexed(FileName, &File, Decode, &Output, Format);
+                        }
+                        else if(ThreadCount)
+                        {
+                            Stop = DisAsm8086Parallel(File.Size, File.Data, Decode, ThreadCount, &Output, Format, &Stats);
+                        }
+                        else if(FormatThreadCount)
+                        {
+                            Stop = DisAsm8086Pipelined(File.Size, File.Data, Decode, FormatThreadCount, &Output, Format, &PipelineStats);
+                        }
+                        else
+                        {
+                            Stop = DisAsm8086Linear(File.Size, File.Data, Decode, &Output, Format);
+                        }
+                        UnmapFile(&File);
+                    }
+                    else if(UseCounters)
+                    {
+                        // NOTE: Loading is counted too, since it is where the 8086 memory
+                        // first gets touched (and so where its page faults land).
+                        perf_counter_values BeforeLoad = ReadPerfCounters(&Counters);
+                        u32 BytesRead;
+                        b32 Loaded = LoadMemoryFromFile(FileName, MainMemory, 0, &BytesRead);
+                        LoadCounters = ReadPerfCounters(&Counters) - BeforeLoad;
+                        if(!Loaded)
+                        {
+                            ReportOpenFailure(&Output, FileName);
+                        }
+                        ImageSize = BytesRead;
+                        
+                        AppendDisAsmFileBegin(&Output, Format, FileName);
+                        Stop = DisAsm8086Counted(BytesRead, MainMemory, Decode, &Output, Format, &Counters, &Phases);
+                    }
+                    else
+                    {
+                        u32 BytesRead;
+                        if(!LoadMemoryFromFile(FileName, MainMemory, 0, &BytesRead))
+                        {
+                            ReportOpenFailure(&Output, FileName);
+                        }
+                        ImageSize = BytesRead;
+                        
+                        AppendDisAsmFileBegin(&Output, Format, FileName);
+                        Stop = DisAsm8086(BytesRead, MainMemory, Decode, &Output, Format);
+                    }
+                    
+                    ReportDisAsmStop(&Output, Stop);
+                    AppendDisAsmFileEnd(&Output, Format, IsStandardInput ? "stdin" : FileName, Stop);
+                    
+                    if(ThreadCount && !IsStandardInput)
+                    {
+                        FlushTextBuffer(&Output);
+                        f64 MegabytesPerSecond = (Stats.Seconds > 0) ? ((f64)ImageSize / (1024.0*1024.0*Stats.Seconds)) : 0;
+                        fprintf(stderr, "%s: %llu bytes, %u threads, %.3fs (%.1f MB/s), %llu chunks, %llu instructions resynced\n",
+                                FileName, ImageSize, ThreadCount, Stats.Seconds, MegabytesPerSecond,
+                                Stats.ChunkCount, Stats.ResyncCount);
+                    }
+                    
+                    if(FormatThreadCount && !IsStandardInput)
+                    {
+                        FlushTextBuffer(&Output);
+                        fflush(stdout);
+                        PrintPipelineStats(stderr, FileName, ImageSize, &PipelineStats);
+                    }
+                    
+                    if(UseCounters && AnyAvailable(&Counters))
+                    {
+                        FlushTextBuffer(&Output);
+                        fflush(stdout);
+                        fprintf(stderr, "%s: %llu bytes, %llu instructions\n", FileName, ImageSize, Phases.InstructionCount);
+                        fprintf(stderr, "  load:\n");
+                        PrintPerfCounters(stderr, &Counters, LoadCounters, 0);
+                        fprintf(stderr, "  decode:\n");
+                        PrintPerfCounters(stderr, &Counters, Phases.Decode, Phases.InstructionCount);
+                        fprintf(stderr, "  print:\n");
+                        PrintPerfCounters(stderr, &Counters, Phases.Print, Phases.InstructionCount);
+                    }
+                    
+                    CountProfileBytes(ImageSize);
+                }
+            }
+            
+            FlushTextBuffer(&Output);
+            
+            if(UseCounters)
+            {
+                ClosePerfCounters(&Counters);
             }
         }
         else
         {
-            fprintf(stderr, "USAGE: %s [8086 machine code file] ...\n", Args[0]);
+            fprintf(stderr, "USAGE: %s [--decoder=table|specialized] [--format=text|bin|jsonl] [--mmap] [--threads=N] [--pipeline=N] [-j N] [--index] [--counters] [--exec [--no-block-cache | [--jit] [--dispatch=switch|threaded]] [--eager-flags] [--limit=N]] [8086 machine code file | -] ...\n", Args[0]);
         }
     }
     else
@@ -139,5 +720,9 @@ int main(int ArgCount, char **Args)
         fprintf(stderr, "ERROR: Unable to allow main memory for 8086.\n");
     }
     
+    EndAndPrintProfile(stderr);
+    
     return 0;
 }
+
+ProfilerEndOfCompilationUnit;
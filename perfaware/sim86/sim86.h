@@ -22,6 +22,15 @@ typedef long long s64;
 
 typedef s32 b32;
 
+typedef float f32;
+typedef double f64;
+
 #define ArrayCount(Array) (sizeof(Array) / sizeof((Array)[0]))
 
-static u32 const SIM86_VERSION = 3;
+#if _MSC_VER
+#define force_inline __forceinline
+#else
+#define force_inline inline __attribute__((always_inline))
+#endif
+
+static u32 const SIM86_VERSION = 4;
@@ -0,0 +1,529 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+#include "sim86.h"
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sim86_instruction.h"
+#include "sim86_instruction_table.h"
+#include "sim86_memory.h"
+#include "sim86_text.h"
+#include "sim86_decode.h"
+#include "sim86_decode_specialized.h"
+#include "sim86_packed.h"
+#include "sim86_platform.h"
+#include "sim86_counters.h"
+#include "sim86_profiler.h"
+#include "sim86_disasm.h"
+#include "sim86_block_cache.h"
+#include "sim86_execute.h"
+#include "sim86_threaded.h"
+#include "sim86_jit.h"
+#include "sim86_repetition_tester.h"
+
+#include "sim86_instruction.cpp"
+#include "sim86_instruction_table.cpp"
+#include "sim86_memory.cpp"
+#include "sim86_text.cpp"
+#include "sim86_decode.cpp"
+#include "sim86_decode_specialized.cpp"
+#include "sim86_packed.cpp"
+#include "sim86_platform.cpp"
+#include "sim86_counters.cpp"
+#include "sim86_disasm.cpp"
+#include "sim86_block_cache.cpp"
+#include "sim86_execute.cpp"
+#include "sim86_threaded.cpp"
+#include "sim86_jit.cpp"
+#include "sim86_repetition_tester.cpp"
+
+struct benchmark_input
+{
+    // NOTE: Bytes is cut back to the part that decodes cleanly, so every test covers
+    // exactly InstructionCount instructions.
+    char const *Name;
+    u64 ByteCount;
+    u8 *Bytes;
+    u64 InstructionCount;
+    instruction *Instructions;
+    
+    // NOTE: How many instructions running the input as a program executes (up to
+    // BenchmarkInstructionLimit), which is what the execution tests count.
+    u64 ExecutedInstructionCount;
+};
+
+struct benchmark_context
+{
+    benchmark_input *Input;
+    FILE *NullFile;
+    text_buffer Text;
+    segmented_access Memory;
+    block_cache *Cache;
+    threaded_code *Threaded;
+};
+
+typedef void benchmark_proc(repetition_tester *Tester, benchmark_context *Context);
+
+struct benchmark
+{
+    char const *Name;
+    benchmark_proc *Proc;
+    b32 Executes; // NOTE: Counts executed instructions rather than decoded ones
+};
+
+static u32 const BenchmarkTextPerByte = 16;
+static u64 const SyntheticByteCount = 1024*1024;
+static u64 const BenchmarkInstructionLimit = 20000000;
+
+static u64 EstimateCPUTimerFrequency(u64 MillisecondsToWait = 100)
+{
+    // NOTE: The time stamp counter's rate is not reported anywhere portable, so it is
+    // measured against the OS timer over a short busy wait.
+    u64 OSFreq = GetOSTimerFrequency();
+    u64 OSWaitTime = OSFreq * MillisecondsToWait / 1000;
+    
+    u64 CPUStart = ReadCPUTimer();
+    u64 OSStart = ReadOSTimer();
+    u64 OSEnd = 0;
+    u64 OSElapsed = 0;
+    while(OSElapsed < OSWaitTime)
+    {
+        OSEnd = ReadOSTimer();
+        OSElapsed = OSEnd - OSStart;
+    }
+    
+    u64 CPUEnd = ReadCPUTimer();
+    u64 CPUElapsed = CPUEnd - CPUStart;
+    
+    u64 Result = 0;
+    if(OSElapsed)
+    {
+        Result = (u64)((f64)OSFreq * (f64)CPUElapsed / (f64)OSElapsed);
+    }
+    
+    return Result;
+}
+
+// NOTE: A register-heavy nested loop, for the execution tests to have something that runs
+// for a while (the listings are either tiny or not meant to be run):
+//     mov ax, 1000h
+//     mov ds, ax
+//     mov dx, 600
+//   outer:
+//     mov cx, 1000
+//   inner:
+//     add ax, cx
+//     xor bx, ax
+//     add [bx + si], cx
+//     sub si, 3
+//     cmp si, di
+//     jne skip
+//     inc di
+//   skip:
+//     dec cx
+//     jnz inner
+//     dec dx
+//     jnz outer
+static u8 SyntheticLoop[] =
+{
+    0xb8, 0x00, 0x10, 0x8e, 0xd8, 0xba, 0x58, 0x02, 0xb9, 0xe8, 0x03, 0x01, 0xc8, 0x31, 0xc3, 0x01,
+    0x08, 0x83, 0xee, 0x03, 0x39, 0xfe, 0x75, 0x01, 0x47, 0x49, 0x75, 0xef, 0x4a, 0x75, 0xe9,
+};
+
+static void DecodeAll(repetition_tester *Tester, benchmark_context *Context, decode_instruction *Decode)
+{
+    benchmark_input *Input = Context->Input;
+    instruction_table Table = Get8086InstructionTable();
+    
+    while(IsTesting(Tester))
+    {
+        u64 Count = 0;
+        u64 Offset = 0;
+        
+        BeginTime(Tester);
+        while(Offset < Input->ByteCount)
+        {
+            instruction Instruction = DecodeInstructionFromBuffer(Table, Input->ByteCount - Offset, Input->Bytes + Offset, Decode);
+            Offset += Instruction.Size;
+            ++Count;
+        }
+        EndTime(Tester);
+        
+        CountBytes(Tester, Offset);
+        CountInstructions(Tester, Count);
+    }
+}
+
+static void BenchmarkDecodeTable(repetition_tester *Tester, benchmark_context *Context)
+{
+    DecodeAll(Tester, Context, DecodeInstruction);
+}
+
+static void BenchmarkDecodeSpecialized(repetition_tester *Tester, benchmark_context *Context)
+{
+    DecodeAll(Tester, Context, DecodeInstructionSpecialized);
+}
+
+static void BenchmarkFormatInstruction(repetition_tester *Tester, benchmark_context *Context)
+{
+    benchmark_input *Input = Context->Input;
+    text_buffer *Text = &Context->Text;
+    
+    while(IsTesting(Tester))
+    {
+        Text->Used = 0;
+        
+        BeginTime(Tester);
+        for(u64 Index = 0; Index < Input->InstructionCount; ++Index)
+        {
+            FormatInstruction(Text, Input->Instructions[Index]);
+            AppendChar(Text, '\n');
+        }
+        EndTime(Tester);
+        
+        if(Text->Overflowed)
+        {
+            Error(Tester, "Text buffer overflowed");
+        }
+        
+        CountBytes(Tester, Input->ByteCount);
+        CountInstructions(Tester, Input->InstructionCount);
+    }
+}
+
+// NOTE: This is how sim86 printed instructions before it formatted into one buffer: a
+// separate fwrite for every instruction. It is kept here to compare against.
+static void PrintInstruction(instruction Instruction, FILE *Dest)
+{
+    TimeFunction;
+    
+    // NOTE: One instruction never comes close to filling this, so this is a single fwrite.
+    char Memory[256];
+    text_buffer Buffer = TextBuffer(sizeof(Memory), Memory, Dest);
+    FormatInstruction(&Buffer, Instruction);
+    FlushTextBuffer(&Buffer);
+}
+
+static void BenchmarkPrintInstruction(repetition_tester *Tester, benchmark_context *Context)
+{
+    benchmark_input *Input = Context->Input;
+    
+    while(IsTesting(Tester))
+    {
+        BeginTime(Tester);
+        for(u64 Index = 0; Index < Input->InstructionCount; ++Index)
+        {
+            PrintInstruction(Input->Instructions[Index], Context->NullFile);
+            fputc('\n', Context->NullFile);
+        }
+        EndTime(Tester);
+        
+        CountBytes(Tester, Input->ByteCount);
+        CountInstructions(Tester, Input->InstructionCount);
+    }
+}
+
+static void BenchmarkDisAsm8086(repetition_tester *Tester, benchmark_context *Context)
+{
+    // NOTE: The whole path sim86 takes for a file once it is loaded: decode, format, and
+    // write (to the null device) in large blocks.
+    benchmark_input *Input = Context->Input;
+    memcpy(Context->Memory.Memory, Input->Bytes, Input->ByteCount);
+    
+    char OutputMemory[64*1024];
+    text_buffer Output = TextBuffer(sizeof(OutputMemory), OutputMemory, Context->NullFile);
+    
+    while(IsTesting(Tester))
+    {
+        BeginTime(Tester);
+        disasm_stop Stop = DisAsm8086((u32)Input->ByteCount, Context->Memory, DecodeInstruction, &Output, OutputFormat_Text);
+        FlushTextBuffer(&Output);
+        EndTime(Tester);
+        
+        if(Stop)
+        {
+            Error(Tester, "DisAsm8086 stopped early");
+        }
+        
+        CountBytes(Tester, Input->ByteCount);
+        CountInstructions(Tester, Input->InstructionCount);
+    }
+}
+
+static cpu_8086 LoadProgram(benchmark_context *Context, b32 Threaded)
+{
+    // NOTE: Programs can write anywhere, so every run starts from freshly loaded memory.
+    benchmark_input *Input = Context->Input;
+    segmented_access Memory = Context->Memory;
+    memset(Memory.Memory, 0, GetHighestAddress(Memory) + 1);
+    memcpy(Memory.Memory, Input->Bytes, Input->ByteCount);
+    
+    cpu_8086 Result = CPU8086(Memory, (u32)Input->ByteCount);
+    Result.Cache = Context->Cache;
+    Result.Threaded = Threaded ? Context->Threaded : 0;
+    Result.InstructionLimit = BenchmarkInstructionLimit;
+    
+    return Result;
+}
+
+static void ExecuteProgram(repetition_tester *Tester, benchmark_context *Context, b32 Threaded)
+{
+    benchmark_input *Input = Context->Input;
+    instruction_table Table = Get8086InstructionTable();
+    
+    while(IsTesting(Tester))
+    {
+        cpu_8086 CPU = LoadProgram(Context, Threaded);
+        
+        BeginTime(Tester);
+        Execute8086(&CPU, Table, DecodeInstruction);
+        EndTime(Tester);
+        
+        CountBytes(Tester, Input->ByteCount);
+        CountInstructions(Tester, CPU.InstructionCount);
+    }
+}
+
+static void BenchmarkExecuteSwitch(repetition_tester *Tester, benchmark_context *Context)
+{
+    ExecuteProgram(Tester, Context, false);
+}
+
+static void BenchmarkExecuteThreaded(repetition_tester *Tester, benchmark_context *Context)
+{
+    ExecuteProgram(Tester, Context, true);
+}
+
+static b32 PrepareInput(benchmark_input *Input, char const *Name, u64 ByteCount, u8 *Bytes)
+{
+    *Input = {};
+    Input->Name = Name;
+    Input->Bytes = Bytes;
+    Input->Instructions = (instruction *)malloc(ByteCount*sizeof(instruction));
+    
+    if(Input->Instructions)
+    {
+        instruction_table Table = Get8086InstructionTable();
+        u64 Offset = 0;
+        while(Offset < ByteCount)
+        {
+            u64 Remaining = ByteCount - Offset;
+            instruction Instruction = DecodeInstructionFromBuffer(Table, Remaining, Bytes + Offset);
+            if(GetDisAsmStop(Instruction, Remaining))
+            {
+                break;
+            }
+            
+            Input->Instructions[Input->InstructionCount++] = Instruction;
+            Offset += Instruction.Size;
+        }
+        
+        Input->ByteCount = Offset;
+    }
+    
+    b32 Result = (Input->InstructionCount != 0);
+    return Result;
+}
+
+static u8 *ReadEntireFile(char *FileName, u64 *ByteCount)
+{
+    u8 *Result = 0;
+    *ByteCount = 0;
+    
+    FILE *File = fopen(FileName, "rb");
+    if(File)
+    {
+        fseek(File, 0, SEEK_END);
+        long Size = ftell(File);
+        fseek(File, 0, SEEK_SET);
+        
+        if(Size > 0)
+        {
+            Result = (u8 *)malloc(Size);
+            if(Result && (fread(Result, Size, 1, File) == 1))
+            {
+                *ByteCount = (u64)Size;
+            }
+            else
+            {
+                free(Result);
+                Result = 0;
+            }
+        }
+        
+        fclose(File);
+    }
+    
+    return Result;
+}
+
+int main(int ArgCount, char **Args)
+{
+    u32 SecondsToTry = 10;
+    b32 UseCounters = false;
+    u32 InputCount = 0;
+    benchmark_input *Inputs = (benchmark_input *)calloc(ArgCount + 1, sizeof(benchmark_input));
+    b32 ValidArgs = (Inputs != 0);
+    
+    for(int ArgIndex = 1; ValidArgs && (ArgIndex < ArgCount); ++ArgIndex)
+    {
+        char *Arg = Args[ArgIndex];
+        if(strncmp(Arg, "--seconds=", 10) == 0)
+        {
+            SecondsToTry = atoi(Arg + 10);
+        }
+        else if(strcmp(Arg, "--counters") == 0)
+        {
+            UseCounters = true;
+        }
+        else if(strncmp(Arg, "--", 2) == 0)
+        {
+            fprintf(stderr, "ERROR: Unrecognized option %s.\n", Arg);
+            ValidArgs = false;
+        }
+        else
+        {
+            u64 ByteCount;
+            u8 *Bytes = ReadEntireFile(Arg, &ByteCount);
+            if(Bytes && PrepareInput(&Inputs[InputCount], Arg, ByteCount, Bytes))
+            {
+                ++InputCount;
+            }
+            else
+            {
+                fprintf(stderr, "ERROR: Unable to read any instructions from %s.\n", Arg);
+                ValidArgs = false;
+            }
+        }
+    }
+    
+    if(ValidArgs && InputCount)
+    {
+        // NOTE: The listings are far too small to show throughput, so they are also tiled
+        // into one large image. It is kept to 1MB so that DisAsm8086 can still run on it.
+        u8 *Synthetic = (u8 *)malloc(SyntheticByteCount);
+        if(Synthetic)
+        {
+            u64 SyntheticSize = 0;
+            for(b32 Filled = false; !Filled;)
+            {
+                for(u32 InputIndex = 0; InputIndex < InputCount; ++InputIndex)
+                {
+                    benchmark_input *Input = &Inputs[InputIndex];
+                    if((SyntheticSize + Input->ByteCount) > SyntheticByteCount)
+                    {
+                        Filled = true;
+                        break;
+                    }
+                    
+                    memcpy(Synthetic + SyntheticSize, Input->Bytes, Input->ByteCount);
+                    SyntheticSize += Input->ByteCount;
+                }
+            }
+            
+            if(PrepareInput(&Inputs[InputCount], "synthetic (inputs tiled to 1MB)", SyntheticSize, Synthetic))
+            {
+                ++InputCount;
+            }
+        }
+        
+        if(PrepareInput(&Inputs[InputCount], "synthetic loop", sizeof(SyntheticLoop), SyntheticLoop))
+        {
+            ++InputCount;
+        }
+        
+#if _WIN32
+        FILE *NullFile = fopen("nul", "wb");
+#else
+        FILE *NullFile = fopen("/dev/null", "wb");
+#endif
+        u8 *Memory = (u8 *)malloc(1 << 20);
+        block_cache *Cache = (block_cache *)calloc(1, sizeof(block_cache));
+        threaded_code *Threaded = (threaded_code *)calloc(1, sizeof(threaded_code));
+        
+        u64 CPUTimerFreq = EstimateCPUTimerFrequency();
+        printf("CPU timer frequency: %llu (estimated)\n", CPUTimerFreq);
+        
+        perf_counters Counters = {};
+        if(UseCounters)
+        {
+            Counters = OpenPerfCounters();
+            if(!AnyAvailable(&Counters))
+            {
+                fprintf(stderr, "WARNING: No performance counters are available, so none will be reported.\n");
+                UseCounters = false;
+            }
+        }
+        
+        benchmark Benchmarks[] =
+        {
+            {"DecodeInstruction", BenchmarkDecodeTable},
+            {"DecodeInstructionSpecialized", BenchmarkDecodeSpecialized},
+            {"FormatInstruction", BenchmarkFormatInstruction},
+            {"PrintInstruction", BenchmarkPrintInstruction},
+            {"DisAsm8086", BenchmarkDisAsm8086},
+            {"Execute8086 (switch dispatch)", BenchmarkExecuteSwitch, true},
+            {"Execute8086 (threaded dispatch)", BenchmarkExecuteThreaded, true},
+        };
+        
+        for(u32 InputIndex = 0; NullFile && Memory && Cache && Threaded && (InputIndex < InputCount); ++InputIndex)
+        {
+            benchmark_input *Input = &Inputs[InputIndex];
+            
+            benchmark_context Context = {};
+            Context.Input = Input;
+            Context.NullFile = NullFile;
+            Context.Memory = FixedMemoryPow2(20, Memory);
+            Context.Cache = Cache;
+            Context.Threaded = Threaded;
+            
+            // NOTE: One run up front to find out how many instructions the program executes.
+            cpu_8086 CPU = LoadProgram(&Context, false);
+            Execute8086(&CPU, Get8086InstructionTable(), DecodeInstruction);
+            Input->ExecutedInstructionCount = CPU.InstructionCount;
+            
+            u64 TextSize = BenchmarkTextPerByte*Input->ByteCount;
+            Context.Text = TextBuffer((u32)TextSize, (char *)malloc(TextSize));
+            
+            for(u32 BenchmarkIndex = 0; BenchmarkIndex < ArrayCount(Benchmarks); ++BenchmarkIndex)
+            {
+                benchmark *Benchmark = &Benchmarks[BenchmarkIndex];
+                u64 InstructionCount = Benchmark->Executes ? Input->ExecutedInstructionCount : Input->InstructionCount;
+                printf("\n--- %s on %s (%llu bytes, %llu instructions%s) ---\n",
+                       Benchmark->Name, Input->Name, Input->ByteCount, InstructionCount,
+                       Benchmark->Executes ? " executed" : "");
+                
+                repetition_tester Tester = {};
+                Tester.Counters = UseCounters ? &Counters : 0;
+                NewTestWave(&Tester, Input->ByteCount, InstructionCount, CPUTimerFreq, SecondsToTry);
+                Benchmark->Proc(&Tester, &Context);
+            }
+            
+            free(Context.Text.Memory);
+        }
+        
+        ClosePerfCounters(&Counters);
+    }
+    else
+    {
+        fprintf(stderr, "USAGE: %s [--seconds=N] [--counters] [8086 machine code file] ...\n", Args[0]);
+        fprintf(stderr, "       (for example, the listings in perfaware/part1)\n");
+    }
+    
+    return 0;
+}
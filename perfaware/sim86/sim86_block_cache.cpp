@@ -0,0 +1,226 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+static void ResetBlockCache(block_cache *Cache, segmented_access Memory)
+{
+    Cache->MemoryMask = Memory.Mask;
+    ++Cache->Generation;
+    
+    memset(Cache->Blocks, 0, sizeof(Cache->Blocks));
+    memset(Cache->CodeGranules, 0, sizeof(Cache->CodeGranules));
+    memset(Cache->CodeLinkHeads, 0, sizeof(Cache->CodeLinkHeads));
+    Cache->InstructionsUsed = 0;
+    Cache->CodeLinksUsed = 0;
+    Cache->NextSerial = 0;
+}
+
+static b32 EndsBlock(instruction *Instruction)
+{
+    b32 Result = false;
+    switch(Instruction->Op)
+    {
+        case Op_jmp: case Op_call: case Op_ret: case Op_retf:
+        case Op_je: case Op_jne: case Op_jl: case Op_jnl: case Op_jle: case Op_jg: case Op_jb: case Op_jnb:
+        case Op_jbe: case Op_ja: case Op_jp: case Op_jnp: case Op_jo: case Op_jno: case Op_js: case Op_jns:
+        case Op_loop: case Op_loopz: case Op_loopnz: case Op_jcxz:
+        case Op_int: case Op_int3: case Op_into: case Op_iret:
+        case Op_div: case Op_idiv: // NOTE: A divide error is an interrupt
+        case Op_hlt:
+        {
+            Result = true;
+        } break;
+        
+        default:
+        {
+            // NOTE: Anything else that writes cs (mov cs or pop cs) moves execution too. pop cs
+            // has its register in the second operand, like the other one-register forms.
+            instruction_operand Dest = Instruction->Operands[0];
+            if(Dest.Type == Operand_None)
+            {
+                Dest = Instruction->Operands[1];
+            }
+            Result = ((Dest.Type == Operand_Register) && (Dest.Register.Index == Register_cs));
+        } break;
+    }
+    
+    return Result;
+}
+
+static u32 GetGranuleCount(cached_block *Block)
+{
+    u32 Result = ((Block->Start & ((1 << CodeGranuleShift) - 1)) + Block->Size +
+                  (1 << CodeGranuleShift) - 1) >> CodeGranuleShift;
+    return Result;
+}
+
+static void MarkCode(block_cache *Cache, cached_block *Block, s32 Delta)
+{
+    u32 GranuleMask = (Cache->MemoryMask >> CodeGranuleShift);
+    u32 FirstGranule = Block->Start >> CodeGranuleShift;
+    u32 GranuleCount = GetGranuleCount(Block);
+    for(u32 GranuleIndex = 0; GranuleIndex < GranuleCount; ++GranuleIndex)
+    {
+        Cache->CodeGranules[(FirstGranule + GranuleIndex) & GranuleMask] += (u16)Delta;
+    }
+}
+
+static void LinkCode(block_cache *Cache, cached_block *Block)
+{
+    u32 GranuleMask = (Cache->MemoryMask >> CodeGranuleShift);
+    u32 FirstGranule = Block->Start >> CodeGranuleShift;
+    u32 GranuleCount = GetGranuleCount(Block);
+    for(u32 GranuleIndex = 0; GranuleIndex < GranuleCount; ++GranuleIndex)
+    {
+        u32 *Head = &Cache->CodeLinkHeads[(FirstGranule + GranuleIndex) & GranuleMask];
+        code_link *Link = &Cache->CodeLinks[Cache->CodeLinksUsed++];
+        Link->Next = *Head;
+        Link->Slot = (u32)(Block - Cache->Blocks);
+        Link->Serial = Block->Serial;
+        *Head = Cache->CodeLinksUsed;
+    }
+}
+
+static void EvictBlock(block_cache *Cache, cached_block *Block)
+{
+    if(Block->InstructionCount)
+    {
+        MarkCode(Cache, Block, -1);
+        Block->InstructionCount = 0;
+    }
+}
+
+static cached_block *GetCachedBlock(block_cache *Cache, segmented_access Memory, u16 CS, u16 IP, u32 ProgramEnd,
+                                    instruction_table Table, decode_instruction *Decode)
+{
+    block_cache_stats *Stats = &Cache->Stats;
+    ++Stats->Lookups;
+    
+    u32 Key = ((u32)CS << 16) | IP;
+    u32 Slot = (Key*2654435761u) >> (32 - BlockCacheSlotCountPow2);
+    cached_block *Result = &Cache->Blocks[Slot];
+    
+    if(Result->InstructionCount && (Result->Key == Key))
+    {
+        ++Stats->Hits;
+    }
+    else
+    {
+        EvictBlock(Cache, Result);
+        
+        if(((Cache->InstructionsUsed + MaxBlockInstructionCount + 1) > BlockCacheInstructionCount) ||
+           ((Cache->CodeLinksUsed + MaxBlockCodeLinks) > BlockCacheCodeLinkCount))
+        {
+            ResetBlockCache(Cache, Memory);
+            ++Stats->Flushes;
+        }
+        
+        Memory.SegmentBase = CS;
+        Memory.SegmentOffset = IP;
+        
+        Result->Key = Key;
+        Result->Serial = ++Cache->NextSerial;
+        Result->Start = GetAbsoluteAddressOf(Memory);
+        Result->Size = 0;
+        Result->FirstInstruction = Cache->InstructionsUsed;
+        Result->ExecutionCount = 0;
+        Result->NotCompilable = false;
+        Result->Compiled = 0;
+        Result->Threaded = false;
+        
+        // NOTE: The block stops short of any instruction that starts outside the program,
+        // does not decode, or runs past the end of the segment (so that its code is one run
+        // of addresses), since the executor handles those one at a time. It also stops
+        // before it grows past MaxBlockSize, so that its links always fit.
+        instruction *Instructions = Cache->Instructions + Cache->InstructionsUsed;
+        u32 Count = 0;
+        while(Count < MaxBlockInstructionCount)
+        {
+            if(GetAbsoluteAddressOf(Memory) >= ProgramEnd)
+            {
+                break;
+            }
+            
+            instruction Instruction = Decode(Table, Memory);
+            if(!Instruction.Op || ((Memory.SegmentOffset + Instruction.Size) > 0x10000) ||
+               ((Result->Size + Instruction.Size) > MaxBlockSize))
+            {
+                break;
+            }
+            
+            Instructions[Count++] = Instruction;
+            Result->Size += Instruction.Size;
+            Memory.SegmentOffset += (u16)Instruction.Size;
+            
+            if(EndsBlock(&Instruction))
+            {
+                break;
+            }
+        }
+        
+        if(Count)
+        {
+            Result->InstructionCount = Count;
+            Cache->InstructionsUsed += Count + 1;
+            MarkCode(Cache, Result, 1);
+            LinkCode(Cache, Result);
+            
+            ++Stats->BlocksDecoded;
+            Stats->InstructionsDecoded += Count;
+        }
+        else
+        {
+            Result = 0;
+        }
+    }
+    
+    return Result;
+}
+
+static void InvalidateCode(block_cache *Cache, u32 Address)
+{
+    u32 Granule = (Address & Cache->MemoryMask) >> CodeGranuleShift;
+    if(Cache->CodeGranules[Granule])
+    {
+        u32 *LinkIndex = &Cache->CodeLinkHeads[Granule];
+        while(*LinkIndex)
+        {
+            code_link *Link = &Cache->CodeLinks[*LinkIndex - 1];
+            cached_block *Block = &Cache->Blocks[Link->Slot];
+            
+            b32 Live = (Block->InstructionCount && (Block->Serial == Link->Serial));
+            if(Live && (((Address - Block->Start) & Cache->MemoryMask) < Block->Size))
+            {
+                EvictBlock(Cache, Block);
+                ++Cache->Stats.Invalidations;
+                ++Cache->Generation;
+                Live = false;
+            }
+            
+            if(Live)
+            {
+                LinkIndex = &Link->Next;
+            }
+            else
+            {
+                *LinkIndex = Link->Next;
+            }
+        }
+    }
+}
+
+static void PrintBlockCacheStats(FILE *Dest, char const *FileName, block_cache_stats *Stats)
+{
+    f64 HitRate = Stats->Lookups ? (100.0*(f64)Stats->Hits / (f64)Stats->Lookups) : 0;
+    fprintf(Dest, "%s: block cache %llu lookups, %.2f%% hits, %llu blocks (%llu instructions) decoded, %llu invalidated, %llu flushes\n",
+            FileName, Stats->Lookups, HitRate, Stats->BlocksDecoded, Stats->InstructionsDecoded,
+            Stats->Invalidations, Stats->Flushes);
+}
@@ -0,0 +1,107 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Caches decoded basic blocks for the executor, keyed by the cs:ip they start at. A
+   block is the run of instructions from its start up to and including the first one that
+   can transfer control (or that would start outside the program), so once it is found the
+   executor can run it straight out of the cache without decoding anything.
+   
+   Every cached block marks the 16-byte granules of memory its code covers, and links
+   itself into a list kept for each of those granules. A write to a marked granule walks
+   that granule's list (so it only ever looks at blocks with code there), invalidates the
+   blocks that overlap the byte written, and bumps Generation, which is how the executor
+   notices that the block it is running may have just been changed underneath it.
+   
+   Evicting a block leaves its links in place. Each link remembers the Serial of the block
+   it was made for, so a link whose slot has since been emptied or reused is recognized as
+   stale and dropped the next time its list is walked. */
+
+static u32 const BlockCacheSlotCountPow2 = 12;
+static u32 const BlockCacheInstructionCount = 16384;
+static u32 const MaxBlockInstructionCount = 64;
+static u32 const CodeGranuleShift = 4;
+static u32 const BlockCacheCodeLinkCount = 2*BlockCacheInstructionCount;
+static u32 const MaxBlockCodeLinks = 64;
+static u32 const MaxBlockSize = (MaxBlockCodeLinks - 1) << CodeGranuleShift; // NOTE: So its code spans at most MaxBlockCodeLinks granules
+
+// NOTE: Native code for a block (see sim86_jit.h). It returns how many of the block's
+// instructions it executed.
+struct cpu_8086;
+typedef u32 compiled_block(cpu_8086 *CPU);
+
+struct cached_block
+{
+    u32 Key; // NOTE: (cs << 16) | ip
+    u32 Serial; // NOTE: Different for every block decoded since the last reset
+    u32 Start; // NOTE: Absolute address of the first byte
+    u32 Size;
+    
+    u32 FirstInstruction;
+    u32 InstructionCount; // NOTE: Zero for an empty slot
+    
+    u32 ExecutionCount;
+    b32 NotCompilable;
+    compiled_block *Compiled;
+    
+    b32 Threaded; // NOTE: Its threaded code has been built (see sim86_threaded.h)
+};
+
+struct code_link
+{
+    u32 Next; // NOTE: One more than the index of the next link for the same granule, or zero
+    u32 Slot; // NOTE: Index of the block in Blocks
+    u32 Serial;
+};
+
+struct block_cache_stats
+{
+    u64 Lookups;
+    u64 Hits;
+    u64 BlocksDecoded;
+    u64 InstructionsDecoded;
+    u64 Invalidations;
+    u64 Flushes;
+};
+
+struct block_cache
+{
+    u32 MemoryMask;
+    u32 Generation;
+    
+    cached_block Blocks[1 << BlockCacheSlotCountPow2];
+    
+    // NOTE: Decoded instructions are handed out to blocks in order, and are only reclaimed
+    // all at once, by flushing the whole cache when they run out. Each block is followed by
+    // one unused entry, so that anything kept per instruction alongside this array has room
+    // to mark where the block ends.
+    u32 InstructionsUsed;
+    instruction Instructions[BlockCacheInstructionCount];
+    
+    // NOTE: The number of cached blocks with code in each granule of the 1MB of memory.
+    u16 CodeGranules[1 << (20 - CodeGranuleShift)];
+    
+    // NOTE: The blocks with code in each granule, as one more than the index of the first
+    // link in CodeLinks (zero for none). Links are handed out in order and reclaimed along
+    // with the instructions, by flushing the cache.
+    u32 CodeLinkHeads[1 << (20 - CodeGranuleShift)];
+    u32 CodeLinksUsed;
+    code_link CodeLinks[BlockCacheCodeLinkCount];
+    u32 NextSerial;
+    
+    block_cache_stats Stats;
+};
+
+static void ResetBlockCache(block_cache *Cache, segmented_access Memory);
+static cached_block *GetCachedBlock(block_cache *Cache, segmented_access Memory, u16 CS, u16 IP, u32 ProgramEnd,
+                                    instruction_table Table, decode_instruction *Decode);
+static void InvalidateCode(block_cache *Cache, u32 Address);
+static void PrintBlockCacheStats(FILE *Dest, char const *FileName, block_cache_stats *Stats);
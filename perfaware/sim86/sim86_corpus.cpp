@@ -0,0 +1,732 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+#include "sim86.h"
+
+// NOTE: The corpus decodes from its own small buffers and only writes text disassembly.
+#define SIM86_MEMORY_IMAGE 0
+#define SIM86_TEXT_JSON 0
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "sim86_instruction.h"
+#include "sim86_instruction_table.h"
+#include "sim86_memory.h"
+#include "sim86_text.h"
+#include "sim86_profiler.h"
+#include "sim86_decode.h"
+
+#include "sim86_instruction.cpp"
+#include "sim86_instruction_table.cpp"
+#include "sim86_memory.cpp"
+#include "sim86_text.cpp"
+#include "sim86_decode.cpp"
+
+/* NOTE: sim86_corpus writes an arbitrarily large stream of 8086 machine code, and the
+   disassembly sim86 should print for it, so that large runs can be checked as well as timed.
+   
+   Every instruction is built from an encoding in sim86_instruction_table.inl: literal bits
+   are copied, every other field is filled at random, and then the displacement and data
+   bytes that the fields call for are appended. MOD and RM are drawn uniformly, so every
+   ModRM form (register, each base/index combination, no/8/16 bit displacement and the
+   direct address) comes up, and so do both settings of W and S, which pick the immediate
+   widths. Prefixes are added only where they mean something: segment overrides on memory
+   operands, lock on the read-modify-write instructions that write to memory, and rep on the
+   string instructions.
+   
+   The expected instruction is built straight from the fields that were chosen, using the
+   REG, MOD/RM and prefix rules from the 8086 manual, and is written alongside the machine code
+   in the same form sim86 prints it. It does not go through the decoder, so the generator also
+   decodes every instruction and treats any difference from what it chose as an error.
+   
+   The stream is the same for the same seed and options on every machine. */
+
+struct random_series
+{
+    u64 State;
+};
+
+static u64 RandomU64(random_series *Series)
+{
+    // NOTE: splitmix64
+    u64 Result = (Series->State += 0x9e3779b97f4a7c15ull);
+    Result = (Result ^ (Result >> 30)) * 0xbf58476d1ce4e5b9ull;
+    Result = (Result ^ (Result >> 27)) * 0x94d049bb133111ebull;
+    Result = Result ^ (Result >> 31);
+    return Result;
+}
+
+static u32 RandomBits(random_series *Series, u32 BitCount)
+{
+    u32 Result = (u32)(RandomU64(Series) >> (64 - BitCount));
+    return Result;
+}
+
+static f64 RandomUnilateral(random_series *Series)
+{
+    f64 Result = (f64)(RandomU64(Series) >> 11) * (1.0 / 9007199254740992.0);
+    return Result;
+}
+
+static b32 RandomPercent(random_series *Series, u32 Percent)
+{
+    b32 Result = (RandomBits(Series, 32) % 100) < Percent;
+    return Result;
+}
+
+struct generated_instruction
+{
+    u32 ByteCount;
+    u8 Bytes[16];
+    
+    b32 Has[Bits_Count];
+    u32 Bits[Bits_Count];
+    instruction Expected;
+    
+    b32 HasMemoryOperand;
+    b32 HasMemoryDestination;
+};
+
+static b32 UsesBits(instruction_encoding *Inst, instruction_bits_usage Usage)
+{
+    b32 Result = false;
+    for(u32 BitsIndex = 0; (BitsIndex < ArrayCount(Inst->Bits)) && Inst->Bits[BitsIndex].Usage; ++BitsIndex)
+    {
+        Result |= (Inst->Bits[BitsIndex].Usage == Usage);
+    }
+    
+    return Result;
+}
+
+static u32 AppendRandomValue(random_series *Series, generated_instruction *Dest, b32 Wide)
+{
+    // NOTE: Returns the value the appended bytes hold, as the 8086 reads them (little-endian).
+    u32 Result = 0;
+    u32 Count = Wide ? 2 : 1;
+    for(u32 Index = 0; Index < Count; ++Index)
+    {
+        u8 Byte = (u8)RandomBits(Series, 8);
+        Dest->Bytes[Dest->ByteCount++] = Byte;
+        Result |= ((u32)Byte << (8*Index));
+    }
+    
+    return Result;
+}
+
+static instruction_operand ExpectedRegisterOperand(u32 IntelRegIndex, b32 Wide)
+{
+    // NOTE: The REG field table from the 8086 manual: with W=1 the encodings are
+    // ax cx dx bx sp bp si di, and with W=0 they are al cl dl bl ah ch dh bh.
+    u32 const WideRegisters[8] = {Register_a, Register_c, Register_d, Register_b,
+                                  Register_sp, Register_bp, Register_si, Register_di};
+    
+    instruction_operand Result = {};
+    Result.Type = Operand_Register;
+    if(Wide)
+    {
+        Result.Register = RegisterAccess(WideRegisters[IntelRegIndex], 0, 2);
+    }
+    else
+    {
+        Result.Register = RegisterAccess(WideRegisters[IntelRegIndex & 0x3], IntelRegIndex >> 2, 1);
+    }
+    
+    return Result;
+}
+
+static instruction_operand ExpectedMemoryOperand(u32 Mod, u32 RM, s16 Displacement)
+{
+    // NOTE: The R/M field table from the 8086 manual: bx+si, bx+di, bp+si, bp+di, si, di,
+    // bp and bx, except that MOD 00 with R/M 110 is a direct address instead of [bp].
+    u32 const Base[8] = {Register_b, Register_b, Register_bp, Register_bp,
+                         Register_si, Register_di, Register_bp, Register_b};
+    u32 const Index[8] = {Register_si, Register_di, Register_si, Register_di,
+                          Register_none, Register_none, Register_none, Register_none};
+    
+    u32 Term0 = Base[RM];
+    u32 Term1 = Index[RM];
+    if((Mod == 0b00) && (RM == 0b110))
+    {
+        Term0 = Register_none;
+    }
+    
+    instruction_operand Result = EffectiveAddressOperand(RegisterAccess(Term0, 0, 2), RegisterAccess(Term1, 0, 2), Displacement);
+    return Result;
+}
+
+static instruction BuildExpectedInstruction(operation_type Op, b32 *Has, u32 *Bits)
+{
+    instruction Result = {};
+    Result.Op = Op;
+    
+    if(Bits[Bits_W])
+    {
+        Result.Flags |= Inst_Wide;
+    }
+    
+    if(Bits[Bits_Far])
+    {
+        Result.Flags |= Inst_Far;
+    }
+    
+    if(Has[Bits_Z] && !Bits[Bits_Z])
+    {
+        Result.Flags |= Inst_RepNE;
+    }
+    
+    // NOTE: D=1 means REG is the destination. Whatever is left over (an immediate, a jump
+    // displacement, the shift count) goes in the operand REG and R/M did not use.
+    instruction_operand *RegOperand = &Result.Operands[Bits[Bits_D] ? 0 : 1];
+    instruction_operand *ModOperand = &Result.Operands[Bits[Bits_D] ? 1 : 0];
+    
+    if(Has[Bits_SR])
+    {
+        *RegOperand = RegisterOperand(Register_es + Bits[Bits_SR], 2);
+    }
+    
+    if(Has[Bits_REG])
+    {
+        *RegOperand = ExpectedRegisterOperand(Bits[Bits_REG], Bits[Bits_W]);
+    }
+    
+    s16 Displacement = (s16)Bits[Bits_Disp];
+    if(Has[Bits_MOD])
+    {
+        if(Bits[Bits_MOD] == 0b11)
+        {
+            *ModOperand = ExpectedRegisterOperand(Bits[Bits_RM], Bits[Bits_W] || Bits[Bits_RMRegAlwaysW]);
+        }
+        else
+        {
+            *ModOperand = ExpectedMemoryOperand(Bits[Bits_MOD], Bits[Bits_RM], Displacement);
+        }
+    }
+    
+    if(Has[Bits_Data] && Has[Bits_Disp] && !Has[Bits_MOD])
+    {
+        // NOTE: The far forms of call and jmp, which give the offset and then the segment.
+        Result.Operands[0] = IntersegmentAddressOperand(Bits[Bits_Data], Bits[Bits_Disp]);
+    }
+    else
+    {
+        instruction_operand *LastOperand = &Result.Operands[Result.Operands[0].Type ? 1 : 0];
+        if(Bits[Bits_RelJMPDisp])
+        {
+            *LastOperand = ImmediateOperand(Displacement, Immediate_RelativeJumpDisplacement);
+        }
+        else if(Has[Bits_Data])
+        {
+            *LastOperand = ImmediateOperand(Bits[Bits_Data]);
+        }
+        else if(Has[Bits_V])
+        {
+            *LastOperand = Bits[Bits_V] ? RegisterOperand(Register_c, 1) : ImmediateOperand(1);
+        }
+    }
+    
+    return Result;
+}
+
+static generated_instruction GenerateEncoding(random_series *Series, instruction_encoding *Inst)
+{
+    generated_instruction Result = {};
+    
+    b32 *Has = Result.Has;
+    u32 *Bits = Result.Bits;
+    
+    // NOTE: The register forms of these are not valid 8086 instructions.
+    b32 NeedsMemoryOperand = ((Inst->Op == Op_lea) || (Inst->Op == Op_lds) || (Inst->Op == Op_les) ||
+                              UsesBits(Inst, Bits_Far));
+    
+    u32 BitsPendingCount = 0;
+    for(u32 BitsIndex = 0; BitsIndex < ArrayCount(Inst->Bits); ++BitsIndex)
+    {
+        instruction_bits TestBits = Inst->Bits[BitsIndex];
+        if(TestBits.Usage == Bits_End)
+        {
+            break;
+        }
+        
+        u32 Value = TestBits.Value;
+        if(TestBits.BitCount != 0)
+        {
+            if(TestBits.Usage != Bits_Literal)
+            {
+                Value = RandomBits(Series, TestBits.BitCount);
+                if((TestBits.Usage == Bits_MOD) && NeedsMemoryOperand)
+                {
+                    Value = RandomBits(Series, 32) % 3;
+                }
+            }
+            
+            if(BitsPendingCount == 0)
+            {
+                BitsPendingCount = 8;
+                Result.Bytes[Result.ByteCount++] = 0;
+            }
+            
+            BitsPendingCount -= TestBits.BitCount;
+            Result.Bytes[Result.ByteCount - 1] |= (u8)(Value << BitsPendingCount);
+        }
+        
+        if(TestBits.Usage != Bits_Literal)
+        {
+            Bits[TestBits.Usage] |= (Value << TestBits.Shift);
+            Has[TestBits.Usage] = true;
+        }
+    }
+    
+    // NOTE: The 8086 manual's rules for how many displacement and data bytes follow the
+    // fields. An 8-bit displacement is always sign-extended, and 8-bit data is sign-extended
+    // when S is set.
+    u32 Mod = Bits[Bits_MOD];
+    u32 RM = Bits[Bits_RM];
+    b32 HasMemoryOperand = (Has[Bits_MOD] && (Mod != 0b11));
+    b32 HasDirectAddress = (HasMemoryOperand && (Mod == 0b00) && (RM == 0b110));
+    b32 HasDisp = ((Has[Bits_Disp]) || (HasMemoryOperand && (Mod != 0b00)) || HasDirectAddress);
+    b32 DisplacementIsW = ((Bits[Bits_DispAlwaysW]) || (Mod == 0b10) || HasDirectAddress);
+    b32 DataIsW = ((Bits[Bits_WMakesDataW]) && !Bits[Bits_S] && Bits[Bits_W]);
+    
+    if(HasDisp)
+    {
+        u32 Value = AppendRandomValue(Series, &Result, DisplacementIsW);
+        Bits[Bits_Disp] |= DisplacementIsW ? Value : (u32)(s32)(s8)Value;
+        Has[Bits_Disp] = true;
+    }
+    
+    if(Has[Bits_Data])
+    {
+        u32 Value = AppendRandomValue(Series, &Result, DataIsW);
+        Bits[Bits_Data] |= (DataIsW || !Bits[Bits_S]) ? Value : (u32)(s32)(s8)Value;
+    }
+    
+    Result.Expected = BuildExpectedInstruction(Inst->Op, Has, Bits);
+    Result.Expected.Size = Result.ByteCount;
+    
+    Result.HasMemoryOperand = HasMemoryOperand;
+    Result.HasMemoryDestination = (Result.HasMemoryOperand && (!Bits[Bits_D] || (Inst->Op == Op_xchg)));
+    
+    return Result;
+}
+
+struct corpus_encoding
+{
+    instruction_encoding *Encoding;
+    f64 CumulativeWeight;
+};
+
+struct corpus_generator
+{
+    random_series Series;
+    instruction_table Table;
+    u32 PrefixPercent;
+    
+    u32 EncodingCount;
+    corpus_encoding Encodings[256];
+    
+    instruction_encoding *Lock;
+    instruction_encoding *Rep;
+    instruction_encoding *Segment;
+    
+    u64 ByteCount;
+    u64 InstructionCount;
+    u64 PrefixedCount;
+    u64 MismatchCount;
+};
+
+static b32 IsLockable(operation_type Op)
+{
+    b32 Result = ((Op == Op_add) || (Op == Op_adc) || (Op == Op_sub) || (Op == Op_sbb) ||
+                  (Op == Op_and) || (Op == Op_or) || (Op == Op_xor) || (Op == Op_inc) ||
+                  (Op == Op_dec) || (Op == Op_neg) || (Op == Op_not) || (Op == Op_xchg));
+    return Result;
+}
+
+static b32 IsString(operation_type Op)
+{
+    b32 Result = ((Op == Op_movs) || (Op == Op_cmps) || (Op == Op_scas) ||
+                  (Op == Op_lods) || (Op == Op_stos));
+    return Result;
+}
+
+static b32 InitCorpusGenerator(corpus_generator *Generator, u64 Seed, u32 PrefixPercent, f64 *MnemonicWeights)
+{
+    Generator->Series.State = Seed;
+    Generator->Table = Get8086InstructionTable();
+    Generator->PrefixPercent = PrefixPercent;
+    
+    u32 EncodingsPerOp[Op_Count] = {};
+    for(u32 Index = 0; Index < Generator->Table.EncodingCount; ++Index)
+    {
+        ++EncodingsPerOp[Generator->Table.Encodings[Index].Op];
+    }
+    
+    // NOTE: A mnemonic's weight is shared between its encodings, so that the mix is a mix
+    // of operations however many ways the table has of encoding each one.
+    f64 TotalWeight = 0;
+    for(u32 Index = 0; Index < Generator->Table.EncodingCount; ++Index)
+    {
+        instruction_encoding *Inst = &Generator->Table.Encodings[Index];
+        if(Inst->Op == Op_lock)
+        {
+            Generator->Lock = Inst;
+        }
+        else if(Inst->Op == Op_rep)
+        {
+            Generator->Rep = Inst;
+        }
+        else if(Inst->Op == Op_segment)
+        {
+            Generator->Segment = Inst;
+        }
+        else if(MnemonicWeights[Inst->Op] > 0)
+        {
+            assert(Generator->EncodingCount < ArrayCount(Generator->Encodings));
+            
+            TotalWeight += MnemonicWeights[Inst->Op] / (f64)EncodingsPerOp[Inst->Op];
+            corpus_encoding *Encoding = &Generator->Encodings[Generator->EncodingCount++];
+            Encoding->Encoding = Inst;
+            Encoding->CumulativeWeight = TotalWeight;
+        }
+    }
+    
+    for(u32 Index = 0; Index < Generator->EncodingCount; ++Index)
+    {
+        Generator->Encodings[Index].CumulativeWeight /= TotalWeight;
+    }
+    
+    b32 Result = (Generator->EncodingCount != 0);
+    return Result;
+}
+
+static instruction_encoding *PickEncoding(corpus_generator *Generator)
+{
+    f64 Pick = RandomUnilateral(&Generator->Series);
+    
+    u32 Low = 0;
+    u32 High = Generator->EncodingCount - 1;
+    while(Low < High)
+    {
+        u32 Mid = (Low + High) / 2;
+        if(Generator->Encodings[Mid].CumulativeWeight <= Pick)
+        {
+            Low = Mid + 1;
+        }
+        else
+        {
+            High = Mid;
+        }
+    }
+    
+    instruction_encoding *Result = Generator->Encodings[Low].Encoding;
+    return Result;
+}
+
+static void AppendGenerated(generated_instruction *Dest, generated_instruction Source)
+{
+    memcpy(Dest->Bytes + Dest->ByteCount, Source.Bytes, Source.ByteCount);
+    Dest->ByteCount += Source.ByteCount;
+}
+
+static b32 InstructionsMatch(instruction A, instruction B)
+{
+    b32 Result = ((A.Op == B.Op) &&
+                  (A.Size == B.Size) &&
+                  (A.Flags == B.Flags) &&
+                  (A.SegmentOverride == B.SegmentOverride) &&
+                  (memcmp(A.Operands, B.Operands, sizeof(A.Operands)) == 0));
+    return Result;
+}
+
+static void ReportMismatch(generated_instruction *Generated, instruction Decoded)
+{
+    fprintf(stderr, "ERROR: Generated");
+    for(u32 Index = 0; Index < Generated->ByteCount; ++Index)
+    {
+        fprintf(stderr, " %02x", Generated->Bytes[Index]);
+    }
+    
+    char Memory[512];
+    text_buffer Text = TextBuffer(sizeof(Memory), Memory, stderr);
+    AppendString(&Text, " as \"");
+    FormatInstruction(&Text, Generated->Expected);
+    AppendString(&Text, "\" (");
+    AppendU32(&Text, Generated->Expected.Size);
+    AppendString(&Text, " bytes), but it decodes as \"");
+    FormatInstruction(&Text, Decoded);
+    AppendString(&Text, "\" (");
+    AppendU32(&Text, Decoded.Size);
+    AppendString(&Text, " bytes).\n");
+    FlushTextBuffer(&Text);
+}
+
+static generated_instruction GenerateInstruction(corpus_generator *Generator)
+{
+    random_series *Series = &Generator->Series;
+    
+    instruction_encoding *Inst = PickEncoding(Generator);
+    generated_instruction Body = GenerateEncoding(Series, Inst);
+    
+    generated_instruction Result = {};
+    instruction Expected = Body.Expected;
+    if(Body.HasMemoryDestination && IsLockable(Inst->Op) && RandomPercent(Series, Generator->PrefixPercent))
+    {
+        AppendGenerated(&Result, GenerateEncoding(Series, Generator->Lock));
+        Expected.Flags |= Inst_Lock;
+    }
+    
+    if(IsString(Inst->Op) && RandomPercent(Series, Generator->PrefixPercent))
+    {
+        generated_instruction Rep = GenerateEncoding(Series, Generator->Rep);
+        AppendGenerated(&Result, Rep);
+        Expected.Flags |= Inst_Rep;
+        if(!Rep.Bits[Bits_Z])
+        {
+            Expected.Flags |= Inst_RepNE;
+        }
+    }
+    
+    if(Body.HasMemoryOperand && RandomPercent(Series, Generator->PrefixPercent))
+    {
+        generated_instruction Segment = GenerateEncoding(Series, Generator->Segment);
+        AppendGenerated(&Result, Segment);
+        Expected.Flags |= Inst_Segment;
+        Expected.SegmentOverride = Register_es + Segment.Bits[Bits_SR];
+    }
+    
+    if(Result.ByteCount)
+    {
+        ++Generator->PrefixedCount;
+    }
+    
+    AppendGenerated(&Result, Body);
+    Expected.Size = Result.ByteCount;
+    Result.Expected = Expected;
+    
+    // NOTE: A source this short is decoded from a zeroed guard buffer, so nothing past the
+    // generated bytes can make the decode come out right by accident.
+    instruction Decoded = DecodeInstructionFromBuffer(Generator->Table, Result.ByteCount, Result.Bytes);
+    
+    if(!InstructionsMatch(Expected, Decoded))
+    {
+        if(Generator->MismatchCount < 16)
+        {
+            ReportMismatch(&Result, Decoded);
+        }
+        ++Generator->MismatchCount;
+    }
+    
+    Generator->ByteCount += Result.ByteCount;
+    ++Generator->InstructionCount;
+    
+    return Result;
+}
+
+static u64 ParseByteCount(char const *Text)
+{
+    char *End = 0;
+    u64 Result = strtoull(Text, &End, 10);
+    if(End)
+    {
+        switch(*End)
+        {
+            case 'k': case 'K': {Result <<= 10;} break;
+            case 'm': case 'M': {Result <<= 20;} break;
+            case 'g': case 'G': {Result <<= 30;} break;
+        }
+    }
+    
+    return Result;
+}
+
+static b32 ParseMix(char const *Text, f64 *MnemonicWeights)
+{
+    // NOTE: The mix is a comma-separated list of mnemonic:weight pairs, applied in order.
+    // "*" stands for every mnemonic, so "*:0,mov:3,add:1" generates only mov and add.
+    b32 Result = true;
+    
+    while(Result && *Text)
+    {
+        char const *Colon = strchr(Text, ':');
+        if(Colon)
+        {
+            u32 NameLength = (u32)(Colon - Text);
+            f64 Weight = atof(Colon + 1);
+            
+            b32 Found = false;
+            for(u32 Op = 1; Op < Op_Count; ++Op)
+            {
+                if(((NameLength == 1) && (Text[0] == '*')) ||
+                   ((OpcodeMnemonicLengths[Op] == NameLength) && (strncmp(OpcodeMnemonics[Op], Text, NameLength) == 0)))
+                {
+                    MnemonicWeights[Op] = Weight;
+                    Found = true;
+                }
+            }
+            
+            if(!Found)
+            {
+                fprintf(stderr, "ERROR: Unknown mnemonic \"%.*s\" in --mix.\n", NameLength, Text);
+                Result = false;
+            }
+            
+            char const *Comma = strchr(Colon, ',');
+            Text = Comma ? (Comma + 1) : (Colon + strlen(Colon));
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: Expected mnemonic:weight in --mix, got \"%s\".\n", Text);
+            Result = false;
+        }
+    }
+    
+    return Result;
+}
+
+int main(int ArgCount, char **Args)
+{
+    u64 Seed = 8086;
+    u64 TargetByteCount = 1024*1024;
+    u64 TargetInstructionCount = 0;
+    u32 PrefixPercent = 10;
+    char *BinaryFileName = 0;
+    char *ExpectedFileName = 0;
+    
+    // NOTE: esc is left out by default, because the table gives it a data byte that real
+    // 8086 esc instructions do not have.
+    f64 MnemonicWeights[Op_Count] = {};
+    for(u32 Op = 1; Op < Op_Count; ++Op)
+    {
+        MnemonicWeights[Op] = 1.0;
+    }
+    MnemonicWeights[Op_esc] = 0;
+    
+    b32 ValidArgs = true;
+    for(int ArgIndex = 1; ValidArgs && (ArgIndex < ArgCount); ++ArgIndex)
+    {
+        char *Arg = Args[ArgIndex];
+        if(strncmp(Arg, "--seed=", 7) == 0)
+        {
+            Seed = strtoull(Arg + 7, 0, 10);
+        }
+        else if(strncmp(Arg, "--bytes=", 8) == 0)
+        {
+            TargetByteCount = ParseByteCount(Arg + 8);
+            TargetInstructionCount = 0;
+        }
+        else if(strncmp(Arg, "--count=", 8) == 0)
+        {
+            TargetInstructionCount = ParseByteCount(Arg + 8);
+            TargetByteCount = 0;
+        }
+        else if(strncmp(Arg, "--prefixes=", 11) == 0)
+        {
+            PrefixPercent = atoi(Arg + 11);
+        }
+        else if(strncmp(Arg, "--mix=", 6) == 0)
+        {
+            ValidArgs = ParseMix(Arg + 6, MnemonicWeights);
+        }
+        else if(strncmp(Arg, "--", 2) == 0)
+        {
+            fprintf(stderr, "ERROR: Unrecognized option %s.\n", Arg);
+            ValidArgs = false;
+        }
+        else if(!BinaryFileName)
+        {
+            BinaryFileName = Arg;
+        }
+        else if(!ExpectedFileName)
+        {
+            ExpectedFileName = Arg;
+        }
+        else
+        {
+            ValidArgs = false;
+        }
+    }
+    
+    int ExitCode = 0;
+    corpus_generator Generator = {};
+    if(ValidArgs && BinaryFileName && ExpectedFileName)
+    {
+        if(InitCorpusGenerator(&Generator, Seed, PrefixPercent, MnemonicWeights))
+        {
+            FILE *BinaryFile = fopen(BinaryFileName, "wb");
+            FILE *ExpectedFile = fopen(ExpectedFileName, "wb");
+            if(BinaryFile && ExpectedFile)
+            {
+                static char BinaryMemory[64*1024];
+                static char ExpectedMemory[256*1024];
+                text_buffer Binary = TextBuffer(sizeof(BinaryMemory), BinaryMemory, BinaryFile);
+                text_buffer Expected = TextBuffer(sizeof(ExpectedMemory), ExpectedMemory, ExpectedFile);
+                
+                AppendFileHeader(&Expected, BinaryFileName);
+                
+                while(TargetInstructionCount ?
+                      (Generator.InstructionCount < TargetInstructionCount) :
+                      (Generator.ByteCount < TargetByteCount))
+                {
+                    generated_instruction Instruction = GenerateInstruction(&Generator);
+                    AppendText(&Binary, Instruction.ByteCount, (char *)Instruction.Bytes);
+                    FormatInstruction(&Expected, Instruction.Expected);
+                    AppendChar(&Expected, '\n');
+                }
+                
+                FlushTextBuffer(&Binary);
+                FlushTextBuffer(&Expected);
+                
+                fprintf(stderr, "%s: %llu bytes, %llu instructions (%llu prefixed), seed %llu\n",
+                        BinaryFileName, Generator.ByteCount, Generator.InstructionCount,
+                        Generator.PrefixedCount, Seed);
+                if(Generator.MismatchCount)
+                {
+                    fprintf(stderr, "ERROR: %llu generated instructions did not decode as generated.\n",
+                            Generator.MismatchCount);
+                    ExitCode = 1;
+                }
+            }
+            else
+            {
+                fprintf(stderr, "ERROR: Unable to open %s for writing.\n", BinaryFile ? ExpectedFileName : BinaryFileName);
+                ExitCode = 1;
+            }
+            
+            if(BinaryFile)
+            {
+                fclose(BinaryFile);
+            }
+            
+            if(ExpectedFile)
+            {
+                fclose(ExpectedFile);
+            }
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: The --mix leaves no instructions to generate.\n");
+            ExitCode = 1;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "USAGE: %s [--seed=N] [--bytes=N[k|m|g] | --count=N] [--prefixes=PERCENT] [--mix=mnemonic:weight,...] [output file] [expected disassembly file]\n", Args[0]);
+        ExitCode = 1;
+    }
+    
+    return ExitCode;
+}
@@ -0,0 +1,174 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Hardware counters come from perf_event_open, so they only exist on Linux, and even
+   there a kernel, container or VM may refuse some or all of them (see
+   /proc/sys/kernel/perf_event_paranoid). Anything that cannot be opened simply reads as
+   unavailable, and everywhere else this compiles to nothing but that.
+   
+   The counters only count this process in user mode, which is all the decoder runs in and
+   is what an unprivileged process is allowed to count. */
+
+static char const *PerfCounterNames[PerfCounter_Count] =
+{
+    "instructions retired",
+    "branch misses",
+    "cache misses",
+    "page faults",
+};
+
+#if __linux__
+
+static int OpenPerfCounter(u32 Type, u64 Config)
+{
+    perf_event_attr Attr = {};
+    Attr.type = Type;
+    Attr.size = sizeof(Attr);
+    Attr.config = Config;
+    Attr.exclude_kernel = 1;
+    Attr.exclude_hv = 1;
+    
+    int Result = (int)syscall(__NR_perf_event_open, &Attr, 0, -1, -1, 0);
+    return Result;
+}
+
+static perf_counters OpenPerfCounters(void)
+{
+    perf_counters Result = {};
+    
+    Result.FileDescriptors[PerfCounter_Instructions] = OpenPerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    Result.FileDescriptors[PerfCounter_BranchMisses] = OpenPerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    Result.FileDescriptors[PerfCounter_CacheMisses] = OpenPerfCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    Result.FileDescriptors[PerfCounter_PageFaults] = OpenPerfCounter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS);
+    
+    return Result;
+}
+
+static void ClosePerfCounters(perf_counters *Counters)
+{
+    for(u32 Kind = 0; Kind < PerfCounter_Count; ++Kind)
+    {
+        if(Counters->FileDescriptors[Kind] >= 0)
+        {
+            close(Counters->FileDescriptors[Kind]);
+        }
+        Counters->FileDescriptors[Kind] = -1;
+    }
+}
+
+static perf_counter_values ReadPerfCounters(perf_counters *Counters)
+{
+    perf_counter_values Result = {};
+    
+    for(u32 Kind = 0; Kind < PerfCounter_Count; ++Kind)
+    {
+        int FileDescriptor = Counters->FileDescriptors[Kind];
+        if(FileDescriptor >= 0)
+        {
+            u64 Value = 0;
+            if(read(FileDescriptor, &Value, sizeof(Value)) == sizeof(Value))
+            {
+                Result.Values[Kind] = Value;
+            }
+        }
+    }
+    
+    return Result;
+}
+
+#else
+
+static perf_counters OpenPerfCounters(void)
+{
+    perf_counters Result = {};
+    
+    for(u32 Kind = 0; Kind < PerfCounter_Count; ++Kind)
+    {
+        Result.FileDescriptors[Kind] = -1;
+    }
+    
+    return Result;
+}
+
+static void ClosePerfCounters(perf_counters *Counters)
+{
+}
+
+static perf_counter_values ReadPerfCounters(perf_counters *Counters)
+{
+    perf_counter_values Result = {};
+    return Result;
+}
+
+#endif
+
+static b32 IsAvailable(perf_counters *Counters, perf_counter_kind Kind)
+{
+    b32 Result = (Counters->FileDescriptors[Kind] >= 0);
+    return Result;
+}
+
+static b32 AnyAvailable(perf_counters *Counters)
+{
+    b32 Result = false;
+    for(u32 Kind = 0; Kind < PerfCounter_Count; ++Kind)
+    {
+        Result |= IsAvailable(Counters, (perf_counter_kind)Kind);
+    }
+    
+    return Result;
+}
+
+static perf_counter_values operator+(perf_counter_values A, perf_counter_values B)
+{
+    perf_counter_values Result = {};
+    for(u32 Kind = 0; Kind < PerfCounter_Count; ++Kind)
+    {
+        Result.Values[Kind] = A.Values[Kind] + B.Values[Kind];
+    }
+    
+    return Result;
+}
+
+static perf_counter_values operator-(perf_counter_values A, perf_counter_values B)
+{
+    perf_counter_values Result = {};
+    for(u32 Kind = 0; Kind < PerfCounter_Count; ++Kind)
+    {
+        Result.Values[Kind] = A.Values[Kind] - B.Values[Kind];
+    }
+    
+    return Result;
+}
+
+static void PrintPerfCounters(FILE *Dest, perf_counters *Counters, perf_counter_values Values, u64 InstructionCount)
+{
+    // NOTE: "Instruction" in the per-instruction figures means a decoded 8086 instruction,
+    // not one the host CPU retired.
+    for(u32 Kind = 0; Kind < PerfCounter_Count; ++Kind)
+    {
+        fprintf(Dest, "    %-22s", PerfCounterNames[Kind]);
+        if(IsAvailable(Counters, (perf_counter_kind)Kind))
+        {
+            fprintf(Dest, " %14llu", Values.Values[Kind]);
+            if(InstructionCount)
+            {
+                fprintf(Dest, "  (%.3f per 8086 instruction)", (f64)Values.Values[Kind] / (f64)InstructionCount);
+            }
+        }
+        else
+        {
+            fprintf(Dest, " %14s", "unavailable");
+        }
+        fprintf(Dest, "\n");
+    }
+}
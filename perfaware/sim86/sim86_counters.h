@@ -0,0 +1,42 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+enum perf_counter_kind : u32
+{
+    PerfCounter_Instructions,
+    PerfCounter_BranchMisses,
+    PerfCounter_CacheMisses,
+    PerfCounter_PageFaults,
+    
+    PerfCounter_Count,
+};
+
+struct perf_counters
+{
+    // NOTE: Each counter is opened on its own, so that one the kernel or the CPU will not
+    // provide (FileDescriptors[Kind] < 0) does not take the others down with it.
+    int FileDescriptors[PerfCounter_Count];
+};
+
+struct perf_counter_values
+{
+    u64 Values[PerfCounter_Count];
+};
+
+static perf_counters OpenPerfCounters(void);
+static void ClosePerfCounters(perf_counters *Counters);
+static b32 IsAvailable(perf_counters *Counters, perf_counter_kind Kind);
+static b32 AnyAvailable(perf_counters *Counters);
+static perf_counter_values ReadPerfCounters(perf_counters *Counters);
+static perf_counter_values operator+(perf_counter_values A, perf_counter_values B);
+static perf_counter_values operator-(perf_counter_values A, perf_counter_values B);
+static void PrintPerfCounters(FILE *Dest, perf_counters *Counters, perf_counter_values Values, u64 InstructionCount);
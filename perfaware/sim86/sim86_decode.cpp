@@ -10,28 +10,6 @@
    
    ======================================================================== */
 
-enum register_mapping_8086
-{
-    Register_none,
-    
-    Register_a,
-    Register_b,
-    Register_c,
-    Register_d,
-    Register_sp,
-    Register_bp,
-    Register_si,
-    Register_di,
-    Register_es,
-    Register_cs,
-    Register_ss,
-    Register_ds,
-    Register_ip,
-    Register_flags,
-    
-    Register_count,
-};
-
 struct decode_context
 {
     u32 DefaultSegment;
@@ -60,10 +38,55 @@ static instruction_operand GetRegOperand(u32 IntelRegIndex, b32 Wide)
     return Result;
 }
 
+static constexpr modrm_table BuildModRMTable(void)
+{
+    modrm_table Result = {};
+    
+    u8 const IntelTerm0[8] = { Register_b,  Register_b, Register_bp, Register_bp, Register_si, Register_di, Register_bp, Register_b};
+    u8 const IntelTerm1[8] = {Register_si, Register_di, Register_si, Register_di};
+    
+    for(u32 ModRM = 0; ModRM < 256; ++ModRM)
+    {
+        u32 Mod = (ModRM >> 6);
+        u32 RM = (ModRM & 0x7);
+        
+        modrm_entry Entry = {};
+        if(Mod == 0b11)
+        {
+            Entry.Flags = ModRM_Register;
+        }
+        else if((Mod == 0b00) && (RM == 0b110))
+        {
+            Entry.DisplacementByteCount = 2;
+            Entry.Flags = ModRM_DirectAddress;
+        }
+        else
+        {
+            Entry.Term0 = IntelTerm0[RM];
+            Entry.Term1 = IntelTerm1[RM];
+            Entry.DisplacementByteCount = (u8)Mod;
+        }
+        
+        Result.Entries[ModRM] = Entry;
+    }
+    
+    return Result;
+}
+
+// NOTE: MOD and RM are only ever looked up here, by the decoders and the length decoder,
+// so effective addresses never branch on the ModRM form beyond the register/memory split.
+static constexpr modrm_table ModRMTable8086 = BuildModRMTable();
+
+static modrm_entry GetModRMEntry(u32 Mod, u32 RM)
+{
+    modrm_entry Result = ModRMTable8086.Entries[((Mod & 0x3) << 6) | (RM & 0x7)];
+    return Result;
+}
+
 // NOTE(casey): ParseDataValue is not a real function, it's basically just a macro that is used in
 // TryParse. It should never be called otherwise, but that is not something you can do in C++.
 // In other languages it would be a "local function".
-static u32 ParseDataValue(segmented_access *Access, b32 Exists, b32 Wide, b32 SignExtended)
+static u32 ParseDataValue(u8 **At, b32 Exists, b32 Wide, b32 SignExtended)
 {
     u32 Result = {};
     
@@ -71,33 +94,156 @@ static u32 ParseDataValue(segmented_access *Access, b32 Exists, b32 Wide, b32 Si
     {
         if(Wide)
         {
-            u8 D0 = *AccessMemory(*Access, 0);
-            u8 D1 = *AccessMemory(*Access, 1);
-            Result = (D1 << 8) | D0;
-            Access->SegmentOffset += 2;
+            // NOTE: 8086 data is little-endian, like every host sim86 builds for, so this is
+            // one unaligned load.
+            u16 Value;
+            memcpy(&Value, *At, sizeof(Value));
+            Result = Value;
+            *At += 2;
         }
         else
         {
-            Result = *AccessMemory(*Access);
+            Result = **At;
             if(SignExtended)
             {
                 Result = (s32)*(s8 *)&Result;
             }
-            Access->SegmentOffset += 1;
+            *At += 1;
         }
     }
     
     return Result;
 }
 
-static instruction TryDecode(decode_context *Context, instruction_encoding *Inst, segmented_access At)
+// NOTE: FinishDecode takes the fields matched by TryDecode (or by one of the specialized
+// decoders in sim86_decode_specialized.cpp), reads any displacement and data that follow
+// them, and builds the operands. It is shared so that all the decoders produce identical
+// instructions. At is just past the fields, and Start is the instruction's first byte.
+static force_inline instruction FinishDecode(decode_context *Context, operation_type Op, b32 *Has, u32 *Bits,
+                                             u8 *At, u8 *Start)
 {
+    instruction Dest = {};
+    
+    u32 Mod = Bits[Bits_MOD];
+    u32 RM = Bits[Bits_RM];
+    u32 W = Bits[Bits_W];
+    b32 S = Bits[Bits_S];
+    b32 D = Bits[Bits_D];
+    
+    modrm_entry ModRM = GetModRMEntry(Mod, RM);
+    Has[Bits_Disp] = ((Has[Bits_Disp]) || (ModRM.DisplacementByteCount != 0));
+
+    b32 DisplacementIsW = ((Bits[Bits_DispAlwaysW]) || (ModRM.DisplacementByteCount == 2));
+    b32 DataIsW = ((Bits[Bits_WMakesDataW]) && !S && W);
+    
+    Bits[Bits_Disp] |= ParseDataValue(&At, Has[Bits_Disp], DisplacementIsW, (!DisplacementIsW));
+    Bits[Bits_Data] |= ParseDataValue(&At, Has[Bits_Data], DataIsW, S);
+    
+    Dest.Op = Op;
+    Dest.Flags = Context->AdditionalFlags;
+    Dest.Size = (u32)(At - Start);
+    Dest.SegmentOverride = Context->DefaultSegment;
+    
+    if(W)
+    {
+        Dest.Flags |= Inst_Wide;
+    }
+
+    if(Bits[Bits_Far])
+    {
+        Dest.Flags |= Inst_Far;
+    }
+    
+    if(Has[Bits_Z])
+    {
+        // NOTE: Only the rep prefix has a Z bit, and the last rep prefix is the one that counts.
+        Dest.Flags &= ~Inst_RepNE;
+        if(!Bits[Bits_Z])
+        {
+            Dest.Flags |= Inst_RepNE;
+        }
+    }
+    
+    u32 Disp = Bits[Bits_Disp];
+    s16 Displacement = (s16)Disp;
+    
+    instruction_operand *RegOperand = &Dest.Operands[D ? 0 : 1];
+    instruction_operand *ModOperand = &Dest.Operands[D ? 1 : 0];
+    
+    if(Has[Bits_SR])
+    {
+        *RegOperand = RegisterOperand(Register_es + (Bits[Bits_SR] & 0x3), 2);
+    }
+    
+    if(Has[Bits_REG])
+    {
+        *RegOperand = GetRegOperand(Bits[Bits_REG], W);
+    }
+    
+    if(Has[Bits_MOD])
+    {
+        if(ModRM.Flags & ModRM_Register)
+        {
+            *ModOperand = GetRegOperand(RM, W || (Bits[Bits_RMRegAlwaysW]));
+        }
+        else
+        {
+            *ModOperand = EffectiveAddressOperand(RegisterAccess(ModRM.Term0, 0, 2), RegisterAccess(ModRM.Term1, 0, 2), Displacement);
+        }
+    }
+    
+    if(Has[Bits_Data] && Has[Bits_Disp] && !Has[Bits_MOD])
+    {
+        Dest.Operands[0] = IntersegmentAddressOperand(Bits[Bits_Data], Bits[Bits_Disp]);
+    }
+    else
+    {
+        //
+        // NOTE(casey): Because there are some strange opcodes that do things like have an immediate as
+        // a _destination_ ("out", for example), I define immediates and other "additional operands" to
+        // go in "whatever slot was not used by the reg and mod fields".
+        //
+        
+        instruction_operand *LastOperand = &Dest.Operands[0];
+        if(LastOperand->Type)
+        {
+            LastOperand = &Dest.Operands[1];
+        }
+        
+        if(Bits[Bits_RelJMPDisp])
+        {
+            *LastOperand = ImmediateOperand(Displacement, Immediate_RelativeJumpDisplacement);
+        }
+        else if(Has[Bits_Data])
+        {
+            *LastOperand = ImmediateOperand(Bits[Bits_Data]);
+        }
+        else if(Has[Bits_V])
+        {
+            if(Bits[Bits_V])
+            {
+                *LastOperand = RegisterOperand(Register_c, 1);
+            }
+            else
+            {
+                *LastOperand = ImmediateOperand(1);
+            }
+        }
+    }
+    
+    return Dest;
+}
+
+static instruction TryDecode(decode_context *Context, instruction_encoding *Inst, u8 *Start)
+{
+    TimeFunction;
+    
     instruction Dest = {};
     b32 Has[Bits_Count] = {};
     u32 Bits[Bits_Count] = {};
     b32 Valid = true;
     
-    u64 StartingAddress = GetAbsoluteAddressOf(At);
+    u8 *At = Start;
     
     u8 BitsPendingCount = 0;
     u8 BitsPending = 0;
@@ -116,8 +262,7 @@ static instruction TryDecode(decode_context *Context, instruction_encoding *Inst
             if(BitsPendingCount == 0)
             {
                 BitsPendingCount = 8;
-                BitsPending = *AccessMemory(At);
-                ++At.SegmentOffset;
+                BitsPending = *At++;
             }
             
             // NOTE(casey): If this assert fires, it means we have an error in our table,
@@ -145,162 +290,211 @@ static instruction TryDecode(decode_context *Context, instruction_encoding *Inst
     
     if(Valid)
     {
-        u32 Mod = Bits[Bits_MOD];
-        u32 RM = Bits[Bits_RM];
-        u32 W = Bits[Bits_W];
-        b32 S = Bits[Bits_S];
-        b32 D = Bits[Bits_D];
-        
-        b32 HasDirectAddress = ((Mod == 0b00) && (RM == 0b110));
-        Has[Bits_Disp] = ((Has[Bits_Disp]) || (Mod == 0b10) || (Mod == 0b01) || HasDirectAddress);
+        Dest = FinishDecode(Context, Inst->Op, Has, Bits, At, Start);
+    }
+    
+    return Dest;
+}
 
-        b32 DisplacementIsW = ((Bits[Bits_DispAlwaysW]) || (Mod == 0b10) || HasDirectAddress);
-        b32 DataIsW = ((Bits[Bits_WMakesDataW]) && !S && W);
-        
-        Bits[Bits_Disp] |= ParseDataValue(&At, Has[Bits_Disp], DisplacementIsW, (!DisplacementIsW));
-        Bits[Bits_Data] |= ParseDataValue(&At, Has[Bits_Data], DataIsW, S);
-        
-        Dest.Op = Inst->Op;
-        Dest.Flags = Context->AdditionalFlags;
-        Dest.Address = StartingAddress;
-        Dest.Size = GetAbsoluteAddressOf(At) - StartingAddress;
-        Dest.SegmentOverride = Context->DefaultSegment;
-        
-        if(W)
-        {
-            Dest.Flags |= Inst_Wide;
-        }
+static b32 ApplyPrefix(decode_context *Context, instruction Prefix)
+{
+    // NOTE: Returns true if the instruction was actually a prefix, in which case it has
+    // been folded into the context for the instruction that follows it.
+    b32 Result = true;
+    
+    if(Prefix.Op == Op_lock)
+    {
+        Context->AdditionalFlags |= Inst_Lock;
+    }
+    else if(Prefix.Op == Op_rep)
+    {
+        Context->AdditionalFlags = (Prefix.Flags & Inst_RepNE) | (Context->AdditionalFlags & ~Inst_RepNE) | Inst_Rep;
+    }
+    else if(Prefix.Op == Op_segment)
+    {
+        Context->AdditionalFlags |= Inst_Segment;
+        Context->DefaultSegment = Prefix.Operands[1].Register.Index;
+    }
+    else
+    {
+        Result = false;
+    }
+    
+    return Result;
+}
 
-        if(Bits[Bits_Far])
-        {
-            Dest.Flags |= Inst_Far;
-        }
-        
-        u32 Disp = Bits[Bits_Disp];
-        s16 Displacement = (s16)Disp;
-        
-        instruction_operand *RegOperand = &Dest.Operands[D ? 0 : 1];
-        instruction_operand *ModOperand = &Dest.Operands[D ? 1 : 0];
-        
-        if(Has[Bits_SR])
-        {
-            *RegOperand = RegisterOperand(Register_es + (Bits[Bits_SR] & 0x3), 2);
-        }
-        
-        if(Has[Bits_REG])
+// NOTE: GetEncodingShape flattens an instruction_encoding into the literal bits that must
+// match in each byte and the byte/bit position of every field, without reading any memory.
+// The dispatch table, the specialized decoders and the length decoder are all built from it.
+static constexpr encoding_shape GetEncodingShape(instruction_encoding Inst)
+{
+    encoding_shape Result = {};
+    Result.Op = Inst.Op;
+    
+    u32 BitsPendingCount = 0;
+    for(u32 BitsIndex = 0; BitsIndex < ArrayCount(Inst.Bits); ++BitsIndex)
+    {
+        instruction_bits TestBits = Inst.Bits[BitsIndex];
+        if(TestBits.Usage == Bits_End)
         {
-            *RegOperand = GetRegOperand(Bits[Bits_REG], W);
+            break;
         }
         
-        if(Has[Bits_MOD])
+        if(TestBits.BitCount != 0)
         {
-            if(Mod == 0b11)
+            if(BitsPendingCount == 0)
+            {
+                BitsPendingCount = 8;
+                ++Result.ByteCount;
+            }
+            
+            BitsPendingCount -= TestBits.BitCount;
+            
+            u32 ByteIndex = Result.ByteCount - 1;
+            u8 Mask = (u8)~(0xff << TestBits.BitCount);
+            if(TestBits.Usage == Bits_Literal)
             {
-                *ModOperand = GetRegOperand(RM, W || (Bits[Bits_RMRegAlwaysW]));
+                Result.LiteralMask[ByteIndex] |= (u8)(Mask << BitsPendingCount);
+                Result.LiteralValue[ByteIndex] |= (u8)((TestBits.Value & Mask) << BitsPendingCount);
             }
             else
             {
-                register_mapping_8086 IntelTerm0[8] = { Register_b,  Register_b, Register_bp, Register_bp, Register_si, Register_di, Register_bp, Register_b};
-                register_mapping_8086 IntelTerm1[8] = {Register_si, Register_di, Register_si, Register_di};
-                
-                u32 I = RM&0x7;
-                register_mapping_8086 Term0 = IntelTerm0[I];
-                register_mapping_8086 Term1 = IntelTerm1[I];
-                if((Mod == 0b00) && (RM == 0b110))
-                {
-                    Term0 = {};
-                    Term1 = {};
-                }
-                
-                *ModOperand = EffectiveAddressOperand(RegisterAccess(Term0, 0, 2), RegisterAccess(Term1, 0, 2), Displacement);
+                encoding_field_piece *Piece = &Result.Pieces[TestBits.Usage][Result.PieceCount[TestBits.Usage]++];
+                Piece->ByteIndex = (u8)ByteIndex;
+                Piece->BitShift = (u8)BitsPendingCount;
+                Piece->Mask = Mask;
+                Piece->DestShift = TestBits.Shift;
+                Result.Has[TestBits.Usage] = true;
             }
         }
-        
-        if(Has[Bits_Data] && Has[Bits_Disp] && !Has[Bits_MOD])
+        else if(TestBits.Usage != Bits_Literal)
         {
-            Dest.Operands[0] = IntersegmentAddressOperand(Bits[Bits_Data], Bits[Bits_Disp]);
+            Result.ImplicitBits[TestBits.Usage] |= (TestBits.Value << TestBits.Shift);
+            Result.Has[TestBits.Usage] = true;
         }
-        else
+    }
+    
+    return Result;
+}
+
+static constexpr u32 CountSetBits(u32 Value)
+{
+    u32 Result = 0;
+    while(Value)
+    {
+        Result += (Value & 1);
+        Value >>= 1;
+    }
+    
+    return Result;
+}
+
+static instruction_dispatch BuildInstructionDispatch(instruction_table Table)
+{
+    instruction_dispatch Result = {};
+    
+    u32 SecondByteMatches[256] = {};
+    assert(Table.EncodingCount <= ArrayCount(SecondByteMatches));
+    
+    for(u32 Index = 0; Index < Table.EncodingCount; ++Index)
+    {
+        encoding_shape Shape = GetEncodingShape(Table.Encodings[Index]);
+        
+        // NOTE: Encodings that leave more of the second byte free (like the MOD/REG/RM forms
+        // of mov and add) cover more byte patterns, so they are the likelier match and are
+        // tried first. Since no two encodings in the table can match the same bytes, the
+        // order within a slot does not change which encoding is selected.
+        SecondByteMatches[Index] = 256 >> CountSetBits(Shape.LiteralMask[1]);
+        
+        for(u32 Byte = 0; Byte < ArrayCount(Result.Slots); ++Byte)
         {
-            //
-            // NOTE(casey): Because there are some strange opcodes that do things like have an immediate as
-            // a _destination_ ("out", for example), I define immediates and other "additional operands" to
-            // go in "whatever slot was not used by the reg and mod fields".
-            //
-            
-            instruction_operand *LastOperand = &Dest.Operands[0];
-            if(LastOperand->Type)
+            if((Byte & Shape.LiteralMask[0]) == Shape.LiteralValue[0])
             {
-                LastOperand = &Dest.Operands[1];
-            }
-            
-            if(Bits[Bits_RelJMPDisp])
-            {
-                *LastOperand = ImmediateOperand(Displacement, Immediate_RelativeJumpDisplacement);
-            }
-            else if(Has[Bits_Data])
-            {
-                *LastOperand = ImmediateOperand(Bits[Bits_Data]);
-            }
-            else if(Has[Bits_V])
-            {
-                if(Bits[Bits_V])
-                {
-                    *LastOperand = RegisterOperand(Register_c, 1);
-                }
-                else
+                instruction_dispatch_slot *Slot = &Result.Slots[Byte];
+                assert(Slot->EncodingCount < ArrayCount(Slot->EncodingIndex));
+                
+                u32 Insert = Slot->EncodingCount++;
+                while((Insert > 0) &&
+                      (SecondByteMatches[Slot->EncodingIndex[Insert - 1]] < SecondByteMatches[Index]))
                 {
-                    *LastOperand = ImmediateOperand(1);
+                    Slot->EncodingIndex[Insert] = Slot->EncodingIndex[Insert - 1];
+                    --Insert;
                 }
+                Slot->EncodingIndex[Insert] = (u8)Index;
             }
         }
     }
     
-    return Dest;
+    return Result;
+}
+
+static instruction_dispatch *Get8086InstructionDispatch(void)
+{
+    // NOTE: Function-local statics are initialized exactly once, even if several threads
+    // call this at the same time.
+    static instruction_dispatch Dispatch = BuildInstructionDispatch(Get8086InstructionTable());
+    return &Dispatch;
 }
 
 static instruction DecodeInstruction(instruction_table Table, segmented_access At)
 {
-    /* TODO(casey): Hmm. It seems like this is a very inefficient way to parse
-       instructions, isn't it? For every instruction, we check every entry in the
-       table until we find a match. Is this bad design? Or did the person who wrote
-       it know what they were doing, and has a plan for how it can be optimized
-       later? Only time will tell... :) */
+    TimeFunction;
+    
+    /* NOTE: Rather than checking every entry in the table for every instruction, the
+       first byte selects a dispatch slot that lists only the encodings that could match.
+       Tables other than the built-in 8086 one fall back to scanning every entry. */
+    
+    instruction_dispatch *Dispatch = 0;
+    if(Table.Encodings == InstructionTable8086)
+    {
+        Dispatch = Get8086InstructionDispatch();
+    }
     
     decode_context Context = {};
     instruction Result = {};
     
+    u8 Scratch[DecodeWindowSize];
+    u8 *Window = GetLinearWindow(At, DecodeWindowSize, Scratch);
+    
     u32 StartingAddress = GetAbsoluteAddressOf(At);
     u32 TotalSize = 0;
     while(TotalSize < Table.MaxInstructionByteCount)
     {
+        u8 *Bytes = Window + TotalSize;
+        
         Result = {};
-        for(u32 Index = 0; Index < Table.EncodingCount; ++Index)
+        if(Dispatch)
         {
-            instruction_encoding Inst = Table.Encodings[Index];
-            Result = TryDecode(&Context, &Inst, At);
-            if(Result.Op)
+            instruction_dispatch_slot *Slot = &Dispatch->Slots[*Bytes];
+            for(u32 CandidateIndex = 0; CandidateIndex < Slot->EncodingCount; ++CandidateIndex)
             {
-                At.SegmentOffset += Result.Size;
-                TotalSize += Result.Size;
-                break;
+                instruction_encoding *Inst = &Table.Encodings[Slot->EncodingIndex[CandidateIndex]];
+                Result = TryDecode(&Context, Inst, Bytes);
+                if(Result.Op)
+                {
+                    break;
+                }
             }
         }
-        
-        if(Result.Op == Op_lock)
-        {
-            Context.AdditionalFlags |= Inst_Lock;
-        }
-        else if(Result.Op == Op_rep)
+        else
         {
-            Context.AdditionalFlags |= Inst_Rep;
+            for(u32 Index = 0; Index < Table.EncodingCount; ++Index)
+            {
+                instruction_encoding *Inst = &Table.Encodings[Index];
+                Result = TryDecode(&Context, Inst, Bytes);
+                if(Result.Op)
+                {
+                    break;
+                }
+            }
         }
-        else if(Result.Op == Op_segment)
+        
+        if(Result.Op)
         {
-            Context.AdditionalFlags |= Inst_Segment;
-            Context.DefaultSegment = Result.Operands[1].Register.Index;
+            TotalSize += Result.Size;
         }
-        else
+        
+        if(!ApplyPrefix(&Context, Result))
         {
             break;
         }
@@ -316,5 +510,25 @@ static instruction DecodeInstruction(instruction_table Table, segmented_access A
         Result = {};
     }
     
+    CountProfileBytes(Result.Size);
+    
+    return Result;
+}
+
+static instruction DecodeInstructionFromBuffer(instruction_table Table, u64 SourceSize, u8 *Source,
+                                               decode_instruction *Decode)
+{
+    // NOTE: The decoder reads a full DecodeWindowSize bytes, so only a source too short to
+    // hold that window is copied into a zeroed guard buffer.
+    u8 GuardBuffer[DecodeWindowSize];
+    if(SourceSize < sizeof(GuardBuffer))
+    {
+        memset(GuardBuffer, 0, sizeof(GuardBuffer));
+        memcpy(GuardBuffer, Source, SourceSize);
+        Source = GuardBuffer;
+    }
+    
+    segmented_access At = FixedMemoryPow2(5, Source);
+    instruction Result = Decode(Table, At);
     return Result;
 }
@@ -10,4 +10,92 @@
    
    ======================================================================== */
 
+enum register_mapping_8086
+{
+    Register_none,
+    
+    Register_a,
+    Register_b,
+    Register_c,
+    Register_d,
+    Register_sp,
+    Register_bp,
+    Register_si,
+    Register_di,
+    Register_es,
+    Register_cs,
+    Register_ss,
+    Register_ds,
+    Register_ip,
+    Register_flags,
+    
+    Register_count,
+};
+
+struct encoding_field_piece
+{
+    u8 ByteIndex;
+    u8 BitShift;
+    u8 Mask;
+    u8 DestShift;
+};
+
+struct encoding_shape
+{
+    operation_type Op;
+    u32 ByteCount;
+    u8 LiteralMask[2];
+    u8 LiteralValue[2];
+    
+    b32 Has[Bits_Count];
+    u32 ImplicitBits[Bits_Count];
+    u32 PieceCount[Bits_Count];
+    encoding_field_piece Pieces[Bits_Count][2];
+};
+
+enum modrm_flags : u8
+{
+    ModRM_Register = 0x1, // NOTE: MOD is 11, so RM names a register rather than memory
+    ModRM_DirectAddress = 0x2, // NOTE: MOD 00 RM 110, a 16-bit address with no registers
+};
+
+struct modrm_entry
+{
+    // NOTE: Term0 and Term1 are register_mapping_8086 values (zero when unused).
+    u8 Term0;
+    u8 Term1;
+    u8 DisplacementByteCount;
+    u8 Flags;
+};
+
+struct modrm_table
+{
+    // NOTE: Indexed by the whole ModRM byte. REG does not affect the entry, so callers
+    // that only have MOD and RM can leave those bits zero.
+    modrm_entry Entries[256];
+};
+
+struct instruction_dispatch_slot
+{
+    u8 EncodingCount;
+    u8 EncodingIndex[15];
+};
+
+struct instruction_dispatch
+{
+    // NOTE: One slot per possible first byte, listing only the encodings whose
+    // first-byte literal bits can match that byte.
+    instruction_dispatch_slot Slots[256];
+};
+
+// NOTE: Before the decoder can reject an instruction that runs over the 15 byte limit, it
+// may read that instruction's ModRM, displacement and data bytes, up to 20 bytes in. So
+// every decode reads from a window of this many bytes that does not wrap.
+static u32 const DecodeWindowSize = 32;
+
+typedef instruction decode_instruction(instruction_table Table, segmented_access At);
+
+static instruction_dispatch *Get8086InstructionDispatch(void);
 static instruction DecodeInstruction(instruction_table Table, segmented_access At);
+static instruction DecodeInstructionFromBuffer(instruction_table Table, u64 SourceSize, u8 *Source,
+                                               decode_instruction *Decode = DecodeInstruction);
@@ -0,0 +1,197 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: TryDecode in sim86_decode.cpp walks an instruction_encoding at runtime, checking the
+   Usage of every field as it goes. Since the table never changes, all of that work can be
+   done by the compiler instead. GetEncodingShape (in sim86_decode.cpp) boils each encoding
+   down to the literal bits that must match and where each field's bits live, and
+   TryDecodeSpecialized is instantiated once per encoding with that shape as a compile-time
+   constant, leaving only the byte reads, the literal compares, and the shifts and masks
+   for the fields.
+   
+   The result is passed through the same FinishDecode as the table-driven decoder, so the
+   two produce identical instructions and can be benchmarked against each other. */
+
+static constexpr encoding_shape SpecializedShapes8086[] =
+{
+#define INST(Mnemonic, Encoding, ...) GetEncodingShape(instruction_encoding{Op_##Mnemonic, Encoding, __VA_ARGS__}),
+#include "sim86_instruction_table.inl"
+};
+
+struct specialized_candidates
+{
+    u32 Count;
+    u32 EncodingIndex[15];
+};
+
+static constexpr specialized_candidates GetSpecializedCandidates(u32 Byte)
+{
+    // NOTE: This selects and orders candidates the same way BuildInstructionDispatch does.
+    specialized_candidates Result = {};
+    
+    for(u32 Index = 0; Index < ArrayCount(SpecializedShapes8086); ++Index)
+    {
+        encoding_shape const &Shape = SpecializedShapes8086[Index];
+        if((Byte & Shape.LiteralMask[0]) == Shape.LiteralValue[0])
+        {
+            u32 Insert = Result.Count++;
+            while((Insert > 0) &&
+                  (CountSetBits(SpecializedShapes8086[Result.EncodingIndex[Insert - 1]].LiteralMask[1]) > CountSetBits(Shape.LiteralMask[1])))
+            {
+                Result.EncodingIndex[Insert] = Result.EncodingIndex[Insert - 1];
+                --Insert;
+            }
+            Result.EncodingIndex[Insert] = Index;
+        }
+    }
+    
+    return Result;
+}
+
+static force_inline u32 ExtractField(encoding_shape const &Shape, u32 Usage, u8 *Bytes)
+{
+    u32 Result = Shape.ImplicitBits[Usage];
+    for(u32 PieceIndex = 0; PieceIndex < Shape.PieceCount[Usage]; ++PieceIndex)
+    {
+        encoding_field_piece Piece = Shape.Pieces[Usage][PieceIndex];
+        Result |= (((u32)Bytes[Piece.ByteIndex] >> Piece.BitShift) & Piece.Mask) << Piece.DestShift;
+    }
+    
+    return Result;
+}
+
+template<u32 EncodingIndex>
+static instruction TryDecodeSpecialized(decode_context *Context, u8 *Bytes)
+{
+    static constexpr encoding_shape Shape = SpecializedShapes8086[EncodingIndex];
+    static_assert((Shape.ByteCount >= 1) && (Shape.ByteCount <= 2), "8086 opcode fields never extend past the second byte");
+    
+    instruction Dest = {};
+    
+    if((Bytes[0] & Shape.LiteralMask[0]) != Shape.LiteralValue[0])
+    {
+        return Dest;
+    }
+    
+    if((Shape.ByteCount > 1) && ((Bytes[1] & Shape.LiteralMask[1]) != Shape.LiteralValue[1]))
+    {
+        return Dest;
+    }
+    
+    b32 Has[Bits_Count] = {};
+    u32 Bits[Bits_Count] = {};
+    
+#define EXTRACT_FIELD(Usage) Has[Usage] = Shape.Has[Usage]; Bits[Usage] = ExtractField(Shape, Usage, Bytes)
+    EXTRACT_FIELD(Bits_D);
+    EXTRACT_FIELD(Bits_S);
+    EXTRACT_FIELD(Bits_W);
+    EXTRACT_FIELD(Bits_V);
+    EXTRACT_FIELD(Bits_Z);
+    EXTRACT_FIELD(Bits_MOD);
+    EXTRACT_FIELD(Bits_REG);
+    EXTRACT_FIELD(Bits_RM);
+    EXTRACT_FIELD(Bits_SR);
+    EXTRACT_FIELD(Bits_Disp);
+    EXTRACT_FIELD(Bits_Data);
+    EXTRACT_FIELD(Bits_DispAlwaysW);
+    EXTRACT_FIELD(Bits_WMakesDataW);
+    EXTRACT_FIELD(Bits_RMRegAlwaysW);
+    EXTRACT_FIELD(Bits_RelJMPDisp);
+    EXTRACT_FIELD(Bits_Far);
+#undef EXTRACT_FIELD
+    
+    Dest = FinishDecode(Context, Shape.Op, Has, Bits, Bytes + Shape.ByteCount, Bytes);
+    return Dest;
+}
+
+typedef instruction specialized_decoder(decode_context *Context, u8 *Bytes);
+
+template<u32 Byte, u32 Candidate, b32 Done = (Candidate >= GetSpecializedCandidates(Byte).Count)>
+struct specialized_byte_decoder
+{
+    static instruction Decode(decode_context *Context, u8 *Bytes)
+    {
+        instruction Result = TryDecodeSpecialized<GetSpecializedCandidates(Byte).EncodingIndex[Candidate]>(Context, Bytes);
+        if(!Result.Op)
+        {
+            Result = specialized_byte_decoder<Byte, Candidate + 1>::Decode(Context, Bytes);
+        }
+        
+        return Result;
+    }
+};
+
+template<u32 Byte, u32 Candidate>
+struct specialized_byte_decoder<Byte, Candidate, true>
+{
+    static instruction Decode(decode_context *, u8 *)
+    {
+        instruction Result = {};
+        return Result;
+    }
+};
+
+#define SPECIALIZED_BYTE(Byte) specialized_byte_decoder<(Byte), 0>::Decode
+#define SPECIALIZED_ROW(Row) \
+    SPECIALIZED_BYTE(Row*16 + 0x0), SPECIALIZED_BYTE(Row*16 + 0x1), SPECIALIZED_BYTE(Row*16 + 0x2), SPECIALIZED_BYTE(Row*16 + 0x3), \
+    SPECIALIZED_BYTE(Row*16 + 0x4), SPECIALIZED_BYTE(Row*16 + 0x5), SPECIALIZED_BYTE(Row*16 + 0x6), SPECIALIZED_BYTE(Row*16 + 0x7), \
+    SPECIALIZED_BYTE(Row*16 + 0x8), SPECIALIZED_BYTE(Row*16 + 0x9), SPECIALIZED_BYTE(Row*16 + 0xa), SPECIALIZED_BYTE(Row*16 + 0xb), \
+    SPECIALIZED_BYTE(Row*16 + 0xc), SPECIALIZED_BYTE(Row*16 + 0xd), SPECIALIZED_BYTE(Row*16 + 0xe), SPECIALIZED_BYTE(Row*16 + 0xf)
+
+static specialized_decoder *const SpecializedDecoders8086[256] =
+{
+    SPECIALIZED_ROW(0x0), SPECIALIZED_ROW(0x1), SPECIALIZED_ROW(0x2), SPECIALIZED_ROW(0x3),
+    SPECIALIZED_ROW(0x4), SPECIALIZED_ROW(0x5), SPECIALIZED_ROW(0x6), SPECIALIZED_ROW(0x7),
+    SPECIALIZED_ROW(0x8), SPECIALIZED_ROW(0x9), SPECIALIZED_ROW(0xa), SPECIALIZED_ROW(0xb),
+    SPECIALIZED_ROW(0xc), SPECIALIZED_ROW(0xd), SPECIALIZED_ROW(0xe), SPECIALIZED_ROW(0xf),
+};
+
+#undef SPECIALIZED_ROW
+#undef SPECIALIZED_BYTE
+
+static instruction DecodeInstructionSpecialized(instruction_table Table, segmented_access At)
+{
+    decode_context Context = {};
+    instruction Result = {};
+    
+    u8 Scratch[DecodeWindowSize];
+    u8 *Window = GetLinearWindow(At, DecodeWindowSize, Scratch);
+    
+    u32 StartingAddress = GetAbsoluteAddressOf(At);
+    u32 TotalSize = 0;
+    while(TotalSize < Table.MaxInstructionByteCount)
+    {
+        u8 *Bytes = Window + TotalSize;
+        Result = SpecializedDecoders8086[*Bytes](&Context, Bytes);
+        if(Result.Op)
+        {
+            TotalSize += Result.Size;
+        }
+        
+        if(!ApplyPrefix(&Context, Result))
+        {
+            break;
+        }
+    }
+    
+    if(TotalSize <= Table.MaxInstructionByteCount)
+    {
+        Result.Address = StartingAddress;
+        Result.Size = TotalSize;
+    }
+    else
+    {
+        Result = {};
+    }
+    
+    return Result;
+}
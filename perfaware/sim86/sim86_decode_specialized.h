@@ -0,0 +1,16 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+// NOTE: This decoder is generated at compile time from sim86_instruction_table.inl, so
+// it always decodes the built-in 8086 table. It takes an instruction_table only so that it
+// can be used interchangeably with DecodeInstruction.
+static instruction DecodeInstructionSpecialized(instruction_table Table, segmented_access At);
@@ -0,0 +1,319 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+static disasm_stop GetDisAsmStop(instruction Instruction, u64 Remaining)
+{
+    disasm_stop Result = DisAsmStop_None;
+    if(!Instruction.Op)
+    {
+        Result = DisAsmStop_Unrecognized;
+    }
+    else if(Instruction.Size > Remaining)
+    {
+        Result = DisAsmStop_ExtendsOutside;
+    }
+    
+    return Result;
+}
+
+static void ReportDisAsmStop(text_buffer *Output, disasm_stop Stop)
+{
+    // NOTE: Anything already disassembled goes out first, so that the error lands after
+    // the last instruction that was printed.
+    if(Stop)
+    {
+        FlushTextBuffer(Output);
+    }
+    
+    switch(Stop)
+    {
+        case DisAsmStop_None: {} break;
+        
+        case DisAsmStop_Unrecognized:
+        {
+            fprintf(stderr, "ERROR: Unrecognized binary in instruction stream.\n");
+        } break;
+        
+        case DisAsmStop_ExtendsOutside:
+        {
+            fprintf(stderr, "ERROR: Instruction extends outside disassembly region\n");
+        } break;
+        
+        case DisAsmStop_TooLarge:
+        {
+            fprintf(stderr, "ERROR: Files of 4GB or more cannot be disassembled\n");
+        } break;
+    }
+}
+
+static u32 GetMaxOutputPerByte(output_format Format)
+{
+    // NOTE: The most output any one byte of machine code can produce, which is always from a
+    // one byte instruction (such as "xchg ax, cx"), for sizing buffers that have to hold a
+    // whole region's output.
+    u32 Result = 16;
+    if(Format == OutputFormat_JSONLines)
+    {
+        Result = 160;
+    }
+    
+    return Result;
+}
+
+static void AppendDisAsmFileBegin(text_buffer *Output, output_format Format, char const *FileName)
+{
+    switch(Format)
+    {
+        case OutputFormat_Text:
+        {
+            AppendFileHeader(Output, FileName);
+        } break;
+        
+        case OutputFormat_Binary:
+        {
+            u32 FileNameLength = (u32)strlen(FileName);
+            
+            disasm_file_record Record = {};
+            Record.Value = FileNameLength;
+            Record.Kind = DisAsmRecord_FileBegin;
+            AppendText(Output, sizeof(Record), (char *)&Record);
+            
+            char const Padding[16] = {};
+            AppendText(Output, FileNameLength, FileName);
+            AppendText(Output, (0 - FileNameLength) & 15, Padding);
+        } break;
+        
+        case OutputFormat_JSONLines:
+        {
+            AppendText(Output, TEXT_SPAN("{\"file\":"));
+            AppendJSONString(Output, FileName);
+            AppendText(Output, TEXT_SPAN("}\n"));
+        } break;
+    }
+}
+
+static void AppendDisAsmInstruction(text_buffer *Output, output_format Format, instruction Instruction)
+{
+    switch(Format)
+    {
+        case OutputFormat_Text:
+        {
+            FormatInstruction(Output, Instruction);
+            AppendChar(Output, '\n');
+        } break;
+        
+        case OutputFormat_Binary:
+        {
+            // NOTE: Everything the decoder produces fits in a packed_instruction, so this
+            // never fails for an instruction that came out of it.
+            packed_instruction Record = {};
+            CompressInstruction(Instruction, &Record);
+            AppendText(Output, sizeof(Record), (char *)&Record);
+        } break;
+        
+        case OutputFormat_JSONLines:
+        {
+            FormatInstructionJSON(Output, Instruction);
+            AppendChar(Output, '\n');
+        } break;
+    }
+}
+
+static void AppendDisAsmFileEnd(text_buffer *Output, output_format Format, char const *FileName, disasm_stop Stop)
+{
+    switch(Format)
+    {
+        case OutputFormat_Text: {} break;
+        
+        case OutputFormat_Binary:
+        {
+            disasm_file_record Record = {};
+            Record.Value = Stop;
+            Record.Kind = DisAsmRecord_FileEnd;
+            AppendText(Output, sizeof(Record), (char *)&Record);
+        } break;
+        
+        case OutputFormat_JSONLines:
+        {
+            char const *StopNames[] = {"none", "unrecognized", "extends outside", "too large"};
+            AppendText(Output, TEXT_SPAN("{\"file\":"));
+            AppendJSONString(Output, FileName);
+            AppendText(Output, TEXT_SPAN(",\"stop\":"));
+            AppendJSONString(Output, StopNames[Stop]);
+            AppendText(Output, TEXT_SPAN("}\n"));
+        } break;
+    }
+}
+
+static disasm_stop DisAsm8086(u32 DisAsmByteCount, segmented_access DisAsmStart, decode_instruction *Decode,
+                              text_buffer *Output, output_format Format)
+{
+    disasm_stop Result = DisAsmStop_None;
+    
+    segmented_access At = DisAsmStart;
+    
+    instruction_table Table = Get8086InstructionTable();
+    
+    u32 Count = DisAsmByteCount;
+    while(Count)
+    {
+        instruction Instruction = Decode(Table, At);
+        Result = GetDisAsmStop(Instruction, Count);
+        if(Result)
+        {
+            break;
+        }
+        
+        At = MoveBaseBy(At, Instruction.Size);
+        Count -= Instruction.Size;
+        
+        AppendDisAsmInstruction(Output, Format, Instruction);
+    }
+    
+    return Result;
+}
+
+static disasm_stop DisAsm8086Counted(u32 DisAsmByteCount, segmented_access DisAsmStart, decode_instruction *Decode,
+                                     text_buffer *Output, output_format Format,
+                                     perf_counters *Counters, disasm_phase_counters *Phases)
+{
+    // NOTE: Same output as DisAsm8086, but instructions are decoded a block at a time and
+    // then printed, so that the counters can be read between the two phases without
+    // the cost of reading them swamping the work being counted.
+    disasm_stop Result = DisAsmStop_None;
+    
+    segmented_access At = DisAsmStart;
+    
+    instruction_table Table = Get8086InstructionTable();
+    
+    static instruction Block[4096];
+    
+    u32 Count = DisAsmByteCount;
+    while(Count && !Result)
+    {
+        perf_counter_values BeforeDecode = ReadPerfCounters(Counters);
+        u32 BlockCount = 0;
+        while(Count && (BlockCount < ArrayCount(Block)))
+        {
+            instruction Instruction = Decode(Table, At);
+            Result = GetDisAsmStop(Instruction, Count);
+            if(Result)
+            {
+                break;
+            }
+            
+            At = MoveBaseBy(At, Instruction.Size);
+            Count -= Instruction.Size;
+            Block[BlockCount++] = Instruction;
+        }
+        
+        perf_counter_values BeforePrint = ReadPerfCounters(Counters);
+        for(u32 BlockIndex = 0; BlockIndex < BlockCount; ++BlockIndex)
+        {
+            AppendDisAsmInstruction(Output, Format, Block[BlockIndex]);
+        }
+        perf_counter_values AfterPrint = ReadPerfCounters(Counters);
+        
+        Phases->InstructionCount += BlockCount;
+        Phases->Decode = Phases->Decode + (BeforePrint - BeforeDecode);
+        Phases->Print = Phases->Print + (AfterPrint - BeforePrint);
+    }
+    
+    return Result;
+}
+
+static disasm_stop DisAsm8086Linear(u64 DisAsmByteCount, u8 *DisAsmStart, decode_instruction *Decode,
+                                    text_buffer *Output, output_format Format)
+{
+    // NOTE: Unlike DisAsm8086, this decodes straight out of a flat buffer (such as a mapped
+    // file) with no 1MB limit. Only an instruction within 32 bytes of the end is copied.
+    disasm_stop Result = DisAsmStop_None;
+    
+    instruction_table Table = Get8086InstructionTable();
+    
+    u64 Offset = 0;
+    while(Offset < DisAsmByteCount)
+    {
+        u64 Remaining = DisAsmByteCount - Offset;
+        instruction Instruction = DecodeInstructionFromBuffer(Table, Remaining, DisAsmStart + Offset, Decode);
+        Result = GetDisAsmStop(Instruction, Remaining);
+        if(Result)
+        {
+            break;
+        }
+        
+        // NOTE: The decode was from a window at Offset, so its Address is relative to that.
+        Instruction.Address = (u32)Offset;
+        Offset += Instruction.Size;
+        
+        AppendDisAsmInstruction(Output, Format, Instruction);
+    }
+    
+    return Result;
+}
+
+static disasm_stop DisAsm8086Stream(decode_instruction *Decode, text_buffer *Output, output_format Format)
+{
+    // NOTE: Disassembles standard input as it arrives, using a fixed buffer. Instructions are
+    // only decoded while at least a full decode window (see DecodeInstructionFromBuffer) is
+    // buffered, so one that straddles two reads is never decoded from a partial window.
+    // The unused tail is carried over to the front of the buffer for the next read, and
+    // everything decoded is written out after each read, so output keeps up with input.
+    disasm_stop Result = DisAsmStop_None;
+    
+    instruction_table Table = Get8086InstructionTable();
+    
+    static u8 Buffer[64*1024];
+    u32 BufferUsed = 0;
+    u64 BufferStart = 0; // NOTE: Offset in the stream of the first byte in Buffer
+    
+    b32 AtEnd = false;
+    while(!AtEnd && !Result)
+    {
+        u32 ReadCount = ReadStandardInput(sizeof(Buffer) - BufferUsed, Buffer + BufferUsed);
+        BufferUsed += ReadCount;
+        AtEnd = (ReadCount == 0);
+        
+        // NOTE: At the end of the input there is nothing left to wait for, so the last few
+        // instructions are decoded from a partial window like at the end of a file.
+        u32 Offset = 0;
+        while(Offset < BufferUsed)
+        {
+            u32 Remaining = BufferUsed - Offset;
+            if(!AtEnd && (Remaining < DecodeWindowSize))
+            {
+                break;
+            }
+            
+            instruction Instruction = DecodeInstructionFromBuffer(Table, Remaining, Buffer + Offset, Decode);
+            Result = GetDisAsmStop(Instruction, Remaining);
+            if(Result)
+            {
+                break;
+            }
+            
+            Instruction.Address = (u32)(BufferStart + Offset);
+            Offset += Instruction.Size;
+            
+            AppendDisAsmInstruction(Output, Format, Instruction);
+        }
+        
+        BufferStart += Offset;
+        BufferUsed -= Offset;
+        memmove(Buffer, Buffer + Offset, BufferUsed);
+        
+        FlushTextBuffer(Output);
+        fflush(stdout);
+    }
+    
+    return Result;
+}
@@ -0,0 +1,71 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+enum disasm_stop
+{
+    DisAsmStop_None,
+    DisAsmStop_Unrecognized,
+    DisAsmStop_ExtendsOutside,
+    DisAsmStop_TooLarge,
+};
+
+enum output_format : u32
+{
+    OutputFormat_Text, // NOTE: NASM syntax, which reassembles to the same machine code
+    OutputFormat_Binary,
+    OutputFormat_JSONLines, // NOTE: See FormatInstructionJSON
+};
+
+/* NOTE: --format=bin writes a stream of 16-byte records. Each instruction is one
+   packed_instruction, with Address set to its offset in the file. Each file is bracketed by
+   two disasm_file_records, which can be told apart from instructions by their Op of 0
+   (Op_None, which no instruction has). A FileBegin record is followed by the file name,
+   zero-padded to a multiple of 16 bytes so that records stay aligned. */
+
+enum disasm_record_kind : u8
+{
+    DisAsmRecord_FileBegin = 1,
+    DisAsmRecord_FileEnd = 2,
+};
+
+struct disasm_file_record
+{
+    u32 Value; // NOTE: FileBegin: length of the file name, FileEnd: the disasm_stop for the file
+    u8 Op; // NOTE: Always Op_None
+    u8 Kind;
+    u8 Reserved[10];
+};
+static_assert(sizeof(disasm_file_record) == sizeof(packed_instruction), "disasm_file_record must be the same size as packed_instruction");
+
+struct disasm_phase_counters
+{
+    u64 InstructionCount;
+    perf_counter_values Decode;
+    perf_counter_values Print;
+};
+
+static disasm_stop GetDisAsmStop(instruction Instruction, u64 Remaining);
+static void ReportDisAsmStop(text_buffer *Output, disasm_stop Stop);
+
+static u32 GetMaxOutputPerByte(output_format Format);
+static void AppendDisAsmFileBegin(text_buffer *Output, output_format Format, char const *FileName);
+static void AppendDisAsmInstruction(text_buffer *Output, output_format Format, instruction Instruction);
+static void AppendDisAsmFileEnd(text_buffer *Output, output_format Format, char const *FileName, disasm_stop Stop);
+
+static disasm_stop DisAsm8086(u32 DisAsmByteCount, segmented_access DisAsmStart, decode_instruction *Decode,
+                              text_buffer *Output, output_format Format);
+static disasm_stop DisAsm8086Counted(u32 DisAsmByteCount, segmented_access DisAsmStart, decode_instruction *Decode,
+                                     text_buffer *Output, output_format Format,
+                                     perf_counters *Counters, disasm_phase_counters *Phases);
+static disasm_stop DisAsm8086Linear(u64 DisAsmByteCount, u8 *DisAsmStart, decode_instruction *Decode,
+                                    text_buffer *Output, output_format Format);
+static disasm_stop DisAsm8086Stream(decode_instruction *Decode, text_buffer *Output, output_format Format);
@@ -0,0 +1,1326 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Executes 8086 machine code by decoding the instruction at cs:ip and applying it to
+   the register file and memory, one instruction at a time. Registers are addressed
+   directly by the register_access the decoder produced, operands are read and written
+   through the same few functions no matter what kind they are, and the instruction itself
+   is dispatched with one switch on its operation_type, which the compiler turns into a
+   jump table. Nothing is allocated while running.
+   
+   Flags are computed as each instruction executes, exactly as the 8086 defines them.
+   Where the 8086 leaves a flag undefined (AF after a logical operation, for example),
+   it is cleared.
+   
+   There is no BIOS or DOS underneath the program, so an interrupt (including a divide
+   error) only goes through the interrupt vector table if the program has put something
+   there, and otherwise stops execution. There are no I/O devices either, so in reads all
+   ones and out is ignored. */
+
+static u16 const DefinedFlags8086 = (Flag_Carry|Flag_Parity|Flag_AuxCarry|Flag_Zero|Flag_Sign|
+                                     Flag_Trap|Flag_Interrupt|Flag_Direction|Flag_Overflow);
+static u16 const ArithmeticFlags8086 = (Flag_Carry|Flag_Parity|Flag_AuxCarry|Flag_Zero|Flag_Sign|Flag_Overflow);
+
+static cpu_8086 CPU8086(segmented_access Memory, u32 ProgramEnd)
+{
+    cpu_8086 Result = {};
+    
+    Result.Memory = Memory;
+    Result.ProgramEnd = ProgramEnd;
+    
+    return Result;
+}
+
+static u32 ReadRegister(cpu_8086 *CPU, register_access Reg)
+{
+    u32 Result = CPU->Registers[Reg.Index];
+    if(Reg.Count != 2)
+    {
+        Result = ((u8 *)&CPU->Registers[Reg.Index])[Reg.Offset];
+    }
+    
+    return Result;
+}
+
+static void WriteRegister(cpu_8086 *CPU, register_access Reg, u32 Value)
+{
+    if(Reg.Count == 2)
+    {
+        CPU->Registers[Reg.Index] = (u16)Value;
+    }
+    else
+    {
+        ((u8 *)&CPU->Registers[Reg.Index])[Reg.Offset] = (u8)Value;
+    }
+}
+
+static u8 *GetMemoryByte(cpu_8086 *CPU, u16 Segment, u16 Offset)
+{
+    u8 *Result = CPU->Memory.Memory + GetAbsoluteAddressOf(CPU->Memory.Mask, Segment, Offset, 0);
+    return Result;
+}
+
+static u32 ReadMemory(cpu_8086 *CPU, u16 Segment, u16 Offset, b32 Wide)
+{
+    // NOTE: The high byte of a word at offset ffff comes from offset 0 of the same segment.
+    u32 Result = *GetMemoryByte(CPU, Segment, Offset);
+    if(Wide)
+    {
+        Result |= (u32)*GetMemoryByte(CPU, Segment, (u16)(Offset + 1)) << 8;
+    }
+    
+    return Result;
+}
+
+static void WriteMemoryByte(cpu_8086 *CPU, u16 Segment, u16 Offset, u8 Value)
+{
+    u32 Address = GetAbsoluteAddressOf(CPU->Memory.Mask, Segment, Offset, 0);
+    CPU->Memory.Memory[Address] = Value;
+    if(CPU->Cache)
+    {
+        InvalidateCode(CPU->Cache, Address);
+    }
+}
+
+static void WriteMemory(cpu_8086 *CPU, u16 Segment, u16 Offset, b32 Wide, u32 Value)
+{
+    WriteMemoryByte(CPU, Segment, Offset, (u8)Value);
+    if(Wide)
+    {
+        WriteMemoryByte(CPU, Segment, (u16)(Offset + 1), (u8)(Value >> 8));
+    }
+}
+
+static u16 GetEffectiveAddress(cpu_8086 *CPU, effective_address_expression Address)
+{
+    // NOTE: Unused terms are Register_none, whose slot in the register file is always zero.
+    u32 Result = (CPU->Registers[Address.Terms[0].Register.Index] +
+                  CPU->Registers[Address.Terms[1].Register.Index] +
+                  (u32)Address.Displacement);
+    return (u16)Result;
+}
+
+static u16 GetDataSegment(cpu_8086 *CPU, instruction *Instruction, effective_address_expression Address)
+{
+    u32 Segment = Register_ds;
+    if(Instruction->Flags & Inst_Segment)
+    {
+        Segment = Instruction->SegmentOverride;
+    }
+    else if((Address.Terms[0].Register.Index == Register_bp) || (Address.Terms[1].Register.Index == Register_bp))
+    {
+        Segment = Register_ss;
+    }
+    
+    return CPU->Registers[Segment];
+}
+
+static u32 GetWidthMask(b32 Wide)
+{
+    u32 Result = Wide ? 0xffff : 0xff;
+    return Result;
+}
+
+static u32 GetSignBit(b32 Wide)
+{
+    u32 Result = Wide ? 0x8000 : 0x80;
+    return Result;
+}
+
+static u32 ReadOperand(cpu_8086 *CPU, instruction *Instruction, instruction_operand Operand, b32 Wide)
+{
+    u32 Result = 0;
+    switch(Operand.Type)
+    {
+        case Operand_None: {} break;
+        
+        case Operand_Register:
+        {
+            Result = ReadRegister(CPU, Operand.Register);
+        } break;
+        
+        case Operand_Memory:
+        {
+            u16 Segment = GetDataSegment(CPU, Instruction, Operand.Address);
+            Result = ReadMemory(CPU, Segment, GetEffectiveAddress(CPU, Operand.Address), Wide);
+        } break;
+        
+        case Operand_Immediate:
+        {
+            Result = Operand.Immediate.Value & GetWidthMask(Wide);
+        } break;
+    }
+    
+    return Result;
+}
+
+static void WriteOperand(cpu_8086 *CPU, instruction *Instruction, instruction_operand Operand, b32 Wide, u32 Value)
+{
+    switch(Operand.Type)
+    {
+        case Operand_Register:
+        {
+            WriteRegister(CPU, Operand.Register, Value);
+        } break;
+        
+        case Operand_Memory:
+        {
+            u16 Segment = GetDataSegment(CPU, Instruction, Operand.Address);
+            WriteMemory(CPU, Segment, GetEffectiveAddress(CPU, Operand.Address), Wide, Value);
+        } break;
+        
+        default: {} break;
+    }
+}
+
+static void Push(cpu_8086 *CPU, u32 Value)
+{
+    CPU->Registers[Register_sp] -= 2;
+    WriteMemory(CPU, CPU->Registers[Register_ss], CPU->Registers[Register_sp], true, Value);
+}
+
+static u16 Pop(cpu_8086 *CPU)
+{
+    u16 Result = (u16)ReadMemory(CPU, CPU->Registers[Register_ss], CPU->Registers[Register_sp], true);
+    CPU->Registers[Register_sp] += 2;
+    return Result;
+}
+
+static u16 GetResultFlags(b32 Wide, u32 Result)
+{
+    // NOTE: Parity only ever looks at the low byte, and is set when it has an even number
+    // of one bits. 0x6996 is the parity of every 4-bit value, one bit each.
+    u32 Low = Result & 0xff;
+    Low ^= (Low >> 4);
+    
+    u16 Flags = 0;
+    if(!(Result & GetWidthMask(Wide)))
+    {
+        Flags |= Flag_Zero;
+    }
+    if(Result & GetSignBit(Wide))
+    {
+        Flags |= Flag_Sign;
+    }
+    if(!((0x6996 >> (Low & 0xf)) & 1))
+    {
+        Flags |= Flag_Parity;
+    }
+    
+    return Flags;
+}
+
+static u16 GetAddFlags(b32 Wide, u32 A, u32 B, u32 CarryIn)
+{
+    u32 Full = A + B + CarryIn;
+    u32 Result = Full & GetWidthMask(Wide);
+    
+    u16 Flags = GetResultFlags(Wide, Result);
+    if(Full > GetWidthMask(Wide))
+    {
+        Flags |= Flag_Carry;
+    }
+    if((A ^ B ^ Full) & 0x10)
+    {
+        Flags |= Flag_AuxCarry;
+    }
+    if(~(A ^ B) & (A ^ Result) & GetSignBit(Wide))
+    {
+        Flags |= Flag_Overflow;
+    }
+    
+    return Flags;
+}
+
+static u16 GetSubtractFlags(b32 Wide, u32 A, u32 B, u32 BorrowIn)
+{
+    u32 Full = A - B - BorrowIn;
+    u32 Result = Full & GetWidthMask(Wide);
+    
+    u16 Flags = GetResultFlags(Wide, Result);
+    if((B + BorrowIn) > A)
+    {
+        Flags |= Flag_Carry;
+    }
+    if((A ^ B ^ Full) & 0x10)
+    {
+        Flags |= Flag_AuxCarry;
+    }
+    if((A ^ B) & (A ^ Result) & GetSignBit(Wide))
+    {
+        Flags |= Flag_Overflow;
+    }
+    
+    return Flags;
+}
+
+static void MaterializeFlags(cpu_8086 *CPU)
+{
+    lazy_flags *Lazy = &CPU->LazyFlags;
+    if(Lazy->Op)
+    {
+        u16 Flags = 0;
+        switch(Lazy->Op)
+        {
+            case LazyFlags_None: {} break;
+            case LazyFlags_Add: {Flags = GetAddFlags(Lazy->Wide, Lazy->A, Lazy->B, Lazy->CarryIn);} break;
+            case LazyFlags_Subtract: {Flags = GetSubtractFlags(Lazy->Wide, Lazy->A, Lazy->B, Lazy->CarryIn);} break;
+            case LazyFlags_Logic: {Flags = GetResultFlags(Lazy->Wide, Lazy->Result);} break;
+            
+            case LazyFlags_Increment:
+            case LazyFlags_Decrement:
+            {
+                Flags = (Lazy->Op == LazyFlags_Increment) ? GetAddFlags(Lazy->Wide, Lazy->A, 1, 0) : GetSubtractFlags(Lazy->Wide, Lazy->A, 1, 0);
+                Flags = (u16)((Flags & ~Flag_Carry) | (Lazy->CarryIn ? Flag_Carry : 0));
+            } break;
+        }
+        
+        CPU->Registers[Register_flags] = (u16)((CPU->Registers[Register_flags] & ~ArithmeticFlags8086) | Flags);
+        Lazy->Op = LazyFlags_None;
+    }
+}
+
+static void SetArithmeticFlags(cpu_8086 *CPU, u16 Flags)
+{
+    CPU->LazyFlags.Op = LazyFlags_None;
+    CPU->Registers[Register_flags] = (u16)((CPU->Registers[Register_flags] & ~ArithmeticFlags8086) | Flags);
+}
+
+static b32 IsSet(cpu_8086 *CPU, u16 Flag)
+{
+    MaterializeFlags(CPU);
+    b32 Result = ((CPU->Registers[Register_flags] & Flag) != 0);
+    return Result;
+}
+
+static u32 GetCarry(cpu_8086 *CPU)
+{
+    // NOTE: CF on its own is cheap to work out from a pending operation, which saves adc,
+    // sbb, inc and dec from having to bring all the flags up to date.
+    lazy_flags *Lazy = &CPU->LazyFlags;
+    u32 Result = 0;
+    switch(Lazy->Op)
+    {
+        case LazyFlags_None: {Result = (CPU->Registers[Register_flags] & Flag_Carry);} break;
+        case LazyFlags_Add: {Result = ((Lazy->A + Lazy->B + Lazy->CarryIn) > GetWidthMask(Lazy->Wide));} break;
+        case LazyFlags_Subtract: {Result = ((Lazy->B + Lazy->CarryIn) > Lazy->A);} break;
+        case LazyFlags_Logic: {Result = 0;} break;
+        case LazyFlags_Increment:
+        case LazyFlags_Decrement: {Result = Lazy->CarryIn;} break;
+    }
+    
+    return Result;
+}
+
+static void SetLazyFlags(cpu_8086 *CPU, lazy_flags_op Op, b32 Wide, u32 A, u32 B, u32 CarryIn, u32 Result)
+{
+    lazy_flags *Lazy = &CPU->LazyFlags;
+    Lazy->Op = Op;
+    Lazy->Wide = Wide;
+    Lazy->A = A;
+    Lazy->B = B;
+    Lazy->CarryIn = CarryIn;
+    Lazy->Result = Result;
+}
+
+static u32 Add(cpu_8086 *CPU, b32 Wide, u32 A, u32 B, u32 CarryIn)
+{
+    u32 Result = (A + B + CarryIn) & GetWidthMask(Wide);
+    if(CPU->EagerFlags)
+    {
+        SetArithmeticFlags(CPU, GetAddFlags(Wide, A, B, CarryIn));
+    }
+    else
+    {
+        SetLazyFlags(CPU, LazyFlags_Add, Wide, A, B, CarryIn, Result);
+    }
+    
+    return Result;
+}
+
+static u32 Subtract(cpu_8086 *CPU, b32 Wide, u32 A, u32 B, u32 BorrowIn)
+{
+    u32 Result = (A - B - BorrowIn) & GetWidthMask(Wide);
+    if(CPU->EagerFlags)
+    {
+        SetArithmeticFlags(CPU, GetSubtractFlags(Wide, A, B, BorrowIn));
+    }
+    else
+    {
+        SetLazyFlags(CPU, LazyFlags_Subtract, Wide, A, B, BorrowIn, Result);
+    }
+    
+    return Result;
+}
+
+static u32 Logic(cpu_8086 *CPU, b32 Wide, u32 Result)
+{
+    if(CPU->EagerFlags)
+    {
+        SetArithmeticFlags(CPU, GetResultFlags(Wide, Result));
+    }
+    else
+    {
+        SetLazyFlags(CPU, LazyFlags_Logic, Wide, 0, 0, 0, Result);
+    }
+    
+    return Result;
+}
+
+static u32 IncrementOrDecrement(cpu_8086 *CPU, b32 Increment, b32 Wide, u32 A)
+{
+    // NOTE: inc and dec set the flags as adding or subtracting 1 would, except that they
+    // leave CF alone.
+    u32 Carry = GetCarry(CPU);
+    u32 Result = (Increment ? (A + 1) : (A - 1)) & GetWidthMask(Wide);
+    if(CPU->EagerFlags)
+    {
+        u16 Flags = Increment ? GetAddFlags(Wide, A, 1, 0) : GetSubtractFlags(Wide, A, 1, 0);
+        SetArithmeticFlags(CPU, (u16)((Flags & ~Flag_Carry) | (Carry ? Flag_Carry : 0)));
+    }
+    else
+    {
+        SetLazyFlags(CPU, Increment ? LazyFlags_Increment : LazyFlags_Decrement, Wide, A, 1, Carry, Result);
+    }
+    
+    return Result;
+}
+
+static b32 UsesLazyFlags(operation_type Op)
+{
+    // NOTE: The operations that either leave the arithmetic flags alone or keep them lazy.
+    // Anything else brings the flags up to date before it runs.
+    b32 Result = false;
+    switch(Op)
+    {
+        case Op_mov: case Op_add: case Op_adc: case Op_sub: case Op_sbb: case Op_cmp:
+        case Op_and: case Op_or: case Op_xor: case Op_test: case Op_inc: case Op_dec: case Op_neg: case Op_not:
+        case Op_lea: case Op_lds: case Op_les: case Op_xchg: case Op_xlat: case Op_cbw: case Op_cwd:
+        case Op_push: case Op_pop: case Op_jmp: case Op_call: case Op_ret: case Op_retf:
+        case Op_loop: case Op_jcxz: case Op_in: case Op_out:
+        case Op_cld: case Op_std: case Op_cli: case Op_sti:
+        {
+            Result = true;
+        } break;
+        
+        default: {} break;
+    }
+    
+    return Result;
+}
+
+static u32 Shift(cpu_8086 *CPU, operation_type Op, b32 Wide, u32 Value, u32 Count)
+{
+    // NOTE: The 8086 does not mask the count, so it shifts as many times as it is asked to.
+    // Rotates only touch CF and OF. OF is only defined for a count of one, and is taken from
+    // the last step here.
+    if(Count)
+    {
+        u32 Mask = GetWidthMask(Wide);
+        u32 SignBit = GetSignBit(Wide);
+        
+        b32 Carry = IsSet(CPU, Flag_Carry);
+        b32 Overflow = false;
+        for(u32 Step = 0; Step < Count; ++Step)
+        {
+            u32 Before = Value;
+            switch(Op)
+            {
+                case Op_shl: {Carry = (Value & SignBit) != 0; Value = (Value << 1) & Mask;} break;
+                case Op_shr: {Carry = (Value & 1); Value >>= 1;} break;
+                case Op_sar: {Carry = (Value & 1); Value = (Value >> 1) | (Value & SignBit);} break;
+                case Op_rol: {Carry = (Value & SignBit) != 0; Value = ((Value << 1) | Carry) & Mask;} break;
+                case Op_ror: {Carry = (Value & 1); Value = (Value >> 1) | (Carry ? SignBit : 0);} break;
+                case Op_rcl: {b32 Out = (Value & SignBit) != 0; Value = ((Value << 1) | Carry) & Mask; Carry = Out;} break;
+                case Op_rcr: {b32 Out = (Value & 1); Value = (Value >> 1) | (Carry ? SignBit : 0); Carry = Out;} break;
+                default: {} break;
+            }
+            
+            switch(Op)
+            {
+                case Op_shl: case Op_rol: case Op_rcl: {Overflow = ((Value & SignBit) != 0) != Carry;} break;
+                case Op_shr: {Overflow = (Before & SignBit) != 0;} break;
+                case Op_ror: case Op_rcr: {Overflow = ((Value ^ (Value << 1)) & SignBit) != 0;} break;
+                default: {Overflow = false;} break;
+            }
+        }
+        
+        u16 Flags = CPU->Registers[Register_flags] & ~(Flag_Carry|Flag_Overflow);
+        if((Op == Op_shl) || (Op == Op_shr) || (Op == Op_sar))
+        {
+            Flags = GetResultFlags(Wide, Value);
+        }
+        if(Carry)
+        {
+            Flags |= Flag_Carry;
+        }
+        if(Overflow)
+        {
+            Flags |= Flag_Overflow;
+        }
+        SetArithmeticFlags(CPU, Flags & ArithmeticFlags8086);
+    }
+    
+    return Value;
+}
+
+static execute_stop Interrupt(cpu_8086 *CPU, u32 Vector)
+{
+    execute_stop Result = ExecuteStop_None;
+    
+    u16 Offset = (u16)ReadMemory(CPU, 0, (u16)(4*Vector), true);
+    u16 Segment = (u16)ReadMemory(CPU, 0, (u16)(4*Vector + 2), true);
+    if(Offset || Segment)
+    {
+        Push(CPU, CPU->Registers[Register_flags]);
+        CPU->Registers[Register_flags] &= ~(Flag_Trap|Flag_Interrupt);
+        Push(CPU, CPU->Registers[Register_cs]);
+        Push(CPU, CPU->Registers[Register_ip]);
+        CPU->Registers[Register_cs] = Segment;
+        CPU->Registers[Register_ip] = Offset;
+    }
+    else
+    {
+        CPU->StopInterrupt = Vector;
+        Result = ExecuteStop_Interrupt;
+    }
+    
+    return Result;
+}
+
+static execute_stop Multiply(cpu_8086 *CPU, instruction *Instruction, b32 Wide)
+{
+    u32 Source = ReadOperand(CPU, Instruction, Instruction->Operands[0], Wide);
+    u16 *AX = &CPU->Registers[Register_a];
+    u16 *DX = &CPU->Registers[Register_d];
+    
+    b32 Overflow = false;
+    if(Instruction->Op == Op_mul)
+    {
+        if(Wide)
+        {
+            u32 Product = (u32)*AX * Source;
+            *AX = (u16)Product;
+            *DX = (u16)(Product >> 16);
+            Overflow = (*DX != 0);
+        }
+        else
+        {
+            *AX = (u16)((*AX & 0xff) * Source);
+            Overflow = ((*AX >> 8) != 0);
+        }
+    }
+    else
+    {
+        if(Wide)
+        {
+            s32 Product = (s32)(s16)*AX * (s32)(s16)Source;
+            *AX = (u16)Product;
+            *DX = (u16)((u32)Product >> 16);
+            Overflow = (Product != (s32)(s16)Product);
+        }
+        else
+        {
+            s32 Product = (s32)(s8)*AX * (s32)(s8)Source;
+            *AX = (u16)Product;
+            Overflow = (Product != (s32)(s8)Product);
+        }
+    }
+    
+    u16 Flags = CPU->Registers[Register_flags] & ArithmeticFlags8086 & ~(Flag_Carry|Flag_Overflow);
+    if(Overflow)
+    {
+        Flags |= (Flag_Carry|Flag_Overflow);
+    }
+    SetArithmeticFlags(CPU, Flags);
+    
+    return ExecuteStop_None;
+}
+
+static execute_stop Divide(cpu_8086 *CPU, instruction *Instruction, b32 Wide)
+{
+    // NOTE: A zero divisor, or a quotient that does not fit (which on the 8086 includes the
+    // most negative value for idiv), is a divide error, which is interrupt 0.
+    u32 Divisor = ReadOperand(CPU, Instruction, Instruction->Operands[0], Wide);
+    u16 *AX = &CPU->Registers[Register_a];
+    u16 *DX = &CPU->Registers[Register_d];
+    
+    b32 Valid = (Divisor != 0);
+    if(Valid)
+    {
+        if(Instruction->Op == Op_div)
+        {
+            if(Wide)
+            {
+                u32 Dividend = ((u32)*DX << 16) | *AX;
+                u32 Quotient = Dividend / Divisor;
+                Valid = (Quotient <= 0xffff);
+                if(Valid)
+                {
+                    *AX = (u16)Quotient;
+                    *DX = (u16)(Dividend % Divisor);
+                }
+            }
+            else
+            {
+                u32 Quotient = *AX / Divisor;
+                Valid = (Quotient <= 0xff);
+                if(Valid)
+                {
+                    *AX = (u16)(((*AX % Divisor) << 8) | Quotient);
+                }
+            }
+        }
+        else
+        {
+            if(Wide)
+            {
+                s32 Dividend = (s32)(((u32)*DX << 16) | *AX);
+                s32 SignedDivisor = (s16)Divisor;
+                s64 Quotient = (s64)Dividend / SignedDivisor;
+                Valid = ((Quotient >= -0x7fff) && (Quotient <= 0x7fff));
+                if(Valid)
+                {
+                    *AX = (u16)Quotient;
+                    *DX = (u16)((s64)Dividend % SignedDivisor);
+                }
+            }
+            else
+            {
+                s32 Dividend = (s16)*AX;
+                s32 SignedDivisor = (s8)Divisor;
+                s32 Quotient = Dividend / SignedDivisor;
+                Valid = ((Quotient >= -0x7f) && (Quotient <= 0x7f));
+                if(Valid)
+                {
+                    *AX = (u16)((((u32)(Dividend % SignedDivisor) & 0xff) << 8) | ((u32)Quotient & 0xff));
+                }
+            }
+        }
+    }
+    
+    execute_stop Result = ExecuteStop_None;
+    if(!Valid)
+    {
+        Result = Interrupt(CPU, 0);
+    }
+    
+    return Result;
+}
+
+static void ExecuteString(cpu_8086 *CPU, instruction *Instruction, b32 Wide)
+{
+    // NOTE: The source can take a segment override, but the destination is always es:di.
+    u16 SourceSegment = CPU->Registers[(Instruction->Flags & Inst_Segment) ? Instruction->SegmentOverride : (u32)Register_ds];
+    u16 DestSegment = CPU->Registers[Register_es];
+    u16 *SI = &CPU->Registers[Register_si];
+    u16 *DI = &CPU->Registers[Register_di];
+    u16 *CX = &CPU->Registers[Register_c];
+    u16 *AX = &CPU->Registers[Register_a];
+    
+    u16 Step = (u16)(Wide ? 2 : 1);
+    if(IsSet(CPU, Flag_Direction))
+    {
+        Step = (u16)-Step;
+    }
+    
+    b32 Repeat = (Instruction->Flags & Inst_Rep);
+    b32 StopOnZero = ((Instruction->Flags & Inst_RepNE) != 0);
+    while(!Repeat || *CX)
+    {
+        b32 Compares = false;
+        switch(Instruction->Op)
+        {
+            case Op_movs:
+            {
+                WriteMemory(CPU, DestSegment, *DI, Wide, ReadMemory(CPU, SourceSegment, *SI, Wide));
+                *SI += Step;
+                *DI += Step;
+            } break;
+            
+            case Op_stos:
+            {
+                WriteMemory(CPU, DestSegment, *DI, Wide, *AX);
+                *DI += Step;
+            } break;
+            
+            case Op_lods:
+            {
+                WriteRegister(CPU, RegisterAccess(Register_a, 0, Wide ? 2 : 1), ReadMemory(CPU, SourceSegment, *SI, Wide));
+                *SI += Step;
+            } break;
+            
+            case Op_cmps:
+            {
+                Subtract(CPU, Wide, ReadMemory(CPU, SourceSegment, *SI, Wide), ReadMemory(CPU, DestSegment, *DI, Wide), 0);
+                *SI += Step;
+                *DI += Step;
+                Compares = true;
+            } break;
+            
+            case Op_scas:
+            {
+                Subtract(CPU, Wide, *AX & GetWidthMask(Wide), ReadMemory(CPU, DestSegment, *DI, Wide), 0);
+                *DI += Step;
+                Compares = true;
+            } break;
+            
+            default: {} break;
+        }
+        
+        if(!Repeat)
+        {
+            break;
+        }
+        
+        --*CX;
+        if(Compares && (IsSet(CPU, Flag_Zero) == StopOnZero))
+        {
+            break;
+        }
+    }
+}
+
+static b32 IsConditionMet(cpu_8086 *CPU, operation_type Op)
+{
+    b32 CF = IsSet(CPU, Flag_Carry);
+    b32 ZF = IsSet(CPU, Flag_Zero);
+    b32 SF = IsSet(CPU, Flag_Sign);
+    b32 OF = IsSet(CPU, Flag_Overflow);
+    b32 PF = IsSet(CPU, Flag_Parity);
+    
+    b32 Result = false;
+    switch(Op)
+    {
+        case Op_je: {Result = ZF;} break;
+        case Op_jne: {Result = !ZF;} break;
+        case Op_jl: {Result = (SF != OF);} break;
+        case Op_jnl: {Result = (SF == OF);} break;
+        case Op_jle: {Result = ZF || (SF != OF);} break;
+        case Op_jg: {Result = !ZF && (SF == OF);} break;
+        case Op_jb: {Result = CF;} break;
+        case Op_jnb: {Result = !CF;} break;
+        case Op_jbe: {Result = CF || ZF;} break;
+        case Op_ja: {Result = !CF && !ZF;} break;
+        case Op_jp: {Result = PF;} break;
+        case Op_jnp: {Result = !PF;} break;
+        case Op_jo: {Result = OF;} break;
+        case Op_jno: {Result = !OF;} break;
+        case Op_js: {Result = SF;} break;
+        case Op_jns: {Result = !SF;} break;
+        default: {} break;
+    }
+    
+    return Result;
+}
+
+static void JumpOrCall(cpu_8086 *CPU, instruction *Instruction, b32 IsCall)
+{
+    u16 *IP = &CPU->Registers[Register_ip];
+    u16 *CS = &CPU->Registers[Register_cs];
+    
+    instruction_operand Target = Instruction->Operands[0];
+    b32 Far = false;
+    u16 NewIP = 0;
+    u16 NewCS = *CS;
+    if(Target.Type == Operand_Immediate)
+    {
+        NewIP = (u16)(*IP + Target.Immediate.Value);
+    }
+    else if((Target.Type == Operand_Memory) && (Target.Address.Flags & Address_ExplicitSegment))
+    {
+        Far = true;
+        NewIP = (u16)Target.Address.Displacement;
+        NewCS = (u16)Target.Address.ExplicitSegment;
+    }
+    else if((Target.Type == Operand_Memory) && (Instruction->Flags & Inst_Far))
+    {
+        Far = true;
+        u16 Segment = GetDataSegment(CPU, Instruction, Target.Address);
+        u16 Offset = GetEffectiveAddress(CPU, Target.Address);
+        NewIP = (u16)ReadMemory(CPU, Segment, Offset, true);
+        NewCS = (u16)ReadMemory(CPU, Segment, (u16)(Offset + 2), true);
+    }
+    else
+    {
+        NewIP = (u16)ReadOperand(CPU, Instruction, Target, true);
+    }
+    
+    if(IsCall)
+    {
+        if(Far)
+        {
+            Push(CPU, *CS);
+        }
+        Push(CPU, *IP);
+    }
+    
+    *IP = NewIP;
+    *CS = NewCS;
+}
+
+static execute_stop ExecuteInstruction(cpu_8086 *CPU, instruction *Instruction)
+{
+    execute_stop Result = ExecuteStop_None;
+    
+    u16 *Registers = CPU->Registers;
+    b32 Wide = (Instruction->Flags & Inst_Wide);
+    instruction_operand Dest = Instruction->Operands[0];
+    instruction_operand Source = Instruction->Operands[1];
+    if(Dest.Type == Operand_None)
+    {
+        // NOTE: Forms that encode their only register in the opcode (inc si, pop si, ...)
+        // decode it as the second operand, the way the REG field usually lands.
+        Dest = Source;
+        Source = {};
+    }
+    
+    if(!UsesLazyFlags(Instruction->Op))
+    {
+        MaterializeFlags(CPU);
+    }
+    
+    switch(Instruction->Op)
+    {
+        case Op_mov:
+        {
+            WriteOperand(CPU, Instruction, Dest, Wide, ReadOperand(CPU, Instruction, Source, Wide));
+        } break;
+        
+        case Op_add:
+        case Op_adc:
+        {
+            u32 Carry = (Instruction->Op == Op_adc) ? GetCarry(CPU) : 0;
+            u32 Value = Add(CPU, Wide, ReadOperand(CPU, Instruction, Dest, Wide), ReadOperand(CPU, Instruction, Source, Wide), Carry);
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_sub:
+        case Op_sbb:
+        {
+            u32 Borrow = (Instruction->Op == Op_sbb) ? GetCarry(CPU) : 0;
+            u32 Value = Subtract(CPU, Wide, ReadOperand(CPU, Instruction, Dest, Wide), ReadOperand(CPU, Instruction, Source, Wide), Borrow);
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_cmp:
+        {
+            Subtract(CPU, Wide, ReadOperand(CPU, Instruction, Dest, Wide), ReadOperand(CPU, Instruction, Source, Wide), 0);
+        } break;
+        
+        case Op_and:
+        case Op_test:
+        {
+            u32 Value = Logic(CPU, Wide, ReadOperand(CPU, Instruction, Dest, Wide) & ReadOperand(CPU, Instruction, Source, Wide));
+            if(Instruction->Op == Op_and)
+            {
+                WriteOperand(CPU, Instruction, Dest, Wide, Value);
+            }
+        } break;
+        
+        case Op_or:
+        {
+            u32 Value = Logic(CPU, Wide, ReadOperand(CPU, Instruction, Dest, Wide) | ReadOperand(CPU, Instruction, Source, Wide));
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_xor:
+        {
+            u32 Value = Logic(CPU, Wide, ReadOperand(CPU, Instruction, Dest, Wide) ^ ReadOperand(CPU, Instruction, Source, Wide));
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_inc:
+        case Op_dec:
+        {
+            u32 Value = IncrementOrDecrement(CPU, (Instruction->Op == Op_inc), Wide, ReadOperand(CPU, Instruction, Dest, Wide));
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_neg:
+        {
+            u32 Value = Subtract(CPU, Wide, 0, ReadOperand(CPU, Instruction, Dest, Wide), 0);
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_not:
+        {
+            u32 Value = ~ReadOperand(CPU, Instruction, Dest, Wide) & GetWidthMask(Wide);
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_shl:
+        case Op_shr:
+        case Op_sar:
+        case Op_rol:
+        case Op_ror:
+        case Op_rcl:
+        case Op_rcr:
+        {
+            u32 Count = ReadOperand(CPU, Instruction, Source, false);
+            u32 Value = Shift(CPU, Instruction->Op, Wide, ReadOperand(CPU, Instruction, Dest, Wide), Count);
+            WriteOperand(CPU, Instruction, Dest, Wide, Value);
+        } break;
+        
+        case Op_mul:
+        case Op_imul:
+        {
+            Result = Multiply(CPU, Instruction, Wide);
+        } break;
+        
+        case Op_div:
+        case Op_idiv:
+        {
+            Result = Divide(CPU, Instruction, Wide);
+        } break;
+        
+        case Op_cbw:
+        {
+            Registers[Register_a] = (u16)(s16)(s8)Registers[Register_a];
+        } break;
+        
+        case Op_cwd:
+        {
+            Registers[Register_d] = (Registers[Register_a] & 0x8000) ? 0xffff : 0;
+        } break;
+        
+        case Op_daa:
+        case Op_das:
+        {
+            u8 *AL = (u8 *)&Registers[Register_a];
+            u32 Before = *AL;
+            b32 Carry = IsSet(CPU, Flag_Carry);
+            b32 Subtracting = (Instruction->Op == Op_das);
+            
+            u16 Flags = 0;
+            if(((Before & 0xf) > 9) || IsSet(CPU, Flag_AuxCarry))
+            {
+                u32 Adjusted = Subtracting ? (*AL - 6) : (*AL + 6);
+                Carry = Carry || (Adjusted > 0xff);
+                *AL = (u8)Adjusted;
+                Flags |= Flag_AuxCarry;
+            }
+            if((Before > 0x99) || IsSet(CPU, Flag_Carry))
+            {
+                *AL = (u8)(Subtracting ? (*AL - 0x60) : (*AL + 0x60));
+                Carry = true;
+            }
+            else if(!Subtracting)
+            {
+                Carry = false;
+            }
+            
+            Flags |= GetResultFlags(false, *AL);
+            if(Carry)
+            {
+                Flags |= Flag_Carry;
+            }
+            SetArithmeticFlags(CPU, Flags);
+        } break;
+        
+        case Op_aaa:
+        case Op_aas:
+        {
+            u16 Flags = Registers[Register_flags] & ArithmeticFlags8086 & ~(Flag_AuxCarry|Flag_Carry);
+            if(((Registers[Register_a] & 0xf) > 9) || IsSet(CPU, Flag_AuxCarry))
+            {
+                u8 *AL = (u8 *)&Registers[Register_a];
+                u8 *AH = AL + 1;
+                if(Instruction->Op == Op_aaa)
+                {
+                    *AL += 6;
+                    *AH += 1;
+                }
+                else
+                {
+                    *AL -= 6;
+                    *AH -= 1;
+                }
+                Flags |= (Flag_AuxCarry|Flag_Carry);
+            }
+            Registers[Register_a] &= 0xff0f;
+            SetArithmeticFlags(CPU, Flags);
+        } break;
+        
+        case Op_aam:
+        {
+            u32 AL = Registers[Register_a] & 0xff;
+            Registers[Register_a] = (u16)(((AL / 10) << 8) | (AL % 10));
+            SetArithmeticFlags(CPU, GetResultFlags(false, AL % 10));
+        } break;
+        
+        case Op_aad:
+        {
+            u32 AL = ((Registers[Register_a] >> 8)*10 + (Registers[Register_a] & 0xff)) & 0xff;
+            Registers[Register_a] = (u16)AL;
+            SetArithmeticFlags(CPU, GetResultFlags(false, AL));
+        } break;
+        
+        case Op_xchg:
+        {
+            u32 A = ReadOperand(CPU, Instruction, Dest, Wide);
+            u32 B = ReadOperand(CPU, Instruction, Source, Wide);
+            WriteOperand(CPU, Instruction, Dest, Wide, B);
+            WriteOperand(CPU, Instruction, Source, Wide, A);
+        } break;
+        
+        case Op_lea:
+        {
+            WriteOperand(CPU, Instruction, Dest, true, GetEffectiveAddress(CPU, Source.Address));
+        } break;
+        
+        case Op_lds:
+        case Op_les:
+        {
+            u16 Segment = GetDataSegment(CPU, Instruction, Source.Address);
+            u16 Offset = GetEffectiveAddress(CPU, Source.Address);
+            WriteOperand(CPU, Instruction, Dest, true, ReadMemory(CPU, Segment, Offset, true));
+            Registers[(Instruction->Op == Op_lds) ? Register_ds : Register_es] = (u16)ReadMemory(CPU, Segment, (u16)(Offset + 2), true);
+        } break;
+        
+        case Op_xlat:
+        {
+            u16 Segment = CPU->Registers[(Instruction->Flags & Inst_Segment) ? Instruction->SegmentOverride : (u32)Register_ds];
+            u16 Offset = (u16)(Registers[Register_b] + (Registers[Register_a] & 0xff));
+            Registers[Register_a] = (u16)((Registers[Register_a] & 0xff00) | ReadMemory(CPU, Segment, Offset, false));
+        } break;
+        
+        case Op_push:
+        {
+            // NOTE: push sp pushes the value sp has after the push, as the 8086 does.
+            Registers[Register_sp] -= 2;
+            u32 Value = ReadOperand(CPU, Instruction, Dest, true);
+            WriteMemory(CPU, Registers[Register_ss], Registers[Register_sp], true, Value);
+        } break;
+        
+        case Op_pop:
+        {
+            WriteOperand(CPU, Instruction, Dest, true, Pop(CPU));
+        } break;
+        
+        case Op_pushf:
+        {
+            Push(CPU, Registers[Register_flags]);
+        } break;
+        
+        case Op_popf:
+        {
+            Registers[Register_flags] = Pop(CPU) & DefinedFlags8086;
+        } break;
+        
+        case Op_lahf:
+        {
+            u8 *AH = (u8 *)&Registers[Register_a] + 1;
+            *AH = (u8)Registers[Register_flags];
+        } break;
+        
+        case Op_sahf:
+        {
+            u16 Low = (Flag_Carry|Flag_Parity|Flag_AuxCarry|Flag_Zero|Flag_Sign);
+            Registers[Register_flags] = (u16)((Registers[Register_flags] & ~Low) | ((Registers[Register_a] >> 8) & Low));
+        } break;
+        
+        case Op_movs:
+        case Op_cmps:
+        case Op_scas:
+        case Op_lods:
+        case Op_stos:
+        {
+            ExecuteString(CPU, Instruction, Wide);
+        } break;
+        
+        case Op_jmp:
+        {
+            JumpOrCall(CPU, Instruction, false);
+        } break;
+        
+        case Op_call:
+        {
+            JumpOrCall(CPU, Instruction, true);
+        } break;
+        
+        case Op_ret:
+        case Op_retf:
+        {
+            Registers[Register_ip] = Pop(CPU);
+            if(Instruction->Op == Op_retf)
+            {
+                Registers[Register_cs] = Pop(CPU);
+            }
+            Registers[Register_sp] += (u16)ReadOperand(CPU, Instruction, Dest, true);
+        } break;
+        
+        case Op_je: case Op_jne: case Op_jl: case Op_jnl: case Op_jle: case Op_jg: case Op_jb: case Op_jnb:
+        case Op_jbe: case Op_ja: case Op_jp: case Op_jnp: case Op_jo: case Op_jno: case Op_js: case Op_jns:
+        {
+            if(IsConditionMet(CPU, Instruction->Op))
+            {
+                Registers[Register_ip] += (u16)Dest.Immediate.Value;
+            }
+        } break;
+        
+        case Op_loop:
+        case Op_loopz:
+        case Op_loopnz:
+        {
+            u16 CX = --Registers[Register_c];
+            b32 Taken = (CX != 0);
+            if(Instruction->Op == Op_loopz)
+            {
+                Taken = Taken && IsSet(CPU, Flag_Zero);
+            }
+            else if(Instruction->Op == Op_loopnz)
+            {
+                Taken = Taken && !IsSet(CPU, Flag_Zero);
+            }
+            
+            if(Taken)
+            {
+                Registers[Register_ip] += (u16)Dest.Immediate.Value;
+            }
+        } break;
+        
+        case Op_jcxz:
+        {
+            if(Registers[Register_c] == 0)
+            {
+                Registers[Register_ip] += (u16)Dest.Immediate.Value;
+            }
+        } break;
+        
+        case Op_int:
+        {
+            Result = Interrupt(CPU, ReadOperand(CPU, Instruction, Dest, false));
+        } break;
+        
+        case Op_int3:
+        {
+            Result = Interrupt(CPU, 3);
+        } break;
+        
+        case Op_into:
+        {
+            if(IsSet(CPU, Flag_Overflow))
+            {
+                Result = Interrupt(CPU, 4);
+            }
+        } break;
+        
+        case Op_iret:
+        {
+            Registers[Register_ip] = Pop(CPU);
+            Registers[Register_cs] = Pop(CPU);
+            Registers[Register_flags] = Pop(CPU) & DefinedFlags8086;
+        } break;
+        
+        case Op_in:
+        {
+            WriteOperand(CPU, Instruction, Dest, Wide, GetWidthMask(Wide));
+        } break;
+        
+        case Op_clc: {Registers[Register_flags] &= ~Flag_Carry;} break;
+        case Op_stc: {Registers[Register_flags] |= Flag_Carry;} break;
+        case Op_cmc: {Registers[Register_flags] ^= Flag_Carry;} break;
+        case Op_cld: {Registers[Register_flags] &= ~Flag_Direction;} break;
+        case Op_std: {Registers[Register_flags] |= Flag_Direction;} break;
+        case Op_cli: {Registers[Register_flags] &= ~Flag_Interrupt;} break;
+        case Op_sti: {Registers[Register_flags] |= Flag_Interrupt;} break;
+        
+        case Op_hlt:
+        {
+            Result = ExecuteStop_Halt;
+        } break;
+        
+        // NOTE: Prefixes are folded into the instruction they apply to, so lock, rep and
+        // segment never get here on their own.
+        case Op_out:
+        case Op_wait:
+        case Op_esc:
+        case Op_lock:
+        case Op_rep:
+        case Op_segment:
+        default: {} break;
+    }
+    
+    return Result;
+}
+
+static execute_stop ExecuteStep(cpu_8086 *CPU, instruction_table Table, decode_instruction *Decode)
+{
+    execute_stop Result = ExecuteStop_Unrecognized;
+    
+    segmented_access At = CPU->Memory;
+    At.SegmentBase = CPU->Registers[Register_cs];
+    At.SegmentOffset = CPU->Registers[Register_ip];
+    
+    instruction Instruction = Decode(Table, At);
+    if(Instruction.Op)
+    {
+        // NOTE: ip moves past the instruction before it executes, since that is what
+        // relative jumps, calls and interrupts are relative to.
+        CPU->Registers[Register_ip] += (u16)Instruction.Size;
+        ++CPU->InstructionCount;
+        
+        Result = ExecuteInstruction(CPU, &Instruction);
+    }
+    
+    return Result;
+}
+
+static execute_stop ExecuteBlock(cpu_8086 *CPU, instruction_table Table, decode_instruction *Decode)
+{
+    execute_stop Result = ExecuteStop_None;
+    
+    block_cache *Cache = CPU->Cache;
+    cached_block *Block = GetCachedBlock(Cache, CPU->Memory, CPU->Registers[Register_cs], CPU->Registers[Register_ip],
+                                         CPU->ProgramEnd, Table, Decode);
+    if(Block)
+    {
+        // NOTE: If anything the block does invalidates cached code, the rest of the block
+        // may be stale, so it goes back for a fresh lookup. The instructions themselves stay
+        // put until the next lookup, so the one running is unaffected.
+        u32 Generation = Cache->Generation;
+        instruction *Instructions = Cache->Instructions + Block->FirstInstruction;
+        u32 InstructionCount = Block->InstructionCount;
+        
+        // NOTE: Compiled code may stop partway through the block, and the interpreter picks
+        // up from wherever it left off.
+        u32 InstructionIndex = 0;
+        if(CPU->Jit)
+        {
+            // NOTE: Compiled code works on the flags register directly.
+            MaterializeFlags(CPU);
+            InstructionIndex = RunCompiledBlock(CPU->Jit, Cache, Block, CPU);
+        }
+        
+        if(CPU->Threaded)
+        {
+            Result = RunThreadedBlock(CPU->Threaded, Cache, Block, CPU, InstructionIndex);
+        }
+        else
+        {
+            for(; InstructionIndex < InstructionCount; ++InstructionIndex)
+            {
+                instruction *Instruction = &Instructions[InstructionIndex];
+                CPU->Registers[Register_ip] += (u16)Instruction->Size;
+                ++CPU->InstructionCount;
+                
+                Result = ExecuteInstruction(CPU, Instruction);
+                if(Result || (Cache->Generation != Generation))
+                {
+                    break;
+                }
+            }
+        }
+    }
+    else
+    {
+        Result = ExecuteStep(CPU, Table, Decode);
+    }
+    
+    return Result;
+}
+
+static execute_stop Execute8086(cpu_8086 *CPU, instruction_table Table, decode_instruction *Decode)
+{
+    execute_stop Result = ExecuteStop_None;
+    
+    if(CPU->Cache)
+    {
+        ResetBlockCache(CPU->Cache, CPU->Memory);
+    }
+    
+    while(!Result)
+    {
+        segmented_access At = CPU->Memory;
+        At.SegmentBase = CPU->Registers[Register_cs];
+        At.SegmentOffset = CPU->Registers[Register_ip];
+        if(GetAbsoluteAddressOf(At) >= CPU->ProgramEnd)
+        {
+            Result = ExecuteStop_EndOfProgram;
+        }
+        else if(CPU->InstructionLimit && (CPU->InstructionCount >= CPU->InstructionLimit))
+        {
+            Result = ExecuteStop_InstructionLimit;
+        }
+        else if(CPU->Cache)
+        {
+            Result = ExecuteBlock(CPU, Table, Decode);
+        }
+        else
+        {
+            Result = ExecuteStep(CPU, Table, Decode);
+        }
+    }
+    
+    MaterializeFlags(CPU);
+    
+    return Result;
+}
+
+static void ReportExecuteStop(cpu_8086 *CPU, execute_stop Stop)
+{
+    switch(Stop)
+    {
+        case ExecuteStop_None:
+        case ExecuteStop_EndOfProgram:
+        case ExecuteStop_Halt: {} break;
+        
+        case ExecuteStop_Unrecognized:
+        {
+            fprintf(stderr, "ERROR: Unrecognized instruction at %04x:%04x.\n",
+                    CPU->Registers[Register_cs], CPU->Registers[Register_ip]);
+        } break;
+        
+        case ExecuteStop_Interrupt:
+        {
+            fprintf(stderr, "ERROR: Interrupt %u has no handler (at %04x:%04x).\n", CPU->StopInterrupt,
+                    CPU->Registers[Register_cs], CPU->Registers[Register_ip]);
+        } break;
+        
+        case ExecuteStop_InstructionLimit:
+        {
+            fprintf(stderr, "WARNING: Stopped after %llu instructions (at %04x:%04x).\n", CPU->InstructionCount,
+                    CPU->Registers[Register_cs], CPU->Registers[Register_ip]);
+        } break;
+    }
+}
+
+static void PrintRegisters(FILE *Dest, cpu_8086 *CPU)
+{
+    // NOTE: Registers that are zero are left out, and the flags are printed as the letters
+    // of the ones that are set.
+    for(u32 RegisterIndex = Register_a; RegisterIndex < Register_flags; ++RegisterIndex)
+    {
+        u16 Value = CPU->Registers[RegisterIndex];
+        if(Value)
+        {
+            fprintf(Dest, "      %s: 0x%04x (%u)\n", GetRegNameSpan(RegisterAccess(RegisterIndex, 0, 2)).Data, Value, Value);
+        }
+    }
+    
+    char const FlagLetters[] = "C?P?A?ZSTIDO";
+    char Flags[16] = {};
+    u32 FlagCount = 0;
+    for(u32 Bit = 0; Bit < (ArrayCount(FlagLetters) - 1); ++Bit)
+    {
+        if((CPU->Registers[Register_flags] & (1 << Bit)) && (FlagLetters[Bit] != '?'))
+        {
+            Flags[FlagCount++] = FlagLetters[Bit];
+        }
+    }
+    
+    if(FlagCount)
+    {
+        fprintf(Dest, "   flags: %s\n", Flags);
+    }
+}
@@ -0,0 +1,104 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+enum flag_8086 : u16
+{
+    Flag_Carry = 0x1,
+    Flag_Parity = 0x4,
+    Flag_AuxCarry = 0x10,
+    Flag_Zero = 0x40,
+    Flag_Sign = 0x80,
+    Flag_Trap = 0x100,
+    Flag_Interrupt = 0x200,
+    Flag_Direction = 0x400,
+    Flag_Overflow = 0x800,
+};
+
+enum execute_stop : u32
+{
+    ExecuteStop_None, // NOTE: Still running
+    ExecuteStop_EndOfProgram, // NOTE: cs:ip left the loaded program
+    ExecuteStop_Halt,
+    ExecuteStop_Unrecognized,
+    ExecuteStop_Interrupt, // NOTE: An interrupt whose vector is zero (nothing is installed to handle it)
+    ExecuteStop_InstructionLimit,
+};
+
+// NOTE: The last operation that set the arithmetic flags, kept in place of the flags
+// themselves until something reads them (see MaterializeFlags).
+enum lazy_flags_op : u32
+{
+    LazyFlags_None, // NOTE: The flags register is up to date
+    LazyFlags_Add,
+    LazyFlags_Subtract,
+    LazyFlags_Logic,
+    LazyFlags_Increment, // NOTE: CarryIn holds the CF that inc and dec leave alone
+    LazyFlags_Decrement,
+};
+struct lazy_flags
+{
+    lazy_flags_op Op;
+    b32 Wide;
+    u32 A;
+    u32 B;
+    u32 CarryIn;
+    u32 Result;
+};
+
+struct threaded_code;
+struct jit;
+
+struct cpu_8086
+{
+    // NOTE: Indexed by register_mapping_8086, so a decoded register_access addresses its
+    // register directly. ip and flags live here too. 8-bit registers are the low and high
+    // byte of their 16-bit register in host memory, which assumes a little-endian host.
+    // This has to stay the first member, since compiled code addresses it at offset 0.
+    u16 Registers[Register_count];
+    
+    // NOTE: The program is loaded at address 0, and it ends when cs:ip reaches ProgramEnd
+    // (or any address outside the program).
+    segmented_access Memory;
+    u32 ProgramEnd;
+    
+    // NOTE: Optional. When it is set, instructions are run from decoded blocks kept here
+    // rather than decoded one at a time, and every write to memory goes past it so that
+    // blocks whose code is overwritten get thrown away.
+    block_cache *Cache;
+    
+    // NOTE: Optional, and only used along with Cache. Blocks that get hot are compiled to
+    // native code and run that way.
+    jit *Jit;
+    
+    // NOTE: Optional, and only used along with Cache. When it is set, blocks are run as
+    // threaded code rather than by calling ExecuteInstruction for each one in turn.
+    threaded_code *Threaded;
+    
+    // NOTE: Unless EagerFlags is set, add, sub, cmp, the logical operations and friends only
+    // record what they did in LazyFlags, and the arithmetic bits of Registers[Register_flags]
+    // are brought up to date when something reads them. Everything outside the executor
+    // sees up to date flags, since Execute8086 brings them up to date before it returns.
+    b32 EagerFlags;
+    lazy_flags LazyFlags;
+    
+    // NOTE: Optional. When it is nonzero, execution stops once at least this many instructions
+    // have run (it checks between blocks, so it can go past by up to a block).
+    u64 InstructionLimit;
+    
+    u64 InstructionCount;
+    u32 StopInterrupt; // NOTE: For ExecuteStop_Interrupt, the interrupt that had no vector
+};
+
+static cpu_8086 CPU8086(segmented_access Memory, u32 ProgramEnd);
+static execute_stop Execute8086(cpu_8086 *CPU, instruction_table Table, decode_instruction *Decode);
+static void ReportExecuteStop(cpu_8086 *CPU, execute_stop Stop);
+static void PrintRegisters(FILE *Dest, cpu_8086 *CPU);
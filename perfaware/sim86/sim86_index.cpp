@@ -0,0 +1,282 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+static u64 MixHash(u64 Hash)
+{
+    Hash ^= (Hash >> 33);
+    Hash *= 0xff51afd7ed558ccdull;
+    Hash ^= (Hash >> 33);
+    return Hash;
+}
+
+static u64 HashImage(u64 Size, u8 *Data)
+{
+    // NOTE: This only has to tell one image from another, not resist anyone trying to
+    // collide it. Four independent lanes keep the multiplies from serializing, so hashing
+    // runs far ahead of decoding and is cheap enough to do on every run.
+    u64 Lanes[4] =
+    {
+        0x9e3779b97f4a7c15ull ^ Size,
+        0xbf58476d1ce4e5b9ull,
+        0x94d049bb133111ebull,
+        0x2545f4914f6cdd1dull,
+    };
+    
+    u64 Offset = 0;
+    for(; (Offset + 32) <= Size; Offset += 32)
+    {
+        for(u32 Lane = 0; Lane < 4; ++Lane)
+        {
+            u64 Word;
+            memcpy(&Word, Data + Offset + 8*Lane, sizeof(Word));
+            Lanes[Lane] = (Lanes[Lane] ^ Word) * 0x9fb21c651e98df25ull;
+            Lanes[Lane] ^= (Lanes[Lane] >> 29);
+        }
+    }
+    
+    u8 Tail[32] = {};
+    if(Offset < Size)
+    {
+        memcpy(Tail, Data + Offset, Size - Offset);
+    }
+    for(u32 Lane = 0; Lane < 4; ++Lane)
+    {
+        u64 Word;
+        memcpy(&Word, Tail + 8*Lane, sizeof(Word));
+        Lanes[Lane] = MixHash(Lanes[Lane] ^ Word);
+    }
+    
+    u64 Result = MixHash(Lanes[0] ^ MixHash(Lanes[1] ^ MixHash(Lanes[2] ^ MixHash(Lanes[3]))));
+    return Result;
+}
+
+static u64 GetDisAsmIndexSize(u64 InstructionCount)
+{
+    u64 Result = sizeof(disasm_index_header) + InstructionCount*(sizeof(packed_instruction) + sizeof(u32));
+    return Result;
+}
+
+static b32 IsValidDisAsmIndex(mapped_file *Index, u64 ImageSize, u64 ImageHash)
+{
+    b32 Result = false;
+    
+    if(Index->Size >= sizeof(disasm_index_header))
+    {
+        disasm_index_header *Header = (disasm_index_header *)Index->Data;
+        Result = ((Header->Magic == DisAsmIndexMagic) &&
+                  (Header->Version == DisAsmIndexVersion) &&
+                  (Header->RecordSize == sizeof(packed_instruction)) &&
+                  (Header->ImageSize == ImageSize) &&
+                  (Header->ImageHash == ImageHash) &&
+                  (Header->InstructionCount <= ImageSize) &&
+                  (Index->Size == GetDisAsmIndexSize(Header->InstructionCount)));
+    }
+    
+    return Result;
+}
+
+static disasm_stop DisAsm8086FromIndex(mapped_file *Index, text_buffer *Output, output_format Format)
+{
+    disasm_index_header *Header = (disasm_index_header *)Index->Data;
+    packed_instruction *Records = (packed_instruction *)(Header + 1);
+    
+    if(Format == OutputFormat_Binary)
+    {
+        // NOTE: AppendText writes anything too big for the buffer straight through, so
+        // this is one write of the whole mapping, a u32 at a time.
+        u64 RecordIndex = 0;
+        while(RecordIndex < Header->InstructionCount)
+        {
+            u64 Count = Header->InstructionCount - RecordIndex;
+            if(Count > (0xffffffff / sizeof(packed_instruction)))
+            {
+                Count = (0xffffffff / sizeof(packed_instruction));
+            }
+            
+            AppendText(Output, (u32)(Count*sizeof(packed_instruction)), (char *)(Records + RecordIndex));
+            RecordIndex += Count;
+        }
+    }
+    else
+    {
+        for(u64 RecordIndex = 0; RecordIndex < Header->InstructionCount; ++RecordIndex)
+        {
+            AppendDisAsmInstruction(Output, Format, ExpandInstruction(Records[RecordIndex]));
+        }
+    }
+    
+    disasm_stop Result = (disasm_stop)Header->Stop;
+    return Result;
+}
+
+struct disasm_index_builder
+{
+    u64 Count;
+    u64 Capacity;
+    packed_instruction *Records;
+    u32 *Boundaries;
+    b32 Failed;
+};
+
+static void AddToIndex(disasm_index_builder *Builder, instruction Instruction, u64 Offset)
+{
+    if(!Builder->Failed && (Builder->Count == Builder->Capacity))
+    {
+        u64 NewCapacity = 2*Builder->Capacity;
+        packed_instruction *Records = (packed_instruction *)realloc(Builder->Records, NewCapacity*sizeof(packed_instruction));
+        if(Records)
+        {
+            Builder->Records = Records;
+        }
+        
+        u32 *Boundaries = (u32 *)realloc(Builder->Boundaries, NewCapacity*sizeof(u32));
+        if(Boundaries)
+        {
+            Builder->Boundaries = Boundaries;
+        }
+        
+        Builder->Capacity = NewCapacity;
+        Builder->Failed = (!Records || !Boundaries);
+    }
+    
+    if(!Builder->Failed)
+    {
+        Builder->Boundaries[Builder->Count] = (u32)Offset;
+        Builder->Failed = !CompressInstruction(Instruction, &Builder->Records[Builder->Count]);
+        ++Builder->Count;
+    }
+}
+
+static disasm_stop DisAsm8086AndBuildIndex(u64 ImageSize, u8 *Image, u64 ImageHash, decode_instruction *Decode,
+                                           text_buffer *Output, output_format Format, char *IndexFileName)
+{
+    // NOTE: Identical to DisAsm8086Linear, except that every instruction is also packed
+    // into the index, which is written out at the end.
+    disasm_stop Result = DisAsmStop_None;
+    
+    instruction_table Table = Get8086InstructionTable();
+    
+    // NOTE: Most instructions are more than two bytes, so starting at a third of the image
+    // size usually means never growing at all.
+    disasm_index_builder Builder = {};
+    Builder.Capacity = (ImageSize / 3) + 16;
+    Builder.Records = (packed_instruction *)malloc(Builder.Capacity*sizeof(packed_instruction));
+    Builder.Boundaries = (u32 *)malloc(Builder.Capacity*sizeof(u32));
+    Builder.Failed = (!Builder.Records || !Builder.Boundaries);
+    
+    u64 Offset = 0;
+    while(Offset < ImageSize)
+    {
+        u64 Remaining = ImageSize - Offset;
+        instruction Instruction = DecodeInstructionFromBuffer(Table, Remaining, Image + Offset, Decode);
+        Result = GetDisAsmStop(Instruction, Remaining);
+        if(Result)
+        {
+            break;
+        }
+        
+        Instruction.Address = (u32)Offset;
+        AddToIndex(&Builder, Instruction, Offset);
+        Offset += Instruction.Size;
+        
+        AppendDisAsmInstruction(Output, Format, Instruction);
+    }
+    
+    b32 Written = false;
+    if(!Builder.Failed)
+    {
+        disasm_index_header Header = {};
+        Header.Magic = DisAsmIndexMagic;
+        Header.Version = DisAsmIndexVersion;
+        Header.RecordSize = sizeof(packed_instruction);
+        Header.Stop = Result;
+        Header.ImageSize = ImageSize;
+        Header.ImageHash = ImageHash;
+        Header.InstructionCount = Builder.Count;
+        
+        FILE *File = fopen(IndexFileName, "wb");
+        if(File)
+        {
+            Written = ((fwrite(&Header, sizeof(Header), 1, File) == 1) &&
+                       (fwrite(Builder.Records, sizeof(packed_instruction), Builder.Count, File) == Builder.Count) &&
+                       (fwrite(Builder.Boundaries, sizeof(u32), Builder.Count, File) == Builder.Count));
+            Written = (fclose(File) == 0) && Written;
+            
+            // NOTE: A partly written index would be rejected as stale anyway, but there is
+            // no reason to leave it lying around.
+            if(!Written)
+            {
+                remove(IndexFileName);
+            }
+        }
+    }
+    
+    if(!Written)
+    {
+        FlushTextBuffer(Output);
+        fprintf(stderr, "WARNING: Unable to write index %s.\n", IndexFileName);
+    }
+    
+    free(Builder.Records);
+    free(Builder.Boundaries);
+    
+    return Result;
+}
+
+static disasm_stop DisAsm8086Indexed(char *FileName, mapped_file *Image, decode_instruction *Decode,
+                                     text_buffer *Output, output_format Format)
+{
+    disasm_stop Result = DisAsmStop_None;
+    
+    char const Extension[] = ".sim86idx";
+    size_t FileNameLength = strlen(FileName);
+    char *IndexFileName = (char *)malloc(FileNameLength + sizeof(Extension));
+    
+    // NOTE: Boundaries are stored as 32-bit offsets, so larger images are not indexed.
+    b32 Indexable = (Image->Size <= 0xffffffff);
+    if(IndexFileName && Indexable)
+    {
+        memcpy(IndexFileName, FileName, FileNameLength);
+        memcpy(IndexFileName + FileNameLength, Extension, sizeof(Extension));
+        
+        u64 ImageHash = HashImage(Image->Size, Image->Data);
+        
+        mapped_file Index;
+        b32 Reuse = (MapFileReadOnly(IndexFileName, &Index) && IsValidDisAsmIndex(&Index, Image->Size, ImageHash));
+        if(Reuse)
+        {
+            Result = DisAsm8086FromIndex(&Index, Output, Format);
+        }
+        
+        // NOTE: The old index has to be unmapped before it can be overwritten.
+        UnmapFile(&Index);
+        
+        if(!Reuse)
+        {
+            Result = DisAsm8086AndBuildIndex(Image->Size, Image->Data, ImageHash, Decode, Output, Format, IndexFileName);
+        }
+    }
+    else
+    {
+        if(!Indexable)
+        {
+            FlushTextBuffer(Output);
+            fprintf(stderr, "WARNING: %s is too large to index.\n", FileName);
+        }
+        
+        Result = DisAsm8086Linear(Image->Size, Image->Data, Decode, Output, Format);
+    }
+    
+    free(IndexFileName);
+    
+    return Result;
+}
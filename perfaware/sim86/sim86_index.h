@@ -0,0 +1,51 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: A .sim86idx file caches the disassembly of one image, so that disassembling the
+   same image again does not have to decode it. It is laid out as:
+   
+       disasm_index_header
+       packed_instruction Records[InstructionCount]
+       u32 Boundaries[InstructionCount]     (the offset of each instruction in the image)
+   
+   The records are exactly what --format=bin writes for each instruction (their Address is
+   the instruction's offset in the image), so that output is copied straight out of the
+   mapping.
+   
+   The index is used straight out of a read-only mapping. It is keyed by a hash of the image
+   contents rather than by file time, so a copied or touched image still hits, and an
+   edited one misses. Anything that does not match (image, format version, record size or
+   file length) is treated as stale and rebuilt.
+   
+   The records are the decoder's output, so DisAsmIndexVersion has to go up whenever the
+   decoder starts producing something different for the same bytes (version 3 added
+   Inst_RepNE), or old indexes would keep serving the old decoding. */
+
+static u32 const DisAsmIndexMagic = 0x58363853; // NOTE: "S86X"
+static u32 const DisAsmIndexVersion = 3;
+
+struct disasm_index_header
+{
+    u32 Magic;
+    u32 Version;
+    u32 RecordSize;
+    u32 Stop; // NOTE: The disasm_stop that ended the disassembly, reported again on reuse
+    u64 ImageSize;
+    u64 ImageHash;
+    u64 InstructionCount;
+    u64 Reserved[3];
+};
+static_assert(sizeof(disasm_index_header) == 64, "disasm_index_header should stay at 64 bytes");
+
+static u64 HashImage(u64 Size, u8 *Data);
+static disasm_stop DisAsm8086Indexed(char *FileName, mapped_file *Image, decode_instruction *Decode,
+                                     text_buffer *Output, output_format Format);
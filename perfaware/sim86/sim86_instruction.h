@@ -28,6 +28,7 @@ enum instruction_flag : u32
     Inst_Segment = 0x4,
     Inst_Wide = 0x8,
     Inst_Far = 0x10,
+    Inst_RepNE = 0x20, // NOTE: Set along with Inst_Rep for the F2 form of the prefix (repne/repnz)
 };
 
 struct register_access
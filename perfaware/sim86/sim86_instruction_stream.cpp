@@ -0,0 +1,258 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+static u64 GetInstructionStreamBytes(u32 Capacity)
+{
+    u64 BytesPerInstruction = (sizeof(u32) + 4*sizeof(u8) +
+                               2*(2*sizeof(u8) + 2*sizeof(s32)));
+    u64 Result = BytesPerInstruction*Capacity;
+    return Result;
+}
+
+static instruction_stream InstructionStreamFromMemory(u32 Capacity, void *Memory)
+{
+    // NOTE: Memory must hold GetInstructionStreamBytes(Capacity) bytes. The 32-bit arrays
+    // come first so they stay aligned if Memory is.
+    instruction_stream Result = {};
+    Result.Capacity = Capacity;
+    
+    u8 *At = (u8 *)Memory;
+    Result.Address = (u32 *)At; At += Capacity*sizeof(u32);
+    for(u32 OperandIndex = 0; OperandIndex < 2; ++OperandIndex)
+    {
+        Result.Displacement[OperandIndex] = (s32 *)At; At += Capacity*sizeof(s32);
+        Result.Immediate[OperandIndex] = (s32 *)At; At += Capacity*sizeof(s32);
+    }
+    Result.Size = At; At += Capacity;
+    Result.Op = At; At += Capacity;
+    Result.Flags = At; At += Capacity;
+    Result.SegmentOverride = At; At += Capacity;
+    for(u32 OperandIndex = 0; OperandIndex < 2; ++OperandIndex)
+    {
+        Result.OperandType[OperandIndex] = At; At += Capacity;
+        Result.OperandRegister[OperandIndex] = At; At += Capacity;
+    }
+    
+    assert((u64)(At - (u8 *)Memory) == GetInstructionStreamBytes(Capacity));
+    return Result;
+}
+
+static void AppendToInstructionStream(instruction_stream *Stream, instruction Instruction)
+{
+    assert(Stream->Count < Stream->Capacity);
+    u32 Index = Stream->Count++;
+    
+    Stream->Address[Index] = Instruction.Address;
+    Stream->Size[Index] = (u8)Instruction.Size;
+    Stream->Op[Index] = (u8)Instruction.Op;
+    Stream->Flags[Index] = (u8)Instruction.Flags;
+    Stream->SegmentOverride[Index] = (u8)Instruction.SegmentOverride;
+    
+    for(u32 OperandIndex = 0; OperandIndex < 2; ++OperandIndex)
+    {
+        instruction_operand Operand = Instruction.Operands[OperandIndex];
+        
+        u8 Type = (u8)Operand.Type;
+        u8 Register = 0;
+        s32 Displacement = 0;
+        s32 Immediate = 0;
+        switch(Operand.Type)
+        {
+            case Operand_None: {} break;
+            
+            case Operand_Register:
+            {
+                register_access Reg = Operand.Register;
+                Register = (u8)((Reg.Index & PackedRegister_IndexMask) |
+                                (Reg.Offset ? PackedRegister_High : 0) |
+                                ((Reg.Count == 2) ? PackedRegister_Wide : 0));
+            } break;
+            
+            case Operand_Memory:
+            {
+                effective_address_expression Address = Operand.Address;
+                Displacement = Address.Displacement;
+                if(Address.Flags & Address_ExplicitSegment)
+                {
+                    Register = PackedAddress_Intersegment;
+                    Immediate = Address.ExplicitSegment;
+                }
+                else
+                {
+                    Register = (u8)((Address.Terms[0].Register.Index & 0xf) | (Address.Terms[1].Register.Index << 4));
+                }
+            } break;
+            
+            case Operand_Immediate:
+            {
+                Immediate = Operand.Immediate.Value;
+                if(Operand.Immediate.Flags & Immediate_RelativeJumpDisplacement)
+                {
+                    Type |= StreamOperand_RelativeJump;
+                }
+            } break;
+        }
+        
+        Stream->OperandType[OperandIndex][Index] = Type;
+        Stream->OperandRegister[OperandIndex][Index] = Register;
+        Stream->Displacement[OperandIndex][Index] = Displacement;
+        Stream->Immediate[OperandIndex][Index] = Immediate;
+    }
+}
+
+static instruction GetStreamInstruction(instruction_stream *Stream, u32 Index)
+{
+    // NOTE: Rebuilds the full instruction, with the same constructors the decoder uses.
+    instruction Result = {};
+    
+    Result.Address = Stream->Address[Index];
+    Result.Size = Stream->Size[Index];
+    Result.Op = (operation_type)Stream->Op[Index];
+    Result.Flags = Stream->Flags[Index];
+    Result.SegmentOverride = Stream->SegmentOverride[Index];
+    
+    for(u32 OperandIndex = 0; OperandIndex < 2; ++OperandIndex)
+    {
+        u8 Type = Stream->OperandType[OperandIndex][Index];
+        u8 Register = Stream->OperandRegister[OperandIndex][Index];
+        s32 Displacement = Stream->Displacement[OperandIndex][Index];
+        s32 Immediate = Stream->Immediate[OperandIndex][Index];
+        
+        instruction_operand *Operand = &Result.Operands[OperandIndex];
+        switch(Type & StreamOperand_TypeMask)
+        {
+            case Operand_Register:
+            {
+                Operand->Type = Operand_Register;
+                Operand->Register = RegisterAccess(Register & PackedRegister_IndexMask,
+                                                   (Register & PackedRegister_High) ? 1 : 0,
+                                                   (Register & PackedRegister_Wide) ? 2 : 1);
+            } break;
+            
+            case Operand_Memory:
+            {
+                if(Register == PackedAddress_Intersegment)
+                {
+                    *Operand = IntersegmentAddressOperand(Immediate, Displacement);
+                }
+                else
+                {
+                    *Operand = EffectiveAddressOperand(RegisterAccess(Register & 0xf, 0, 2), RegisterAccess(Register >> 4, 0, 2),
+                                                       Displacement);
+                }
+            } break;
+            
+            case Operand_Immediate:
+            {
+                *Operand = ImmediateOperand(Immediate, (Type & StreamOperand_RelativeJump) ? (u32)Immediate_RelativeJumpDisplacement : (u32)0);
+            } break;
+        }
+    }
+    
+    return Result;
+}
+
+static u32 DecodeInstructionBufferToStream(instruction_table Table, u32 SourceSize, u8 *Source,
+                                           instruction_stream *Stream, u32 *BytesConsumed)
+{
+    // NOTE: Appends to Stream with the same stopping rules as DecodeInstructionBuffer, and
+    // returns the number of instructions appended.
+    u32 StartCount = Stream->Count;
+    u32 Offset = 0;
+    while((Stream->Count < Stream->Capacity) && (Offset < SourceSize))
+    {
+        u32 Remaining = SourceSize - Offset;
+        instruction Instruction = DecodeInstructionFromBuffer(Table, Remaining, Source + Offset);
+        if(!Instruction.Op || (Instruction.Size > Remaining))
+        {
+            break;
+        }
+        
+        Instruction.Address = Offset;
+        AppendToInstructionStream(Stream, Instruction);
+        Offset += Instruction.Size;
+    }
+    
+    *BytesConsumed = Offset;
+    u32 Result = Stream->Count - StartCount;
+    return Result;
+}
+
+//
+// NOTE: Passes over a stream. These are written as plain loops over one or two arrays, with
+// no branches in the loop body, so the compiler is free to unroll and vectorize them.
+//
+
+static void CountOps(instruction_stream *Stream, u32 *Histogram)
+{
+    // NOTE: Histogram must have Op_Count entries. Four partial histograms are kept so that
+    // runs of the same op do not serialize on a single counter.
+    u32 Partial[4][Op_Count] = {};
+    
+    u32 Index = 0;
+    for(; (Index + 4) <= Stream->Count; Index += 4)
+    {
+        ++Partial[0][Stream->Op[Index + 0]];
+        ++Partial[1][Stream->Op[Index + 1]];
+        ++Partial[2][Stream->Op[Index + 2]];
+        ++Partial[3][Stream->Op[Index + 3]];
+    }
+    for(; Index < Stream->Count; ++Index)
+    {
+        ++Partial[0][Stream->Op[Index]];
+    }
+    
+    for(u32 Op = 0; Op < Op_Count; ++Op)
+    {
+        Histogram[Op] = Partial[0][Op] + Partial[1][Op] + Partial[2][Op] + Partial[3][Op];
+    }
+}
+
+static u32 FilterByOp(instruction_stream *Stream, operation_type Op, u32 *Indices)
+{
+    // NOTE: Writes the index of every instruction with the given Op to Indices, which must
+    // have room for Stream->Count entries, and returns how many there were.
+    u32 Result = 0;
+    for(u32 Index = 0; Index < Stream->Count; ++Index)
+    {
+        Indices[Result] = Index;
+        Result += (Stream->Op[Index] == Op);
+    }
+    
+    return Result;
+}
+
+static u32 FilterByOperandType(instruction_stream *Stream, operand_type Type, u32 *Indices)
+{
+    // NOTE: Like FilterByOp, but selects instructions with an operand of the given type in
+    // either slot, such as every instruction that touches memory.
+    u32 Result = 0;
+    for(u32 Index = 0; Index < Stream->Count; ++Index)
+    {
+        Indices[Result] = Index;
+        Result += (((Stream->OperandType[0][Index] & StreamOperand_TypeMask) == Type) |
+                   ((Stream->OperandType[1][Index] & StreamOperand_TypeMask) == Type));
+    }
+    
+    return Result;
+}
+
+static u64 SumSizes(instruction_stream *Stream)
+{
+    u64 Result = 0;
+    for(u32 Index = 0; Index < Stream->Count; ++Index)
+    {
+        Result += Stream->Size[Index];
+    }
+    
+    return Result;
+}
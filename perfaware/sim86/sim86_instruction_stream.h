@@ -0,0 +1,40 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+enum instruction_stream_operand_flag : u8
+{
+    // NOTE: OperandType holds the operand_type in the low bits and these flags above it.
+    StreamOperand_TypeMask = 0x3,
+    StreamOperand_RelativeJump = 0x10,
+};
+
+struct instruction_stream
+{
+    // NOTE: Decoded instructions stored one field per array, so that a pass over (say) every
+    // Op only touches a byte per instruction. OperandRegister uses the same encoding as
+    // packed_instruction: register index and High/Wide bits for registers, and one term
+    // index per nibble for memory (or PackedAddress_Intersegment, in which case Displacement
+    // is the offset and Immediate is the segment).
+    u32 Capacity;
+    u32 Count;
+    
+    u32 *Address;
+    u8 *Size;
+    u8 *Op;
+    u8 *Flags;
+    u8 *SegmentOverride;
+    
+    u8 *OperandType[2];
+    u8 *OperandRegister[2];
+    s32 *Displacement[2];
+    s32 *Immediate[2];
+};
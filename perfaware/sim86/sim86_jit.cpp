@@ -0,0 +1,912 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIM86_JIT 1
+#else
+#define SIM86_JIT 0
+#endif
+
+enum host_register : u32
+{
+    Host_rax, Host_rcx, Host_rdx, Host_rbx, Host_rsp, Host_rbp, Host_rsi, Host_rdi,
+    Host_r8, Host_r9, Host_r10, Host_r11, Host_r12, Host_r13, Host_r14, Host_r15,
+};
+
+// NOTE: Condition codes are the same on the 8086 and x86-64, so these are also the low
+// nibble of the 8086's own jcc opcodes.
+enum host_condition : u32
+{
+    Cond_O, Cond_NO, Cond_B, Cond_NB, Cond_E, Cond_NE, Cond_BE, Cond_A,
+    Cond_S, Cond_NS, Cond_P, Cond_NP, Cond_L, Cond_NL, Cond_LE, Cond_G,
+};
+
+// NOTE: In compiled code, rbx holds the cpu_8086, rbp the base of 8086 memory and rdx the
+// code granule counts from the block cache. rax and rcx are scratch. A zero means the
+// register is not held in a host register.
+static u8 const HostRegisterFor8086[Register_count] =
+{
+    0, // Register_none
+    Host_r8, Host_r11, Host_r9, Host_r10, // a, b, c, d
+    Host_r12, Host_r13, Host_r14, Host_r15, // sp, bp, si, di
+};
+
+enum jit_rm_type : u32
+{
+    JitRM_Register, // NOTE: A host register
+    JitRM_Guest, // NOTE: 8086 memory at [rbp + rax]
+    JitRM_Field, // NOTE: A field of the cpu_8086 at [rbx + offset]
+};
+struct jit_rm
+{
+    jit_rm_type Type;
+    u32 Value;
+};
+
+struct jit_instruction_info
+{
+    u16 WrittenFlags;
+    u16 HostFlags; // NOTE: The written flags the host instruction computes the 8086 way
+    u16 ReadFlags;
+    b32 MayExit;
+    b32 NeedsFlags;
+};
+
+struct jit_fixup
+{
+    u8 *Patch;
+    u32 InstructionIndex;
+};
+
+struct jit_emitter
+{
+    u8 *At;
+    u32 MemoryMask;
+    
+    u32 LoadedRegisters; // NOTE: One bit per register_mapping_8086
+    u32 StoredRegisters;
+    
+    u16 IPs[MaxBlockInstructionCount + 1];
+    
+    u32 FixupCount;
+    jit_fixup Fixups[4*MaxBlockInstructionCount];
+};
+
+static u32 RegisterField(u32 RegisterIndex)
+{
+    // NOTE: Registers is the first member of cpu_8086.
+    u32 Result = 2*RegisterIndex;
+    return Result;
+}
+
+static jit_rm HostRM(u32 Register)
+{
+    jit_rm Result = {JitRM_Register, Register};
+    return Result;
+}
+
+static jit_rm GuestRM(void)
+{
+    jit_rm Result = {JitRM_Guest, 0};
+    return Result;
+}
+
+static jit_rm FieldRM(u32 Offset)
+{
+    jit_rm Result = {JitRM_Field, Offset};
+    return Result;
+}
+
+static void GetJitOperands(instruction *Instruction, instruction_operand *Dest, instruction_operand *Source)
+{
+    // NOTE: The same normalization the interpreter does for one-register forms.
+    *Dest = Instruction->Operands[0];
+    *Source = Instruction->Operands[1];
+    if(Dest->Type == Operand_None)
+    {
+        *Dest = *Source;
+        *Source = {};
+    }
+}
+
+static b32 IsHostRegister(instruction_operand Operand, b32 Wide)
+{
+    b32 Result = ((Operand.Type == Operand_Register) &&
+                  (Operand.Register.Index < ArrayCount(HostRegisterFor8086)) &&
+                  HostRegisterFor8086[Operand.Register.Index] &&
+                  (Wide ? (Operand.Register.Count == 2) : ((Operand.Register.Count == 1) && (Operand.Register.Offset == 0))));
+    return Result;
+}
+
+static b32 IsSegmentRegister(instruction_operand Operand)
+{
+    b32 Result = ((Operand.Type == Operand_Register) &&
+                  (Operand.Register.Index >= Register_es) && (Operand.Register.Index <= Register_ds));
+    return Result;
+}
+
+static b32 IsGuestMemory(instruction_operand Operand)
+{
+    b32 Result = ((Operand.Type == Operand_Memory) && !(Operand.Address.Flags & Address_ExplicitSegment));
+    return Result;
+}
+
+static b32 IsGeneralForm(instruction_operand Dest, instruction_operand Source, b32 Wide)
+{
+    b32 DestOK = IsHostRegister(Dest, Wide) || IsGuestMemory(Dest);
+    b32 SourceOK = IsHostRegister(Source, Wide) || IsGuestMemory(Source) || (Source.Type == Operand_Immediate);
+    b32 Result = DestOK && SourceOK && !(IsGuestMemory(Dest) && IsGuestMemory(Source));
+    return Result;
+}
+
+static b32 GetJitInfo(instruction *Instruction, jit_instruction_info *Info)
+{
+    instruction_operand Dest, Source;
+    GetJitOperands(Instruction, &Dest, &Source);
+    b32 Wide = ((Instruction->Flags & Inst_Wide) != 0);
+    
+    *Info = {};
+    b32 Result = false;
+    switch(Instruction->Op)
+    {
+        case Op_mov:
+        {
+            if(IsSegmentRegister(Dest))
+            {
+                // NOTE: mov cs ends its block, and is left to the interpreter.
+                Result = (Dest.Register.Index != Register_cs) && IsHostRegister(Source, true);
+            }
+            else if(IsSegmentRegister(Source))
+            {
+                Result = IsHostRegister(Dest, true);
+            }
+            else
+            {
+                Result = IsGeneralForm(Dest, Source, Wide);
+            }
+        } break;
+        
+        case Op_add: case Op_adc: case Op_sub: case Op_sbb: case Op_cmp:
+        {
+            Result = IsGeneralForm(Dest, Source, Wide);
+            Info->WrittenFlags = Info->HostFlags = ArithmeticFlags8086;
+            if((Instruction->Op == Op_adc) || (Instruction->Op == Op_sbb))
+            {
+                Info->ReadFlags = Flag_Carry;
+            }
+        } break;
+        
+        case Op_and: case Op_or: case Op_xor: case Op_test:
+        {
+            // NOTE: The interpreter clears AF, which these leave undefined on the host.
+            Result = IsGeneralForm(Dest, Source, Wide);
+            Info->WrittenFlags = ArithmeticFlags8086;
+            Info->HostFlags = ArithmeticFlags8086 & ~Flag_AuxCarry;
+        } break;
+        
+        case Op_inc: case Op_dec: case Op_neg: case Op_not:
+        {
+            Result = (IsHostRegister(Dest, Wide) || IsGuestMemory(Dest)) && (Source.Type == Operand_None);
+            if((Instruction->Op == Op_inc) || (Instruction->Op == Op_dec))
+            {
+                Info->WrittenFlags = Info->HostFlags = ArithmeticFlags8086 & ~Flag_Carry;
+            }
+            else if(Instruction->Op == Op_neg)
+            {
+                Info->WrittenFlags = Info->HostFlags = ArithmeticFlags8086;
+            }
+        } break;
+        
+        case Op_lea:
+        {
+            Result = IsHostRegister(Dest, true) && IsGuestMemory(Source);
+        } break;
+        
+        case Op_je: case Op_jne: case Op_jl: case Op_jnl: case Op_jle: case Op_jg: case Op_jb: case Op_jnb:
+        case Op_jbe: case Op_ja: case Op_jp: case Op_jnp: case Op_jo: case Op_jno: case Op_js: case Op_jns:
+        {
+            Result = true;
+            Info->ReadFlags = ArithmeticFlags8086;
+        } break;
+        
+        case Op_jmp:
+        {
+            // NOTE: Only the relative forms. Far and indirect jumps go to the interpreter.
+            Result = (Dest.Type == Operand_Immediate);
+        } break;
+        
+        case Op_loop: case Op_loopz: case Op_loopnz: case Op_jcxz:
+        {
+            Result = true;
+            if(Instruction->Op != Op_loop)
+            {
+                Info->ReadFlags = Flag_Zero;
+            }
+        } break;
+        
+        default: {} break;
+    }
+    
+    Info->MayExit = IsGuestMemory(Dest) || IsGuestMemory(Source);
+    
+    return Result;
+}
+
+static void Emit8(jit_emitter *E, u32 Value)
+{
+    *E->At++ = (u8)Value;
+}
+
+static void Emit16(jit_emitter *E, u32 Value)
+{
+    u16 Value16 = (u16)Value;
+    memcpy(E->At, &Value16, sizeof(Value16));
+    E->At += sizeof(Value16);
+}
+
+static void Emit32(jit_emitter *E, u32 Value)
+{
+    memcpy(E->At, &Value, sizeof(Value));
+    E->At += sizeof(Value);
+}
+
+static void Emit64(jit_emitter *E, u64 Value)
+{
+    memcpy(E->At, &Value, sizeof(Value));
+    E->At += sizeof(Value);
+}
+
+static void EmitOp(jit_emitter *E, b32 Operand16, u32 Opcode, u32 RegField, jit_rm RM)
+{
+    // NOTE: Emits one instruction with a ModRM byte. Opcodes over 0xff are two bytes (0x0f
+    // and the second byte). Only r8-r15 are ever used as byte registers, and they always
+    // get a REX prefix, so spl-dil never come up.
+    u32 RMRegister = (RM.Type == JitRM_Register) ? RM.Value : 0;
+    if(Operand16)
+    {
+        Emit8(E, 0x66);
+    }
+    
+    u32 Rex = 0x40 | ((RegField >> 3) << 2) | (RMRegister >> 3);
+    if(Rex != 0x40)
+    {
+        Emit8(E, Rex);
+    }
+    
+    if(Opcode > 0xff)
+    {
+        Emit8(E, Opcode >> 8);
+    }
+    Emit8(E, Opcode & 0xff);
+    
+    u32 Reg = (RegField & 7) << 3;
+    switch(RM.Type)
+    {
+        case JitRM_Register:
+        {
+            Emit8(E, 0xc0 | Reg | (RM.Value & 7));
+        } break;
+        
+        case JitRM_Guest:
+        {
+            // NOTE: [rbp + rax*1 + 0]
+            Emit8(E, 0x44 | Reg);
+            Emit8(E, 0x05);
+            Emit8(E, 0x00);
+        } break;
+        
+        case JitRM_Field:
+        {
+            // NOTE: [rbx + disp32]
+            Emit8(E, 0x83 | Reg);
+            Emit32(E, RM.Value);
+        } break;
+    }
+}
+
+static u8 *EmitJcc(jit_emitter *E, host_condition Condition)
+{
+    Emit8(E, 0x0f);
+    Emit8(E, 0x80 | Condition);
+    u8 *Result = E->At;
+    Emit32(E, 0);
+    return Result;
+}
+
+static void PatchJump(u8 *Patch, u8 *Target)
+{
+    s32 Displacement = (s32)(Target - (Patch + 4));
+    memcpy(Patch, &Displacement, sizeof(Displacement));
+}
+
+static void EmitEarlyExit(jit_emitter *E, host_condition Condition, u32 InstructionIndex)
+{
+    // NOTE: An instruction has at most four ways out (two wraparound checks and two code
+    // checks), so the fixups cannot run out.
+    assert(E->FixupCount < ArrayCount(E->Fixups));
+    jit_fixup *Fixup = &E->Fixups[E->FixupCount++];
+    Fixup->Patch = EmitJcc(E, Condition);
+    Fixup->InstructionIndex = InstructionIndex;
+}
+
+static void EmitExit(jit_emitter *E, u16 IP, u32 InstructionIndex)
+{
+    EmitOp(E, true, 0xc7, 0, FieldRM(RegisterField(Register_ip)));
+    Emit16(E, IP);
+    
+    for(u32 RegisterIndex = Register_a; RegisterIndex <= Register_di; ++RegisterIndex)
+    {
+        if(E->StoredRegisters & (1 << RegisterIndex))
+        {
+            EmitOp(E, true, 0x89, HostRegisterFor8086[RegisterIndex], FieldRM(RegisterField(RegisterIndex)));
+        }
+    }
+    
+    Emit8(E, 0xb8); // NOTE: mov eax, InstructionIndex
+    Emit32(E, InstructionIndex);
+    
+#if _WIN32
+    Emit8(E, 0x5f); // NOTE: pop rdi
+    Emit8(E, 0x5e); // NOTE: pop rsi
+#endif
+    for(u32 Register = Host_r15; Register >= Host_r12; --Register)
+    {
+        Emit8(E, 0x41);
+        Emit8(E, 0x58 | (Register & 7));
+    }
+    Emit8(E, 0x5d); // NOTE: pop rbp
+    Emit8(E, 0x5b); // NOTE: pop rbx
+    Emit8(E, 0xc3); // NOTE: ret
+}
+
+static void EmitGuestOffset(jit_emitter *E, effective_address_expression Address)
+{
+    Emit8(E, 0xb8); // NOTE: mov eax, displacement
+    Emit32(E, (u16)Address.Displacement);
+    for(u32 TermIndex = 0; TermIndex < ArrayCount(Address.Terms); ++TermIndex)
+    {
+        u32 RegisterIndex = Address.Terms[TermIndex].Register.Index;
+        if(RegisterIndex)
+        {
+            EmitOp(E, false, 0x0fb7, Host_rcx, HostRM(HostRegisterFor8086[RegisterIndex])); // NOTE: movzx ecx, reg
+            Emit8(E, 0x01); // NOTE: add eax, ecx
+            Emit8(E, 0xc8);
+        }
+    }
+    
+    EmitOp(E, false, 0x0fb7, Host_rax, HostRM(Host_rax)); // NOTE: movzx eax, ax
+}
+
+static void EmitCodeCheck(jit_emitter *E, u32 Offset, u32 InstructionIndex)
+{
+    Emit8(E, 0x8d); // NOTE: lea ecx, [rax + Offset]
+    Emit8(E, 0x48);
+    Emit8(E, Offset);
+    Emit8(E, 0xc1); // NOTE: shr ecx, CodeGranuleShift
+    Emit8(E, 0xe9);
+    Emit8(E, CodeGranuleShift);
+    Emit8(E, 0x66); // NOTE: cmp word [rdx + rcx*2], 0
+    Emit8(E, 0x83);
+    Emit8(E, 0x3c);
+    Emit8(E, 0x4a);
+    Emit8(E, 0x00);
+    EmitEarlyExit(E, Cond_NE, InstructionIndex);
+}
+
+static void EmitGuestAddress(jit_emitter *E, instruction *Instruction, effective_address_expression Address,
+                             b32 Wide, b32 Write, u32 InstructionIndex)
+{
+    // NOTE: Leaves the absolute address in rax, or exits before the instruction if the
+    // access is one the interpreter has to do.
+    EmitGuestOffset(E, Address);
+    if(Wide)
+    {
+        Emit8(E, 0x3d); // NOTE: cmp eax, 0xffff
+        Emit32(E, 0xffff);
+        EmitEarlyExit(E, Cond_E, InstructionIndex);
+    }
+    
+    u32 Segment = Register_ds;
+    if(Instruction->Flags & Inst_Segment)
+    {
+        Segment = Instruction->SegmentOverride;
+    }
+    else if((Address.Terms[0].Register.Index == Register_bp) || (Address.Terms[1].Register.Index == Register_bp))
+    {
+        Segment = Register_ss;
+    }
+    
+    EmitOp(E, false, 0x0fb7, Host_rcx, FieldRM(RegisterField(Segment))); // NOTE: movzx ecx, segment
+    Emit8(E, 0xc1); // NOTE: shl ecx, 4
+    Emit8(E, 0xe1);
+    Emit8(E, 0x04);
+    Emit8(E, 0x01); // NOTE: add eax, ecx
+    Emit8(E, 0xc8);
+    Emit8(E, 0x25); // NOTE: and eax, MemoryMask
+    Emit32(E, E->MemoryMask);
+    if(Wide)
+    {
+        Emit8(E, 0x3d); // NOTE: cmp eax, MemoryMask
+        Emit32(E, E->MemoryMask);
+        EmitEarlyExit(E, Cond_E, InstructionIndex);
+    }
+    
+    if(Write)
+    {
+        EmitCodeCheck(E, 0, InstructionIndex);
+        if(Wide)
+        {
+            EmitCodeCheck(E, 1, InstructionIndex);
+        }
+    }
+}
+
+static jit_rm GetOperandRM(instruction_operand Operand)
+{
+    jit_rm Result = GuestRM();
+    if(Operand.Type == Operand_Register)
+    {
+        Result = HostRM(HostRegisterFor8086[Operand.Register.Index]);
+    }
+    
+    return Result;
+}
+
+static void EmitGeneralForm(jit_emitter *E, instruction *Instruction, u32 InstructionIndex,
+                            u32 RMRegOpcode, u32 RegRMOpcode, u32 ImmediateOpcode, u32 ImmediateField,
+                            b32 WritesDest, b32 ReadsCarry)
+{
+    // NOTE: RMRegOpcode is the "op r/m, reg" form, RegRMOpcode the "op reg, r/m" form, and
+    // ImmediateOpcode the "op r/m, imm" form, all for bytes (the word forms are one more).
+    instruction_operand Dest, Source;
+    GetJitOperands(Instruction, &Dest, &Source);
+    b32 Wide = ((Instruction->Flags & Inst_Wide) != 0);
+    u32 W = Wide ? 1 : 0;
+    
+    if(Dest.Type == Operand_Memory)
+    {
+        EmitGuestAddress(E, Instruction, Dest.Address, Wide, WritesDest, InstructionIndex);
+    }
+    else if(Source.Type == Operand_Memory)
+    {
+        EmitGuestAddress(E, Instruction, Source.Address, Wide, false, InstructionIndex);
+    }
+    
+    if(ReadsCarry)
+    {
+        EmitOp(E, true, 0x0fba, 4, FieldRM(RegisterField(Register_flags))); // NOTE: bt flags, 0
+        Emit8(E, 0);
+    }
+    
+    if(Source.Type == Operand_Immediate)
+    {
+        EmitOp(E, Wide, ImmediateOpcode + W, ImmediateField, GetOperandRM(Dest));
+        if(Wide)
+        {
+            Emit16(E, (u32)Source.Immediate.Value);
+        }
+        else
+        {
+            Emit8(E, (u32)Source.Immediate.Value);
+        }
+    }
+    else if(Source.Type == Operand_Register)
+    {
+        EmitOp(E, Wide, RMRegOpcode + W, HostRegisterFor8086[Source.Register.Index], GetOperandRM(Dest));
+    }
+    else
+    {
+        EmitOp(E, Wide, RegRMOpcode + W, HostRegisterFor8086[Dest.Register.Index], GuestRM());
+    }
+}
+
+static void EmitFlags(jit_emitter *E, jit_instruction_info *Info)
+{
+    Emit8(E, 0x9c); // NOTE: pushfq
+    Emit8(E, 0x58); // NOTE: pop rax
+    Emit8(E, 0x25); // NOTE: and eax, HostFlags
+    Emit32(E, Info->HostFlags);
+    EmitOp(E, true, 0x81, 4, FieldRM(RegisterField(Register_flags))); // NOTE: and flags, ~WrittenFlags
+    Emit16(E, (u16)~Info->WrittenFlags);
+    EmitOp(E, true, 0x09, Host_rax, FieldRM(RegisterField(Register_flags))); // NOTE: or flags, ax
+}
+
+static void EmitInstruction(jit_emitter *E, instruction *Instruction, u32 InstructionIndex)
+{
+    instruction_operand Dest, Source;
+    GetJitOperands(Instruction, &Dest, &Source);
+    b32 Wide = ((Instruction->Flags & Inst_Wide) != 0);
+    u32 W = Wide ? 1 : 0;
+    
+    switch(Instruction->Op)
+    {
+        case Op_mov:
+        {
+            if(IsSegmentRegister(Dest))
+            {
+                EmitOp(E, true, 0x89, HostRegisterFor8086[Source.Register.Index], FieldRM(RegisterField(Dest.Register.Index)));
+            }
+            else if(IsSegmentRegister(Source))
+            {
+                EmitOp(E, true, 0x8b, HostRegisterFor8086[Dest.Register.Index], FieldRM(RegisterField(Source.Register.Index)));
+            }
+            else
+            {
+                EmitGeneralForm(E, Instruction, InstructionIndex, 0x88, 0x8a, 0xc6, 0, true, false);
+            }
+        } break;
+        
+        case Op_add: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x00, 0x02, 0x80, 0, true, false);} break;
+        case Op_or:  {EmitGeneralForm(E, Instruction, InstructionIndex, 0x08, 0x0a, 0x80, 1, true, false);} break;
+        case Op_adc: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x10, 0x12, 0x80, 2, true, true);} break;
+        case Op_sbb: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x18, 0x1a, 0x80, 3, true, true);} break;
+        case Op_and: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x20, 0x22, 0x80, 4, true, false);} break;
+        case Op_sub: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x28, 0x2a, 0x80, 5, true, false);} break;
+        case Op_xor: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x30, 0x32, 0x80, 6, true, false);} break;
+        case Op_cmp: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x38, 0x3a, 0x80, 7, false, false);} break;
+        case Op_test: {EmitGeneralForm(E, Instruction, InstructionIndex, 0x84, 0x84, 0xf6, 0, false, false);} break;
+        
+        case Op_inc:
+        case Op_dec:
+        case Op_neg:
+        case Op_not:
+        {
+            if(Dest.Type == Operand_Memory)
+            {
+                EmitGuestAddress(E, Instruction, Dest.Address, Wide, true, InstructionIndex);
+            }
+            
+            u32 Opcode = 0xf6;
+            u32 Field = (Instruction->Op == Op_neg) ? 3 : 2;
+            if((Instruction->Op == Op_inc) || (Instruction->Op == Op_dec))
+            {
+                Opcode = 0xfe;
+                Field = (Instruction->Op == Op_inc) ? 0 : 1;
+            }
+            EmitOp(E, Wide, Opcode + W, Field, GetOperandRM(Dest));
+        } break;
+        
+        case Op_lea:
+        {
+            EmitGuestOffset(E, Source.Address);
+            EmitOp(E, true, 0x89, Host_rax, HostRM(HostRegisterFor8086[Dest.Register.Index])); // NOTE: mov reg, ax
+        } break;
+        
+        default: {} break;
+    }
+}
+
+static host_condition GetHostCondition(operation_type Op)
+{
+    host_condition Result = Cond_E;
+    switch(Op)
+    {
+        case Op_jo: {Result = Cond_O;} break;
+        case Op_jno: {Result = Cond_NO;} break;
+        case Op_jb: {Result = Cond_B;} break;
+        case Op_jnb: {Result = Cond_NB;} break;
+        case Op_je: {Result = Cond_E;} break;
+        case Op_jne: {Result = Cond_NE;} break;
+        case Op_jbe: {Result = Cond_BE;} break;
+        case Op_ja: {Result = Cond_A;} break;
+        case Op_js: {Result = Cond_S;} break;
+        case Op_jns: {Result = Cond_NS;} break;
+        case Op_jp: {Result = Cond_P;} break;
+        case Op_jnp: {Result = Cond_NP;} break;
+        case Op_jl: {Result = Cond_L;} break;
+        case Op_jnl: {Result = Cond_NL;} break;
+        case Op_jle: {Result = Cond_LE;} break;
+        case Op_jg: {Result = Cond_G;} break;
+        default: {} break;
+    }
+    
+    return Result;
+}
+
+static void EmitBlockEnd(jit_emitter *E, instruction *Instruction, u32 InstructionIndex)
+{
+    // NOTE: Every way out of the block leaves through an exit that stores ip and says that
+    // the whole block ran.
+    u32 Count = InstructionIndex + 1;
+    u16 Next = E->IPs[Count];
+    u16 Target = (u16)(Next + Instruction->Operands[0].Immediate.Value);
+    
+    u8 *NotTaken[2] = {};
+    switch(Instruction->Op)
+    {
+        case Op_jmp: {} break;
+        
+        case Op_loop:
+        case Op_loopz:
+        case Op_loopnz:
+        {
+            EmitOp(E, true, 0x83, 5, HostRM(Host_r9)); // NOTE: sub cx, 1
+            Emit8(E, 1);
+            NotTaken[0] = EmitJcc(E, Cond_E);
+            if(Instruction->Op != Op_loop)
+            {
+                EmitOp(E, true, 0xf7, 0, FieldRM(RegisterField(Register_flags))); // NOTE: test flags, ZF
+                Emit16(E, Flag_Zero);
+                NotTaken[1] = EmitJcc(E, (Instruction->Op == Op_loopz) ? Cond_E : Cond_NE);
+            }
+        } break;
+        
+        case Op_jcxz:
+        {
+            EmitOp(E, true, 0x85, Host_r9, HostRM(Host_r9)); // NOTE: test cx, cx
+            NotTaken[0] = EmitJcc(E, Cond_NE);
+        } break;
+        
+        default:
+        {
+            // NOTE: A conditional jump tests the 8086 flags directly, by loading them into
+            // the host's (only the arithmetic ones, so nothing else about the host changes).
+            EmitOp(E, false, 0x0fb7, Host_rax, FieldRM(RegisterField(Register_flags))); // NOTE: movzx eax, flags
+            Emit8(E, 0x25); // NOTE: and eax, ArithmeticFlags8086
+            Emit32(E, ArithmeticFlags8086);
+            Emit8(E, 0x50); // NOTE: push rax
+            Emit8(E, 0x9d); // NOTE: popfq
+            NotTaken[0] = EmitJcc(E, (host_condition)(GetHostCondition(Instruction->Op) ^ 1));
+        } break;
+    }
+    
+    EmitExit(E, Target, Count);
+    
+    if(NotTaken[0])
+    {
+        for(u32 PatchIndex = 0; PatchIndex < ArrayCount(NotTaken); ++PatchIndex)
+        {
+            if(NotTaken[PatchIndex])
+            {
+                PatchJump(NotTaken[PatchIndex], E->At);
+            }
+        }
+        EmitExit(E, Next, Count);
+    }
+}
+
+static void CompileBlock(jit *Jit, block_cache *Cache, cached_block *Block, segmented_access Memory)
+{
+    instruction *Instructions = Cache->Instructions + Block->FirstInstruction;
+    
+    // NOTE: Find how much of the block can be compiled, which registers it uses and which
+    // flags it has to store. Every early exit is treated as reading all the flags, since the
+    // interpreter takes over there.
+    jit_instruction_info Infos[MaxBlockInstructionCount];
+    u32 CompiledCount = 0;
+    b32 EndsWithJump = false;
+    u32 UsedRegisters = 0;
+    u32 WrittenRegisters = 0;
+    while(CompiledCount < Block->InstructionCount)
+    {
+        instruction *Instruction = &Instructions[CompiledCount];
+        if(!GetJitInfo(Instruction, &Infos[CompiledCount]))
+        {
+            break;
+        }
+        
+        instruction_operand Dest, Source;
+        GetJitOperands(Instruction, &Dest, &Source);
+        for(u32 OperandIndex = 0; OperandIndex < 2; ++OperandIndex)
+        {
+            instruction_operand Operand = OperandIndex ? Source : Dest;
+            if(Operand.Type == Operand_Register)
+            {
+                UsedRegisters |= (1 << Operand.Register.Index);
+            }
+            else if(Operand.Type == Operand_Memory)
+            {
+                UsedRegisters |= (1 << Operand.Address.Terms[0].Register.Index);
+                UsedRegisters |= (1 << Operand.Address.Terms[1].Register.Index);
+            }
+        }
+        
+        b32 WritesDest = ((Instruction->Op != Op_cmp) && (Instruction->Op != Op_test) && !EndsBlock(Instruction));
+        if(WritesDest && (Dest.Type == Operand_Register))
+        {
+            WrittenRegisters |= (1 << Dest.Register.Index);
+        }
+        
+        ++CompiledCount;
+        if(EndsBlock(Instruction))
+        {
+            EndsWithJump = true;
+            if((Instruction->Op == Op_loop) || (Instruction->Op == Op_loopz) ||
+               (Instruction->Op == Op_loopnz) || (Instruction->Op == Op_jcxz))
+            {
+                UsedRegisters |= (1 << Register_c);
+                WrittenRegisters |= (1 << Register_c);
+            }
+            break;
+        }
+    }
+    
+    u16 LiveFlags = ArithmeticFlags8086;
+    for(u32 InstructionIndex = CompiledCount; InstructionIndex-- > 0;)
+    {
+        jit_instruction_info *Info = &Infos[InstructionIndex];
+        Info->NeedsFlags = ((Info->WrittenFlags & LiveFlags) != 0);
+        LiveFlags = (u16)((LiveFlags & ~Info->WrittenFlags) | Info->ReadFlags);
+        if(Info->MayExit)
+        {
+            LiveFlags = ArithmeticFlags8086;
+        }
+    }
+    
+    if(CompiledCount == 0)
+    {
+        Block->NotCompilable = true;
+        ++Jit->Stats.BlocksNotCompilable;
+    }
+    else
+    {
+        if((Jit->CodeUsed + MaxCompiledBlockSize) > JitCodeSize)
+        {
+            // NOTE: Compiled code is thrown away all at once when the buffer fills up.
+            for(u32 SlotIndex = 0; SlotIndex < ArrayCount(Cache->Blocks); ++SlotIndex)
+            {
+                Cache->Blocks[SlotIndex].Compiled = 0;
+            }
+            Jit->CodeUsed = 0;
+            ++Jit->Stats.Flushes;
+        }
+        
+        jit_emitter *E = (jit_emitter *)calloc(1, sizeof(jit_emitter));
+        if(E)
+        {
+            u8 *Start = Jit->Code + Jit->CodeUsed;
+            E->At = Start;
+            E->MemoryMask = Memory.Mask;
+            E->LoadedRegisters = UsedRegisters & ~1;
+            E->StoredRegisters = WrittenRegisters & ~1;
+            
+            E->IPs[0] = (u16)Block->Key;
+            for(u32 InstructionIndex = 0; InstructionIndex < Block->InstructionCount; ++InstructionIndex)
+            {
+                E->IPs[InstructionIndex + 1] = (u16)(E->IPs[InstructionIndex] + Instructions[InstructionIndex].Size);
+            }
+            
+            Emit8(E, 0x53); // NOTE: push rbx
+            Emit8(E, 0x55); // NOTE: push rbp
+            for(u32 Register = Host_r12; Register <= Host_r15; ++Register)
+            {
+                Emit8(E, 0x41);
+                Emit8(E, 0x50 | (Register & 7));
+            }
+#if _WIN32
+            Emit8(E, 0x56); // NOTE: push rsi
+            Emit8(E, 0x57); // NOTE: push rdi
+            Emit8(E, 0x48); // NOTE: mov rbx, rcx
+            Emit8(E, 0x89);
+            Emit8(E, 0xcb);
+#else
+            Emit8(E, 0x48); // NOTE: mov rbx, rdi
+            Emit8(E, 0x89);
+            Emit8(E, 0xfb);
+#endif
+            Emit8(E, 0x48); // NOTE: mov rbp, Memory
+            Emit8(E, 0xbd);
+            Emit64(E, (u64)Memory.Memory);
+            Emit8(E, 0x48); // NOTE: mov rdx, CodeGranules
+            Emit8(E, 0xba);
+            Emit64(E, (u64)Cache->CodeGranules);
+            
+            for(u32 RegisterIndex = Register_a; RegisterIndex <= Register_di; ++RegisterIndex)
+            {
+                if(E->LoadedRegisters & (1 << RegisterIndex))
+                {
+                    EmitOp(E, true, 0x8b, HostRegisterFor8086[RegisterIndex], FieldRM(RegisterField(RegisterIndex)));
+                }
+            }
+            
+            for(u32 InstructionIndex = 0; InstructionIndex < CompiledCount; ++InstructionIndex)
+            {
+                instruction *Instruction = &Instructions[InstructionIndex];
+                if(EndsWithJump && (InstructionIndex == (CompiledCount - 1)))
+                {
+                    EmitBlockEnd(E, Instruction, InstructionIndex);
+                }
+                else
+                {
+                    EmitInstruction(E, Instruction, InstructionIndex);
+                    if(Infos[InstructionIndex].NeedsFlags)
+                    {
+                        EmitFlags(E, &Infos[InstructionIndex]);
+                    }
+                }
+            }
+            
+            if(!EndsWithJump)
+            {
+                EmitExit(E, E->IPs[CompiledCount], CompiledCount);
+            }
+            
+            u8 *ExitFor[MaxBlockInstructionCount] = {};
+            for(u32 FixupIndex = 0; FixupIndex < E->FixupCount; ++FixupIndex)
+            {
+                jit_fixup *Fixup = &E->Fixups[FixupIndex];
+                if(!ExitFor[Fixup->InstructionIndex])
+                {
+                    ExitFor[Fixup->InstructionIndex] = E->At;
+                    EmitExit(E, E->IPs[Fixup->InstructionIndex], Fixup->InstructionIndex);
+                }
+                PatchJump(Fixup->Patch, ExitFor[Fixup->InstructionIndex]);
+            }
+            
+            u32 CodeSize = (u32)(E->At - Start);
+            assert(CodeSize <= MaxCompiledBlockSize);
+            Jit->CodeUsed += (CodeSize + 15) & ~15;
+            Block->Compiled = (compiled_block *)(void *)Start;
+            
+            ++Jit->Stats.BlocksCompiled;
+            Jit->Stats.InstructionsCompiled += CompiledCount;
+            Jit->Stats.CodeBytes += CodeSize;
+            
+            free(E);
+        }
+    }
+}
+
+static b32 CreateJit(jit *Jit)
+{
+    *Jit = {};
+    if(SIM86_JIT)
+    {
+        Jit->Code = AllocateExecutableMemory(JitCodeSize);
+    }
+    
+    b32 Result = (Jit->Code != 0);
+    return Result;
+}
+
+static void DestroyJit(jit *Jit)
+{
+    FreeExecutableMemory(Jit->Code, JitCodeSize);
+    *Jit = {};
+}
+
+static u32 RunCompiledBlock(jit *Jit, block_cache *Cache, cached_block *Block, cpu_8086 *CPU)
+{
+    u32 Result = 0;
+    
+    if(SIM86_JIT && !Block->Compiled && !Block->NotCompilable)
+    {
+        if(++Block->ExecutionCount >= JitThreshold)
+        {
+            CompileBlock(Jit, Cache, Block, CPU->Memory);
+        }
+    }
+    
+    if(Block->Compiled)
+    {
+        Result = Block->Compiled(CPU);
+        CPU->InstructionCount += Result;
+        
+        ++Jit->Stats.Entries;
+        Jit->Stats.InstructionsRun += Result;
+        if(Result < Block->InstructionCount)
+        {
+            ++Jit->Stats.EarlyExits;
+        }
+    }
+    
+    return Result;
+}
+
+static void PrintJitStats(FILE *Dest, char const *FileName, jit_stats *Stats, u64 TotalInstructionCount)
+{
+    f64 NativePercent = TotalInstructionCount ? (100.0*(f64)Stats->InstructionsRun / (f64)TotalInstructionCount) : 0;
+    fprintf(Dest, "%s: jit %llu blocks (%llu instructions, %llu bytes) compiled, %llu not compilable, %llu flushes, "
+            "%llu entries, %llu early exits, %.2f%% of instructions run natively\n",
+            FileName, Stats->BlocksCompiled, Stats->InstructionsCompiled, Stats->CodeBytes, Stats->BlocksNotCompilable,
+            Stats->Flushes, Stats->Entries, Stats->EarlyExits, NativePercent);
+}
@@ -0,0 +1,54 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Translates hot blocks from the block cache into x86-64 code. Once a block has run
+   JitThreshold times through the interpreter, its decoded instructions are compiled into a
+   function that runs them natively, with the 8086's general registers held in r8-r15 for
+   the length of the block. Flags are computed by the host instructions themselves, and are
+   only copied back into the 8086 flags register where something could read them: a later
+   instruction in the block, a side exit, or the end of the block.
+   
+   Only the common instructions are compiled (mov, the ALU operations, inc/dec/neg/not, lea
+   and the relative jumps and loops that end a block). A block is compiled up to its first
+   instruction that is not, and the interpreter carries on from there. Compiled code also
+   leaves early, before touching anything, when a memory access would wrap around the end of
+   a segment or of memory, or would write to cached code, so the interpreter is always the
+   one that handles those. */
+
+static u32 const JitThreshold = 16;
+static u32 const JitCodeSize = 4*1024*1024;
+static u32 const MaxCompiledBlockSize = 32*1024;
+
+struct jit_stats
+{
+    u64 BlocksCompiled;
+    u64 BlocksNotCompilable;
+    u64 InstructionsCompiled;
+    u64 CodeBytes;
+    u64 Flushes;
+    
+    u64 Entries;
+    u64 EarlyExits; // NOTE: Left the block before its end, for the interpreter to finish
+    u64 InstructionsRun;
+};
+
+struct jit
+{
+    u8 *Code;
+    u32 CodeUsed;
+    jit_stats Stats;
+};
+
+static b32 CreateJit(jit *Jit);
+static void DestroyJit(jit *Jit);
+static u32 RunCompiledBlock(jit *Jit, block_cache *Cache, cached_block *Block, cpu_8086 *CPU);
+static void PrintJitStats(FILE *Dest, char const *FileName, jit_stats *Stats, u64 TotalInstructionCount);
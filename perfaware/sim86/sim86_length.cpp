@@ -0,0 +1,189 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Many callers only need to know where instructions start and stop. The length
+   decoder answers that without building any operands: the opcode byte selects an entry
+   that says how many bytes are always present and whether a ModRM byte follows, and the
+   ModRM byte selects how many displacement bytes there are (from the same ModRMTable8086
+   that FinishDecode uses). The tables are built from the same encoding shapes as the
+   decoders, so GetInstructionLength always agrees with the Size that DecodeInstruction
+   would produce. */
+
+static u8 GetFixedLengthEntry(encoding_shape *Shape, u32 Byte)
+{
+    u32 Result = Shape->ByteCount;
+    
+    if(Shape->Op == Op_lock || Shape->Op == Op_rep || Shape->Op == Op_segment)
+    {
+        Result |= Length_Prefix;
+    }
+    
+    // NOTE: The W and S bits are always in the opcode byte on the 8086, so the data width
+    // is known from the opcode alone.
+    assert(!Shape->PieceCount[Bits_W] || (Shape->Pieces[Bits_W][0].ByteIndex == 0));
+    assert(!Shape->PieceCount[Bits_S] || (Shape->Pieces[Bits_S][0].ByteIndex == 0));
+    
+    u8 Bytes[2] = {(u8)Byte, 0};
+    u32 W = Shape->ImplicitBits[Bits_W];
+    u32 S = Shape->ImplicitBits[Bits_S];
+    if(Shape->PieceCount[Bits_W])
+    {
+        encoding_field_piece Piece = Shape->Pieces[Bits_W][0];
+        W |= ((Bytes[Piece.ByteIndex] >> Piece.BitShift) & Piece.Mask);
+    }
+    if(Shape->PieceCount[Bits_S])
+    {
+        encoding_field_piece Piece = Shape->Pieces[Bits_S][0];
+        S |= ((Bytes[Piece.ByteIndex] >> Piece.BitShift) & Piece.Mask);
+    }
+    
+    if(Shape->Has[Bits_Data])
+    {
+        b32 DataIsW = (Shape->ImplicitBits[Bits_WMakesDataW] && !S && W);
+        Result += DataIsW ? 2 : 1;
+    }
+    
+    if(Shape->PieceCount[Bits_MOD])
+    {
+        // NOTE: A real ModRM byte, so the displacement depends on what it holds.
+        // NOTE: No 8086 encoding has an explicit displacement as well as a ModRM byte. If one
+        // did, its width would depend on both, and that is not something the table can encode.
+        Result |= Length_ModRM;
+        assert(!Shape->Has[Bits_Disp]);
+    }
+    else
+    {
+        // NOTE: MOD and RM are either implied by the encoding or absent (zero), so the
+        // displacement is the same every time. This matches FinishDecode.
+        modrm_entry ModRM = GetModRMEntry(Shape->ImplicitBits[Bits_MOD], Shape->ImplicitBits[Bits_RM]);
+        if(Shape->Has[Bits_Disp] || ModRM.DisplacementByteCount)
+        {
+            b32 DisplacementIsW = (Shape->ImplicitBits[Bits_DispAlwaysW] || (ModRM.DisplacementByteCount == 2));
+            Result += DisplacementIsW ? 2 : 1;
+        }
+    }
+    
+    assert((Result & Length_FixedMask) <= 6);
+    return (u8)Result;
+}
+
+static instruction_length_table BuildInstructionLengthTable(instruction_table Table)
+{
+    instruction_length_table Result = {};
+    
+    for(u32 Byte = 0; Byte < ArrayCount(Result.Opcode); ++Byte)
+    {
+        encoding_shape Candidates[16];
+        u32 CandidateCount = 0;
+        b32 NeedsGroup = false;
+        
+        for(u32 Index = 0; Index < Table.EncodingCount; ++Index)
+        {
+            encoding_shape Shape = GetEncodingShape(Table.Encodings[Index]);
+            if((Byte & Shape.LiteralMask[0]) == Shape.LiteralValue[0])
+            {
+                assert(CandidateCount < ArrayCount(Candidates));
+                Candidates[CandidateCount++] = Shape;
+                NeedsGroup = NeedsGroup || (Shape.LiteralMask[1] != 0);
+            }
+        }
+        
+        if(CandidateCount == 1 && !NeedsGroup)
+        {
+            Result.Opcode[Byte] = GetFixedLengthEntry(&Candidates[0], Byte);
+        }
+        else if(CandidateCount)
+        {
+            assert(Result.GroupCount < ArrayCount(Result.Groups));
+            u32 GroupIndex = Result.GroupCount++;
+            instruction_length_group *Group = &Result.Groups[GroupIndex];
+            
+            u8 const RegMask = 0x38;
+            Group->ModRMMask = Candidates[0].LiteralMask[1] & ~RegMask;
+            Group->ModRMValue = Candidates[0].LiteralValue[1] & ~RegMask;
+            
+            for(u32 CandidateIndex = 0; CandidateIndex < CandidateCount; ++CandidateIndex)
+            {
+                encoding_shape *Shape = &Candidates[CandidateIndex];
+                
+                // NOTE: If this fires, an opcode has forms that differ in something other
+                // than the REG field, and the group would need a different key.
+                assert((Shape->LiteralMask[1] & ~RegMask) == Group->ModRMMask);
+                assert((Shape->LiteralValue[1] & ~RegMask) == Group->ModRMValue);
+                
+                for(u32 Reg = 0; Reg < ArrayCount(Group->Entries); ++Reg)
+                {
+                    u8 RegBits = (u8)(Reg << 3);
+                    if((RegBits & Shape->LiteralMask[1] & RegMask) == (Shape->LiteralValue[1] & RegMask))
+                    {
+                        assert(Group->Entries[Reg] == 0);
+                        Group->Entries[Reg] = GetFixedLengthEntry(Shape, Byte);
+                    }
+                }
+            }
+            
+            Result.Opcode[Byte] = (u8)(Length_Group | GroupIndex);
+        }
+    }
+    
+    return Result;
+}
+
+static instruction_length_table *Get8086InstructionLengthTable(void)
+{
+    static instruction_length_table LengthTable = BuildInstructionLengthTable(Get8086InstructionTable());
+    return &LengthTable;
+}
+
+static u32 GetInstructionLength(instruction_length_table *Table, u8 *Source)
+{
+    // NOTE: Source must have 16 readable bytes. Like DecodeInstruction, prefixes count
+    // towards the 15 byte limit, and 0 is returned for anything that does not decode.
+    u32 const MaxInstructionByteCount = 15;
+    
+    u32 TotalSize = 0;
+    b32 Valid = true;
+    while(Valid && (TotalSize < MaxInstructionByteCount))
+    {
+        u8 Entry = Table->Opcode[Source[TotalSize]];
+        u8 ModRM = Source[TotalSize + 1];
+        if(Entry & Length_Group)
+        {
+            instruction_length_group *Group = &Table->Groups[Entry & ~Length_Group];
+            Entry = 0;
+            if((ModRM & Group->ModRMMask) == Group->ModRMValue)
+            {
+                Entry = Group->Entries[(ModRM >> 3) & 0x7];
+            }
+        }
+        
+        Valid = (Entry != 0);
+        TotalSize += (Entry & Length_FixedMask);
+        if(Entry & Length_ModRM)
+        {
+            TotalSize += ModRMTable8086.Entries[ModRM].DisplacementByteCount;
+        }
+        
+        if(!(Entry & Length_Prefix))
+        {
+            break;
+        }
+    }
+    
+    u32 Result = 0;
+    if(Valid && (TotalSize <= MaxInstructionByteCount))
+    {
+        Result = TotalSize;
+    }
+    
+    return Result;
+}
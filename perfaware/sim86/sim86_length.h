@@ -0,0 +1,40 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+enum instruction_length_entry : u8
+{
+    // NOTE: An entry of 0 means the byte does not start any instruction. Otherwise the low
+    // four bits are the number of bytes that are always present (opcode bytes, fixed
+    // displacement, and data), and the high bits say what else to look at.
+    Length_FixedMask = 0xf,
+    Length_ModRM = 0x10, // NOTE: Add the displacement implied by the ModRM byte that follows
+    Length_Prefix = 0x20, // NOTE: This is a lock/rep/segment prefix, keep going
+    Length_Group = 0x80, // NOTE: The low bits select a group, which is indexed by the REG field of the next byte
+};
+
+struct instruction_length_group
+{
+    u8 ModRMMask; // NOTE: Bits outside the REG field that must match in the next byte
+    u8 ModRMValue;
+    u8 Entries[8];
+};
+
+struct instruction_length_table
+{
+    u8 Opcode[256];
+    
+    u32 GroupCount;
+    instruction_length_group Groups[32];
+};
+
+static instruction_length_table *Get8086InstructionLengthTable(void);
+static u32 GetInstructionLength(instruction_length_table *Table, u8 *Source);
@@ -13,21 +13,103 @@
 #include <assert.h>
 #include <memory.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "sim86.h"
 
+// NOTE: The library hands out mnemonic and register names, but never formats text.
+#define SIM86_TEXT_FORMATTING 0
+#define SIM86_MEMORY_IMAGE 0
+
 #include "sim86_instruction.h"
 #include "sim86_instruction_table.h"
 #include "sim86_memory.h"
+#include "sim86_profiler.h"
 #include "sim86_decode.h"
+#include "sim86_length.h"
+#include "sim86_packed.h"
+#include "sim86_instruction_stream.h"
 #include "sim86_text.h"
 
 #include "sim86_instruction.cpp"
 #include "sim86_instruction_table.cpp"
 #include "sim86_memory.cpp"
 #include "sim86_decode.cpp"
+#include "sim86_length.cpp"
+#include "sim86_packed.cpp"
+#include "sim86_instruction_stream.cpp"
 #include "sim86_text.cpp"
 
+static char const *GetMnemonic(operation_type Op)
+{
+    char const *Result = "";
+    if(Op < Op_Count)
+    {
+        Result = OpcodeMnemonics[Op];
+    }
+    
+    return Result;
+}
+
+static u32 DecodeInstructionBuffer(instruction_table Table, u32 SourceSize, u8 *Source,
+                                   u32 MaxCount, instruction *Dest, u32 *BytesConsumed)
+{
+    // NOTE: Decodes until the buffer or Dest runs out, or until an instruction does not
+    // decode or extends past the end of the buffer. BytesConsumed is the offset of the
+    // first instruction that was not written, and each Address is its offset in Source.
+    u32 Count = 0;
+    u32 Offset = 0;
+    while((Count < MaxCount) && (Offset < SourceSize))
+    {
+        u32 Remaining = SourceSize - Offset;
+        instruction Instruction = DecodeInstructionFromBuffer(Table, Remaining, Source + Offset);
+        if(!Instruction.Op || (Instruction.Size > Remaining))
+        {
+            break;
+        }
+        
+        Instruction.Address = Offset;
+        Dest[Count++] = Instruction;
+        Offset += Instruction.Size;
+    }
+    
+    *BytesConsumed = Offset;
+    return Count;
+}
+
+static u32 DecodeInstructionBufferPacked(instruction_table Table, u32 SourceSize, u8 *Source,
+                                         u32 MaxCount, packed_instruction *Dest, u32 *BytesConsumed)
+{
+    // NOTE: Identical to DecodeInstructionBuffer, except that instructions are compressed as
+    // they are decoded, so the full instructions never have to be stored anywhere.
+    u32 Count = 0;
+    u32 Offset = 0;
+    while((Count < MaxCount) && (Offset < SourceSize))
+    {
+        u32 Remaining = SourceSize - Offset;
+        instruction Instruction = DecodeInstructionFromBuffer(Table, Remaining, Source + Offset);
+        if(!Instruction.Op || (Instruction.Size > Remaining))
+        {
+            break;
+        }
+        
+        Instruction.Address = Offset;
+        if(!CompressInstruction(Instruction, &Dest[Count]))
+        {
+            // NOTE: Everything the decoder produces should pack, so this means either the
+            // decoder or the packed format has changed without the other.
+            assert(!"Decoded instruction does not fit in a packed_instruction");
+            break;
+        }
+        
+        ++Count;
+        Offset += Instruction.Size;
+    }
+    
+    *BytesConsumed = Offset;
+    return Count;
+}
+
 extern "C" u32 Sim86_GetVersion(void)
 {
     u32 Result = SIM86_VERSION;
@@ -37,24 +119,105 @@ extern "C" u32 Sim86_GetVersion(void)
 extern "C" void Sim86_Decode8086Instruction(u32 SourceSize, u8 *Source, instruction *Dest)
 {
     instruction_table Table = Get8086InstructionTable();
-    
-    // NOTE(casey): The 8086 decoder requires the ability to read up to 15 bytes (the maximum
-    // allowable instruction size)
-    assert(Table.MaxInstructionByteCount == 15);
+    *Dest = DecodeInstructionFromBuffer(Table, SourceSize, Source);
+}
+
+extern "C" void Sim86_DecodeBuffer(u32 SourceSize, u8 *Source, u32 MaxCount, instruction *Dest,
+                                   u32 *OutCount, u32 *OutBytesConsumed)
+{
+    // NOTE: If *OutBytesConsumed is less than SourceSize and *OutCount is less than MaxCount,
+    // the instruction at *OutBytesConsumed either did not decode or is cut off by the end
+    // of the buffer.
+    instruction_table Table = Get8086InstructionTable();
+    *OutCount = DecodeInstructionBuffer(Table, SourceSize, Source, MaxCount, Dest, OutBytesConsumed);
+}
+
+extern "C" void Sim86_DecodeBufferPacked(u32 SourceSize, u8 *Source, u32 MaxCount, packed_instruction *Dest,
+                                         u32 *OutCount, u32 *OutBytesConsumed)
+{
+    instruction_table Table = Get8086InstructionTable();
+    *OutCount = DecodeInstructionBufferPacked(Table, SourceSize, Source, MaxCount, Dest, OutBytesConsumed);
+}
+
+extern "C" u64 Sim86_GetInstructionStreamBytes(u32 Capacity)
+{
+    u64 Result = GetInstructionStreamBytes(Capacity);
+    return Result;
+}
+
+extern "C" void Sim86_InstructionStreamFromMemory(u32 Capacity, void *Memory, instruction_stream *Dest)
+{
+    *Dest = InstructionStreamFromMemory(Capacity, Memory);
+}
+
+extern "C" void Sim86_DecodeBufferToStream(u32 SourceSize, u8 *Source, instruction_stream *Stream,
+                                           u32 *OutCount, u32 *OutBytesConsumed)
+{
+    // NOTE: Appends to Stream, so a large image can be decoded in several calls as long as
+    // the caller rebases the Address of each batch.
+    instruction_table Table = Get8086InstructionTable();
+    *OutCount = DecodeInstructionBufferToStream(Table, SourceSize, Source, Stream, OutBytesConsumed);
+}
+
+extern "C" void Sim86_GetStreamInstruction(instruction_stream *Stream, u32 Index, instruction *Dest)
+{
+    *Dest = GetStreamInstruction(Stream, Index);
+}
+
+extern "C" void Sim86_CountOps(instruction_stream *Stream, u32 *Histogram)
+{
+    // NOTE: Histogram must have Op_Count entries.
+    CountOps(Stream, Histogram);
+}
+
+extern "C" u32 Sim86_FilterByOp(instruction_stream *Stream, operation_type Op, u32 *Indices)
+{
+    // NOTE: Indices must have room for Stream->Count entries.
+    u32 Result = FilterByOp(Stream, Op, Indices);
+    return Result;
+}
+
+extern "C" u32 Sim86_FilterByOperandType(instruction_stream *Stream, operand_type Type, u32 *Indices)
+{
+    u32 Result = FilterByOperandType(Stream, Type, Indices);
+    return Result;
+}
+
+extern "C" u64 Sim86_SumSizes(instruction_stream *Stream)
+{
+    u64 Result = SumSizes(Stream);
+    return Result;
+}
+
+extern "C" u32 Sim86_CompressInstruction(instruction *Source, packed_instruction *Dest)
+{
+    u32 Result = CompressInstruction(*Source, Dest);
+    return Result;
+}
+
+extern "C" void Sim86_ExpandInstruction(packed_instruction *Source, instruction *Dest)
+{
+    *Dest = ExpandInstruction(*Source);
+}
+
+extern "C" u32 Sim86_GetInstructionLength(u32 SourceSize, u8 *Source)
+{
+    // NOTE: The length decoder looks at up to 16 bytes (a 15 byte instruction plus the
+    // ModRM lookahead), so short sources get the same zeroed guard buffer as above.
     u8 GuardBuffer[16] = {};
-    if(SourceSize < Table.MaxInstructionByteCount)
+    if(SourceSize < sizeof(GuardBuffer))
     {
         memcpy(GuardBuffer, Source, SourceSize);
         Source = GuardBuffer;
     }
     
-    segmented_access At = FixedMemoryPow2(4, Source);
-    *Dest = DecodeInstruction(Table, At);
+    u32 Result = GetInstructionLength(Get8086InstructionLengthTable(), Source);
+    return Result;
 }
 
 extern "C" char const *Sim86_RegisterNameFromOperand(register_access *RegAccess)
 {
-    char const *Result = GetRegName(*RegAccess);
+    char const *Result = GetRegNameSpan(*RegAccess).Data;
     return Result;
 }
 
@@ -13,9 +13,27 @@
 #include "sim86.h"
 #include "sim86_instruction.h"
 #include "sim86_instruction_table.h"
+#include "sim86_packed.h"
+#include "sim86_instruction_stream.h"
 
 extern "C" u32 Sim86_GetVersion(void);
 extern "C" void Sim86_Decode8086Instruction(u32 SourceSize, u8 *Source, instruction *Dest);
+extern "C" void Sim86_DecodeBuffer(u32 SourceSize, u8 *Source, u32 MaxCount, instruction *Dest,
+                                   u32 *OutCount, u32 *OutBytesConsumed);
+extern "C" void Sim86_DecodeBufferPacked(u32 SourceSize, u8 *Source, u32 MaxCount, packed_instruction *Dest,
+                                         u32 *OutCount, u32 *OutBytesConsumed);
+extern "C" u64 Sim86_GetInstructionStreamBytes(u32 Capacity);
+extern "C" void Sim86_InstructionStreamFromMemory(u32 Capacity, void *Memory, instruction_stream *Dest);
+extern "C" void Sim86_DecodeBufferToStream(u32 SourceSize, u8 *Source, instruction_stream *Stream,
+                                           u32 *OutCount, u32 *OutBytesConsumed);
+extern "C" void Sim86_GetStreamInstruction(instruction_stream *Stream, u32 Index, instruction *Dest);
+extern "C" void Sim86_CountOps(instruction_stream *Stream, u32 *Histogram);
+extern "C" u32 Sim86_FilterByOp(instruction_stream *Stream, operation_type Op, u32 *Indices);
+extern "C" u32 Sim86_FilterByOperandType(instruction_stream *Stream, operand_type Type, u32 *Indices);
+extern "C" u64 Sim86_SumSizes(instruction_stream *Stream);
+extern "C" u32 Sim86_CompressInstruction(instruction *Source, packed_instruction *Dest);
+extern "C" void Sim86_ExpandInstruction(packed_instruction *Source, instruction *Dest);
+extern "C" u32 Sim86_GetInstructionLength(u32 SourceSize, u8 *Source);
 extern "C" char const *Sim86_RegisterNameFromOperand(register_access *RegAccess);
 extern "C" char const *Sim86_MnemonicFromOperationType(operation_type Type);
 extern "C" void Sim86_Get8086InstructionTable(instruction_table *Dest);
\ No newline at end of file
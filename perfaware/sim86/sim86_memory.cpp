@@ -10,12 +10,6 @@
    
    ======================================================================== */
 
-static u32 GetHighestAddress(segmented_access SegMem)
-{
-    u32 Result = SegMem.Mask;
-    return Result;
-}
-
 static u32 GetAbsoluteAddressOf(u32 Mask, u16 SegmentBase, u16 SegmentOffset, u16 AdditionalOffset)
 {
     u32 Result = (((u32)SegmentBase << 4) + (u32)(SegmentOffset + AdditionalOffset)) & Mask;
@@ -28,6 +22,50 @@ static u32 GetAbsoluteAddressOf(segmented_access SegMem, u16 Offset)
     return Result;
 }
 
+static u8 *GetLinearWindow(segmented_access SegMem, u32 Size, u8 *Scratch)
+{
+    // NOTE: Returns Size bytes starting at SegMem that can be read as a plain array. Almost
+    // always that is memory itself, but if stepping through them would wrap the segment
+    // offset or the end of memory, they are copied into Scratch (which must hold Size
+    // bytes) with the same wraparound GetAbsoluteAddressOf applies.
+    u8 *Result = 0;
+    
+    u32 AbsAddr = GetAbsoluteAddressOf(SegMem);
+    if(((SegMem.SegmentOffset + Size) <= 0x10000) && ((AbsAddr + Size - 1) <= SegMem.Mask))
+    {
+        Result = SegMem.Memory + AbsAddr;
+    }
+    else
+    {
+        for(u32 Index = 0; Index < Size; ++Index)
+        {
+            u16 Offset = (u16)(SegMem.SegmentOffset + Index);
+            Scratch[Index] = SegMem.Memory[GetAbsoluteAddressOf(SegMem.Mask, SegMem.SegmentBase, Offset, 0)];
+        }
+        Result = Scratch;
+    }
+    
+    return Result;
+}
+
+static segmented_access FixedMemoryPow2(u32 SizePow2, u8 *Memory)
+{
+    segmented_access Result = {};
+    
+    Result.Memory = Memory;
+    Result.Mask = (1 << SizePow2) - 1;
+    
+    return Result;
+}
+
+#if SIM86_MEMORY_IMAGE
+
+static u32 GetHighestAddress(segmented_access SegMem)
+{
+    u32 Result = SegMem.Mask;
+    return Result;
+}
+
 static segmented_access MoveBaseBy(segmented_access Access, s32 Offset)
 {
     Access.SegmentOffset += Offset;
@@ -42,25 +80,10 @@ static segmented_access MoveBaseBy(segmented_access Access, s32 Offset)
     return Result;
 }
 
-static u8 *AccessMemory(segmented_access SegMem, u16 Offset)
-{
-    u32 AbsAddr = GetAbsoluteAddressOf(SegMem, Offset);
-    u8 *Result = SegMem.Memory + AbsAddr;
-    return Result;
-}
-
 static b32 IsValid(segmented_access SegMem)
 {
     b32 Result = (SegMem.Mask != 0);
     return Result;
 }
 
-static segmented_access FixedMemoryPow2(u32 SizePow2, u8 *Memory)
-{
-    segmented_access Result = {};
-    
-    Result.Memory = Memory;
-    Result.Mask = (1 << SizePow2) - 1;
-    
-    return Result;
-}
+#endif
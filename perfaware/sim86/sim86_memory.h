@@ -18,11 +18,20 @@ struct segmented_access
     u16 SegmentOffset;
 };
 
-static u32 GetHighestAddress(segmented_access SegMem);
-static u32 GetAbsoluteAddressOf(segmented_access SegMem, u16 Offset = 0);
-static segmented_access MoveBaseBy(segmented_access Access, s32 Offset);
+/* NOTE: Programs that only decode from buffers of their own (sim86_lib, sim86_corpus) build
+   with SIM86_MEMORY_IMAGE=0, which leaves out the helpers for managing and walking a
+   loaded 8086 memory image. */
 
-static u8 *AccessMemory(segmented_access SegMem, u16 Offset = 0);
+#ifndef SIM86_MEMORY_IMAGE
+#define SIM86_MEMORY_IMAGE 1
+#endif
 
-static b32 IsValid(segmented_access SegMem);
+static u32 GetAbsoluteAddressOf(segmented_access SegMem, u16 Offset = 0);
+static u8 *GetLinearWindow(segmented_access SegMem, u32 Size, u8 *Scratch);
 static segmented_access FixedMemoryPow2(u32 SizePow2, u8 *Memory);
+
+#if SIM86_MEMORY_IMAGE
+static u32 GetHighestAddress(segmented_access SegMem);
+static segmented_access MoveBaseBy(segmented_access Access, s32 Offset);
+static b32 IsValid(segmented_access SegMem);
+#endif
@@ -0,0 +1,168 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: An instruction is around 100 bytes, almost all of it in the two operand unions,
+   but nothing the 8086 decoder produces needs more than 16. Registers fit in four bits,
+   displacements in sixteen, and immediates in sixteen plus a sign (sign-extended bytes
+   are negative, while 16 bit data is not), so a decoded image can be kept packed and only
+   expanded when an instruction is actually looked at.
+   
+   CompressInstruction does not try to enumerate which instructions fit. It packs the fields,
+   expands the result again, and only succeeds if that reproduces the source exactly, so
+   anything that would not survive the round trip is rejected rather than mangled. */
+
+static_assert(sizeof(packed_instruction) == 16, "packed_instruction should stay at 16 bytes");
+
+static void CompressOperand(instruction_operand Operand, u32 OperandIndex, packed_instruction *Dest)
+{
+    u8 Register = 0;
+    u16 Value = 0;
+    switch(Operand.Type)
+    {
+        case Operand_None: {} break;
+        
+        case Operand_Register:
+        {
+            register_access Reg = Operand.Register;
+            Register = (u8)((Reg.Index & PackedRegister_IndexMask) |
+                            (Reg.Offset ? PackedRegister_High : 0) |
+                            ((Reg.Count == 2) ? PackedRegister_Wide : 0));
+        } break;
+        
+        case Operand_Memory:
+        {
+            effective_address_expression Address = Operand.Address;
+            if(Address.Flags & Address_ExplicitSegment)
+            {
+                Register = PackedAddress_Intersegment;
+                Value = (u16)Address.Displacement;
+                Dest->OperandValues[1] = (u16)Address.ExplicitSegment;
+            }
+            else
+            {
+                Register = (u8)((Address.Terms[0].Register.Index & 0xf) | (Address.Terms[1].Register.Index << 4));
+                Value = (u16)Address.Displacement;
+            }
+        } break;
+        
+        case Operand_Immediate:
+        {
+            immediate Immediate = Operand.Immediate;
+            Value = (u16)Immediate.Value;
+            if(Immediate.Flags & Immediate_RelativeJumpDisplacement)
+            {
+                Dest->OperandTypes |= (PackedOperand_RelativeJump0 << OperandIndex);
+            }
+            if(Immediate.Value < 0)
+            {
+                Dest->OperandTypes |= (PackedOperand_Negative0 << OperandIndex);
+            }
+        } break;
+    }
+    
+    Dest->OperandTypes |= (u8)((Operand.Type & PackedOperand_TypeMask) << (2*OperandIndex));
+    Dest->OperandRegisters[OperandIndex] = Register;
+    if(Operand.Type != Operand_None)
+    {
+        Dest->OperandValues[OperandIndex] = Value;
+    }
+}
+
+static instruction_operand ExpandOperand(packed_instruction Source, u32 OperandIndex)
+{
+    instruction_operand Result = {};
+    
+    u8 Register = Source.OperandRegisters[OperandIndex];
+    u16 Value = Source.OperandValues[OperandIndex];
+    switch((Source.OperandTypes >> (2*OperandIndex)) & PackedOperand_TypeMask)
+    {
+        case Operand_Register:
+        {
+            Result.Type = Operand_Register;
+            Result.Register = RegisterAccess(Register & PackedRegister_IndexMask,
+                                             (Register & PackedRegister_High) ? 1 : 0,
+                                             (Register & PackedRegister_Wide) ? 2 : 1);
+        } break;
+        
+        case Operand_Memory:
+        {
+            if(Register == PackedAddress_Intersegment)
+            {
+                Result = IntersegmentAddressOperand(Source.OperandValues[1], Value);
+            }
+            else
+            {
+                Result = EffectiveAddressOperand(RegisterAccess(Register & 0xf, 0, 2), RegisterAccess(Register >> 4, 0, 2),
+                                                 (s16)Value);
+            }
+        } break;
+        
+        case Operand_Immediate:
+        {
+            u32 Flags = (Source.OperandTypes & (PackedOperand_RelativeJump0 << OperandIndex)) ? (u32)Immediate_RelativeJumpDisplacement : (u32)0;
+            u32 ImmediateValue = Value;
+            if(Source.OperandTypes & (PackedOperand_Negative0 << OperandIndex))
+            {
+                ImmediateValue |= 0xffff0000;
+            }
+            Result = ImmediateOperand(ImmediateValue, Flags);
+        } break;
+    }
+    
+    return Result;
+}
+
+static instruction ExpandInstruction(packed_instruction Source)
+{
+    instruction Result = {};
+    
+    Result.Address = Source.Address;
+    Result.Size = (Source.SizeAndSegment & 0xf);
+    Result.Op = (operation_type)Source.Op;
+    Result.Flags = Source.Flags;
+    Result.Operands[0] = ExpandOperand(Source, 0);
+    Result.Operands[1] = ExpandOperand(Source, 1);
+    Result.SegmentOverride = (Source.SizeAndSegment >> 4);
+    
+    return Result;
+}
+
+static packed_instruction PackInstruction(instruction Source)
+{
+    // NOTE: This does not check that Source survives the trip, so it is only for
+    // instructions that just came out of the decoder. Anything else goes through
+    // CompressInstruction.
+    packed_instruction Result = {};
+    
+    Result.Address = Source.Address;
+    Result.Op = (u8)Source.Op;
+    Result.SizeAndSegment = (u8)((Source.Size & 0xf) | (Source.SegmentOverride << 4));
+    Result.Flags = (u8)Source.Flags;
+    CompressOperand(Source.Operands[0], 0, &Result);
+    CompressOperand(Source.Operands[1], 1, &Result);
+    
+    return Result;
+}
+
+static b32 CompressInstruction(instruction Source, packed_instruction *Dest)
+{
+    packed_instruction Packed = PackInstruction(Source);
+    
+    instruction Check = ExpandInstruction(Packed);
+    b32 Result = (memcmp(&Check, &Source, sizeof(Source)) == 0);
+    if(Result)
+    {
+        *Dest = Packed;
+    }
+    
+    return Result;
+}
@@ -0,0 +1,46 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+enum packed_operand_flag : u8
+{
+    // NOTE: The low four bits of OperandTypes hold the operand_type of each operand, two
+    // bits apiece. The high four bits are flags for immediates.
+    PackedOperand_TypeMask = 0x3,
+    PackedOperand_RelativeJump0 = 0x10,
+    PackedOperand_RelativeJump1 = 0x20,
+    PackedOperand_Negative0 = 0x40,
+    PackedOperand_Negative1 = 0x80,
+};
+
+enum packed_register_flag : u8
+{
+    // NOTE: For register operands, OperandRegisters holds the register index in the low four
+    // bits and these flags above it. For memory operands, it holds the register index of
+    // each term, four bits apiece, or PackedAddress_Intersegment for a segment:offset pair.
+    PackedRegister_IndexMask = 0xf,
+    PackedRegister_High = 0x10,
+    PackedRegister_Wide = 0x20,
+    
+    PackedAddress_Intersegment = 0xff,
+};
+
+struct packed_instruction
+{
+    u32 Address;
+    u8 Op;
+    u8 SizeAndSegment; // NOTE: Size in the low four bits, SegmentOverride in the high four
+    u8 Flags;
+    u8 OperandTypes;
+    u8 OperandRegisters[2];
+    u16 OperandValues[2]; // NOTE: Displacement or immediate, or for a segment:offset pair, offset then segment
+    u16 Reserved;
+};
@@ -0,0 +1,286 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Instruction boundaries depend on every instruction before them, so the image is split
+   into chunks and each chunk is first decoded speculatively, as if an instruction started
+   at the first byte of the chunk. 8086 code falls back into step with the real instruction
+   stream within a few instructions of a wrong guess. Once the real entry point of a chunk
+   is known (from where the previous chunk's real stream left off), only the instructions
+   up to the first offset the speculative pass also decoded at need to be decoded again,
+   and from there the speculative result can be used as is.
+   
+   The fix-up is serial but short, so the work happens in two parallel passes per wave of
+   chunks: decoding (to find the boundaries) and then formatting each chunk's real
+   instructions into its own buffer. The decoding pass keeps what it decoded, packed, so
+   formatting only expands the instructions the fix-up kept and never decodes anything. The buffers are written out in order, so the output
+   is identical to DisAsm8086Linear. */
+
+// NOTE: Each chunk's text buffer is sized by GetMaxOutputPerByte, so a chunk's text
+// always fits.
+static u32 const ParallelDisAsmChunkSize = 128*1024;
+
+static instruction DecodeAt(parallel_disasm *DisAsm, u64 Offset, disasm_stop *Stop)
+{
+    u64 Remaining = DisAsm->ByteCount - Offset;
+    instruction Result = DecodeInstructionFromBuffer(DisAsm->Table, Remaining, DisAsm->Bytes + Offset, DisAsm->Decode);
+    *Stop = GetDisAsmStop(Result, Remaining);
+    return Result;
+}
+
+static b32 IsMarked(u8 *Bits, u64 Bit)
+{
+    b32 Result = (Bits[Bit >> 3] >> (Bit & 7)) & 1;
+    return Result;
+}
+
+static void Mark(u8 *Bits, u64 Bit)
+{
+    Bits[Bit >> 3] |= (u8)(1 << (Bit & 7));
+}
+
+static void KeepInstruction(packed_instruction *Dest, instruction Instruction, u64 Offset)
+{
+    Instruction.Address = (u32)Offset;
+    *Dest = PackInstruction(Instruction);
+}
+
+static u32 FindSpeculated(disasm_chunk *Chunk, u64 Offset)
+{
+    // NOTE: Speculated is in address order, so this is a binary search for the first
+    // instruction at or after Offset.
+    u32 Low = 0;
+    u32 High = Chunk->SpeculatedCount;
+    while(Low < High)
+    {
+        u32 Mid = Low + (High - Low)/2;
+        if(Chunk->Speculated[Mid].Address < Offset)
+        {
+            Low = Mid + 1;
+        }
+        else
+        {
+            High = Mid;
+        }
+    }
+    
+    return Low;
+}
+
+static void SpeculateChunk(void *Context, u32, u32 ChunkIndex)
+{
+    parallel_disasm *DisAsm = (parallel_disasm *)Context;
+    disasm_chunk *Chunk = &DisAsm->Chunks[ChunkIndex];
+    
+    memset(Chunk->Boundaries, 0, ParallelDisAsmChunkSize/8 + 1);
+    memset(Chunk->Stops, 0, ParallelDisAsmChunkSize/8 + 1);
+    Chunk->SpeculatedCount = 0;
+    
+    u64 Offset = Chunk->SpeculativeStart;
+    while(Offset < Chunk->End)
+    {
+        u64 Bit = Offset - Chunk->SpeculativeStart;
+        Mark(Chunk->Boundaries, Bit);
+        
+        disasm_stop Stop;
+        instruction Instruction = DecodeAt(DisAsm, Offset, &Stop);
+        if(Stop)
+        {
+            // NOTE: A wrong guess often runs into bytes that do not decode. Giving up there
+            // would leave the rest of the chunk to the serial fix-up, so instead the stop is
+            // noted and decoding starts over on the next byte.
+            Mark(Chunk->Stops, Bit);
+            Offset += 1;
+        }
+        else
+        {
+            KeepInstruction(&Chunk->Speculated[Chunk->SpeculatedCount++], Instruction, Offset);
+            Offset += Instruction.Size;
+        }
+    }
+    
+    Chunk->SpeculativeExit = Offset;
+}
+
+static void ResyncChunk(parallel_disasm *DisAsm, disasm_chunk *Chunk)
+{
+    Chunk->ResyncCount = 0;
+    Chunk->ResyncedCount = 0;
+    Chunk->FirstKept = 0;
+    Chunk->EndKept = 0;
+    
+    u64 Offset = Chunk->Entry;
+    for(;;)
+    {
+        if(Offset >= Chunk->End)
+        {
+            Chunk->Exit = Offset;
+            Chunk->Stop = DisAsmStop_None;
+            break;
+        }
+        
+        u64 Bit = Offset - Chunk->SpeculativeStart;
+        if(IsMarked(Chunk->Boundaries, Bit))
+        {
+            // NOTE: From here on the real stream follows the speculative one, up to the
+            // first stop at or after this offset, if there is one.
+            Chunk->Exit = Chunk->SpeculativeExit;
+            Chunk->Stop = DisAsmStop_None;
+            
+            u64 BitCount = Chunk->End - Chunk->SpeculativeStart;
+            for(u64 StopBit = Bit; StopBit < BitCount; ++StopBit)
+            {
+                if(IsMarked(Chunk->Stops, StopBit))
+                {
+                    Chunk->Exit = Chunk->SpeculativeStart + StopBit;
+                    DecodeAt(DisAsm, Chunk->Exit, &Chunk->Stop);
+                    break;
+                }
+            }
+            
+            Chunk->FirstKept = FindSpeculated(Chunk, Offset);
+            Chunk->EndKept = FindSpeculated(Chunk, Chunk->Exit);
+            break;
+        }
+        
+        disasm_stop Stop;
+        instruction Instruction = DecodeAt(DisAsm, Offset, &Stop);
+        ++Chunk->ResyncCount;
+        if(Stop)
+        {
+            Chunk->Exit = Offset;
+            Chunk->Stop = Stop;
+            break;
+        }
+        
+        KeepInstruction(&Chunk->Resynced[Chunk->ResyncedCount++], Instruction, Offset);
+        Offset += Instruction.Size;
+    }
+}
+
+static void FormatChunk(void *Context, u32, u32 ChunkIndex)
+{
+    parallel_disasm *DisAsm = (parallel_disasm *)Context;
+    disasm_chunk *Chunk = &DisAsm->Chunks[ChunkIndex];
+    
+    Chunk->Text.Used = 0;
+    Chunk->Text.Overflowed = false;
+    
+    for(u32 Index = 0; Index < Chunk->ResyncedCount; ++Index)
+    {
+        AppendDisAsmInstruction(&Chunk->Text, DisAsm->Format, ExpandInstruction(Chunk->Resynced[Index]));
+    }
+    
+    for(u32 Index = Chunk->FirstKept; Index < Chunk->EndKept; ++Index)
+    {
+        AppendDisAsmInstruction(&Chunk->Text, DisAsm->Format, ExpandInstruction(Chunk->Speculated[Index]));
+    }
+}
+
+static disasm_stop DisAsm8086Parallel(u64 DisAsmByteCount, u8 *DisAsmStart, decode_instruction *Decode,
+                                      u32 ThreadCount, text_buffer *Output, output_format Format,
+                                      parallel_disasm_stats *Stats)
+{
+    f64 StartTime = GetWallClockSeconds();
+    
+    parallel_disasm DisAsm = {};
+    DisAsm.Table = Get8086InstructionTable();
+    DisAsm.Decode = Decode;
+    DisAsm.Format = Format;
+    DisAsm.ByteCount = DisAsmByteCount;
+    DisAsm.Bytes = DisAsmStart;
+    
+    // NOTE: Twice as many chunks as threads per wave, so a thread that finishes early can
+    // pick up another chunk instead of waiting on the slowest one.
+    u32 MaxChunkCount = 2*ThreadCount;
+    u32 BoundaryBytes = ParallelDisAsmChunkSize/8 + 1;
+    u32 TextBytes = GetMaxOutputPerByte(Format)*ParallelDisAsmChunkSize;
+    
+    // NOTE: Every decode advances by at least a byte, so neither pass can keep more
+    // instructions than the chunk has bytes.
+    u32 PackedCount = ParallelDisAsmChunkSize;
+    
+    disasm_stop Stop = DisAsmStop_None;
+    DisAsm.Chunks = (disasm_chunk *)calloc(MaxChunkCount, sizeof(disasm_chunk));
+    u8 *ChunkMemory = (u8 *)malloc((u64)MaxChunkCount*(2*BoundaryBytes + TextBytes));
+    packed_instruction *PackedMemory = (packed_instruction *)malloc((u64)MaxChunkCount*2*PackedCount*sizeof(packed_instruction));
+    if(DisAsm.Chunks && ChunkMemory && PackedMemory)
+    {
+        for(u32 ChunkIndex = 0; ChunkIndex < MaxChunkCount; ++ChunkIndex)
+        {
+            disasm_chunk *Chunk = &DisAsm.Chunks[ChunkIndex];
+            u8 *Memory = ChunkMemory + (u64)ChunkIndex*(2*BoundaryBytes + TextBytes);
+            Chunk->Boundaries = Memory;
+            Chunk->Stops = Memory + BoundaryBytes;
+            Chunk->Text = TextBuffer(TextBytes, (char *)(Memory + 2*BoundaryBytes));
+            Chunk->Speculated = PackedMemory + (u64)ChunkIndex*2*PackedCount;
+            Chunk->Resynced = Chunk->Speculated + PackedCount;
+        }
+        
+        u64 Entry = 0;
+        for(u64 WaveStart = 0; (WaveStart < DisAsmByteCount) && !Stop;)
+        {
+            DisAsm.ChunkCount = 0;
+            while((DisAsm.ChunkCount < MaxChunkCount) && (WaveStart < DisAsmByteCount))
+            {
+                disasm_chunk *Chunk = &DisAsm.Chunks[DisAsm.ChunkCount++];
+                Chunk->Start = WaveStart;
+                Chunk->End = WaveStart + ParallelDisAsmChunkSize;
+                if(Chunk->End > DisAsmByteCount)
+                {
+                    Chunk->End = DisAsmByteCount;
+                }
+                Chunk->SpeculativeStart = Chunk->Start;
+                WaveStart = Chunk->End;
+            }
+            
+            // NOTE: The entry point of the first chunk in the wave is already known, so it
+            // does not have to guess.
+            DisAsm.Chunks[0].SpeculativeStart = Entry;
+            RunInParallel(ThreadCount, DisAsm.ChunkCount, SpeculateChunk, &DisAsm);
+            
+            u32 PrintCount = 0;
+            while((PrintCount < DisAsm.ChunkCount) && !Stop)
+            {
+                disasm_chunk *Chunk = &DisAsm.Chunks[PrintCount++];
+                Chunk->Entry = Entry;
+                ResyncChunk(&DisAsm, Chunk);
+                
+                Entry = Chunk->Exit;
+                Stop = Chunk->Stop;
+                Stats->ResyncCount += Chunk->ResyncCount;
+            }
+            
+            RunInParallel(ThreadCount, PrintCount, FormatChunk, &DisAsm);
+            
+            for(u32 ChunkIndex = 0; ChunkIndex < PrintCount; ++ChunkIndex)
+            {
+                disasm_chunk *Chunk = &DisAsm.Chunks[ChunkIndex];
+                assert(!Chunk->Text.Overflowed);
+                AppendText(Output, Chunk->Text.Used, Chunk->Text.Memory);
+            }
+            
+            Stats->ChunkCount += PrintCount;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: Unable to allocate memory for parallel disassembly.\n");
+    }
+    
+    free(PackedMemory);
+    free(ChunkMemory);
+    free(DisAsm.Chunks);
+    
+    Stats->Seconds += GetWallClockSeconds() - StartTime;
+    
+    return Stop;
+}
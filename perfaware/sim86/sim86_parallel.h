@@ -0,0 +1,66 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+struct disasm_chunk
+{
+    // NOTE: The chunk covers [Start, End) of the image, but the instructions it prints are
+    // the ones that begin in [Entry, Exit), since an instruction can cross into the next chunk.
+    u64 Start;
+    u64 End;
+    
+    // NOTE: Speculative pass. Decoding starts at SpeculativeStart, which may be in the middle
+    // of an instruction, and every offset it decodes at is marked in Boundaries (one bit per
+    // byte from SpeculativeStart). Offsets that did not decode are also marked in Stops, and
+    // decoding carries on from the byte after them. Every instruction that did decode is
+    // kept, in address order, in Speculated.
+    u64 SpeculativeStart;
+    u64 SpeculativeExit;
+    u8 *Boundaries;
+    u8 *Stops;
+    packed_instruction *Speculated;
+    u32 SpeculatedCount;
+    
+    // NOTE: Fix-up pass. The real stream enters at Entry and is decoded serially until it
+    // lands on a marked offset, after which it must match the speculative decode. The
+    // instructions decoded before that are kept in Resynced, and the real instructions
+    // after it are Speculated[FirstKept, EndKept).
+    u64 Entry;
+    u64 Exit;
+    disasm_stop Stop;
+    u64 ResyncCount;
+    packed_instruction *Resynced;
+    u32 ResyncedCount;
+    u32 FirstKept;
+    u32 EndKept;
+    
+    // NOTE: Format pass.
+    text_buffer Text;
+};
+
+struct parallel_disasm
+{
+    instruction_table Table;
+    decode_instruction *Decode;
+    output_format Format;
+    u64 ByteCount;
+    u8 *Bytes;
+    
+    u32 ChunkCount;
+    disasm_chunk *Chunks;
+};
+
+struct parallel_disasm_stats
+{
+    u64 ChunkCount;
+    u64 ResyncCount;
+    f64 Seconds;
+};
@@ -0,0 +1,281 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Disassembly as three stages on their own threads, so that decoding, formatting and
+   writing the output all overlap. One thread decodes the image into batches of
+   instructions, several threads format batches into text, and one thread writes the text
+   out.
+   
+   Batches are dealt out to the format threads round robin, each through its own lane: a
+   ring of slots with one cursor per stage. The decoder fills a slot and advances Decoded,
+   the lane's format thread turns it into text and advances Formatted, and the writer
+   writes it and advances Written, which hands the slot back to the decoder. Since every
+   cursor has exactly one writer, the lanes need no locks. And since the writer visits the
+   lanes in the same round robin order, the output comes out in the same order as
+   DisAsm8086Linear without any reordering.
+   
+   A stage that finds the next stage's cursor has not moved yet spins on it (yielding),
+   and the time it spends doing that is its stall time.
+   
+   Every stage has to be running at once, so this needs RunInParallel to get all the
+   threads it asks for. */
+
+static u32 const PipelineBatchSize = 4096; // NOTE: Bytes of machine code per batch, give or take one instruction
+static u32 const PipelineSlotsPerLane = 4;
+static u32 const PipelineMaxInstructionSize = 16;
+
+static b32 WaitForCursor(pipeline_stage_stats *Stats, u64 volatile *Cursor, u64 Lead, u64 Target, u64 volatile *Finished)
+{
+    // NOTE: Waits until Cursor + Lead passes Target, and returns false if Finished is set
+    // first (the stage that owns Cursor will not move it again).
+    b32 Result = true;
+    if((LoadAcquire(Cursor) + Lead) <= Target)
+    {
+        u64 StallStart = ReadOSTimer();
+        for(;;)
+        {
+            // NOTE: Finished is read before Cursor, so that a cursor published right before
+            // its stage finished is never missed.
+            b32 WasFinished = (Finished && LoadAcquire(Finished));
+            if((LoadAcquire(Cursor) + Lead) > Target)
+            {
+                break;
+            }
+            
+            if(WasFinished)
+            {
+                Result = false;
+                break;
+            }
+            
+            YieldThread();
+        }
+        Stats->StallTime += ReadOSTimer() - StallStart;
+    }
+    
+    return Result;
+}
+
+static void DecodeStage(pipeline_disasm *DisAsm)
+{
+    pipeline_stage_stats *Stats = &DisAsm->DecodeStats;
+    
+    u64 Offset = 0;
+    for(u64 BatchIndex = 0; (Offset < DisAsm->ByteCount) && !DisAsm->Stop; ++BatchIndex)
+    {
+        pipeline_lane *Lane = &DisAsm->Lanes[BatchIndex % DisAsm->LaneCount];
+        WaitForCursor(Stats, &Lane->Written, PipelineSlotsPerLane, Lane->Decoded, 0);
+        
+        pipeline_slot *Slot = &Lane->Slots[Lane->Decoded % PipelineSlotsPerLane];
+        u64 BatchStart = Offset;
+        u32 Count = 0;
+        while((Offset < DisAsm->ByteCount) && ((Offset - BatchStart) < PipelineBatchSize))
+        {
+            u64 Remaining = DisAsm->ByteCount - Offset;
+            instruction Instruction = DecodeInstructionFromBuffer(DisAsm->Table, Remaining, DisAsm->Bytes + Offset, DisAsm->Decode);
+            DisAsm->Stop = GetDisAsmStop(Instruction, Remaining);
+            if(DisAsm->Stop)
+            {
+                break;
+            }
+            
+            Instruction.Address = (u32)Offset;
+            Slot->Instructions[Count++] = Instruction;
+            Offset += Instruction.Size;
+        }
+        
+        if(Count)
+        {
+            Slot->InstructionCount = Count;
+            Slot->ByteCount = Offset - BatchStart;
+            StoreRelease(&Lane->Decoded, Lane->Decoded + 1);
+            
+            ++Stats->BatchCount;
+            Stats->ByteCount += Slot->ByteCount;
+            Stats->InstructionCount += Count;
+        }
+    }
+    
+    StoreRelease(&DisAsm->DecodeFinished, true);
+}
+
+static void FormatStage(pipeline_disasm *DisAsm, pipeline_lane *Lane)
+{
+    pipeline_stage_stats *Stats = &Lane->FormatStats;
+    
+    while(WaitForCursor(Stats, &Lane->Decoded, 0, Lane->Formatted, &DisAsm->DecodeFinished))
+    {
+        pipeline_slot *Slot = &Lane->Slots[Lane->Formatted % PipelineSlotsPerLane];
+        Slot->Text.Used = 0;
+        for(u32 InstructionIndex = 0; InstructionIndex < Slot->InstructionCount; ++InstructionIndex)
+        {
+            AppendDisAsmInstruction(&Slot->Text, DisAsm->Format, Slot->Instructions[InstructionIndex]);
+        }
+        assert(!Slot->Text.Overflowed);
+        
+        ++Stats->BatchCount;
+        Stats->ByteCount += Slot->ByteCount;
+        Stats->InstructionCount += Slot->InstructionCount;
+        
+        StoreRelease(&Lane->Formatted, Lane->Formatted + 1);
+    }
+    
+    StoreRelease(&Lane->FormatFinished, true);
+}
+
+static void WriteStage(pipeline_disasm *DisAsm)
+{
+    pipeline_stage_stats *Stats = &DisAsm->WriteStats;
+    
+    // NOTE: Batches are dealt out round robin, so the first lane that runs out marks the
+    // end of the output.
+    for(u64 BatchIndex = 0;; ++BatchIndex)
+    {
+        pipeline_lane *Lane = &DisAsm->Lanes[BatchIndex % DisAsm->LaneCount];
+        if(!WaitForCursor(Stats, &Lane->Formatted, 0, Lane->Written, &Lane->FormatFinished))
+        {
+            break;
+        }
+        
+        pipeline_slot *Slot = &Lane->Slots[Lane->Written % PipelineSlotsPerLane];
+        AppendText(DisAsm->Output, Slot->Text.Used, Slot->Text.Memory);
+        
+        ++Stats->BatchCount;
+        Stats->ByteCount += Slot->ByteCount;
+        Stats->InstructionCount += Slot->InstructionCount;
+        
+        StoreRelease(&Lane->Written, Lane->Written + 1);
+    }
+}
+
+static void RunPipelineStage(void *Context, u32, u32 StageIndex)
+{
+    pipeline_disasm *DisAsm = (pipeline_disasm *)Context;
+    
+    u64 StartTime = ReadOSTimer();
+    pipeline_stage_stats *Stats = 0;
+    if(StageIndex == 0)
+    {
+        DecodeStage(DisAsm);
+        Stats = &DisAsm->DecodeStats;
+    }
+    else if(StageIndex == 1)
+    {
+        WriteStage(DisAsm);
+        Stats = &DisAsm->WriteStats;
+    }
+    else
+    {
+        pipeline_lane *Lane = &DisAsm->Lanes[StageIndex - 2];
+        FormatStage(DisAsm, Lane);
+        Stats = &Lane->FormatStats;
+    }
+    Stats->Time += ReadOSTimer() - StartTime;
+}
+
+static void Accumulate(pipeline_stage_stats *Dest, pipeline_stage_stats Source)
+{
+    Dest->BatchCount += Source.BatchCount;
+    Dest->ByteCount += Source.ByteCount;
+    Dest->InstructionCount += Source.InstructionCount;
+    Dest->Time += Source.Time;
+    Dest->StallTime += Source.StallTime;
+}
+
+static disasm_stop DisAsm8086Pipelined(u64 DisAsmByteCount, u8 *DisAsmStart, decode_instruction *Decode,
+                                       u32 FormatThreadCount, text_buffer *Output, output_format Format,
+                                       pipeline_disasm_stats *Stats)
+{
+    f64 StartTime = GetWallClockSeconds();
+    
+    pipeline_disasm DisAsm = {};
+    DisAsm.Table = Get8086InstructionTable();
+    DisAsm.Decode = Decode;
+    DisAsm.Format = Format;
+    DisAsm.ByteCount = DisAsmByteCount;
+    DisAsm.Bytes = DisAsmStart;
+    DisAsm.Output = Output;
+    DisAsm.LaneCount = FormatThreadCount;
+    
+    // NOTE: A batch ends once it reaches PipelineBatchSize bytes, so it holds at most that
+    // many instructions, and its last instruction can run up to one instruction past it.
+    u64 InstructionBytes = PipelineBatchSize*sizeof(instruction);
+    u32 TextBytes = GetMaxOutputPerByte(Format)*(PipelineBatchSize + PipelineMaxInstructionSize);
+    u64 SlotBytes = InstructionBytes + TextBytes;
+    u32 SlotCount = FormatThreadCount*PipelineSlotsPerLane;
+    
+    DisAsm.Lanes = (pipeline_lane *)calloc(FormatThreadCount, sizeof(pipeline_lane));
+    pipeline_slot *Slots = (pipeline_slot *)calloc(SlotCount, sizeof(pipeline_slot));
+    u8 *SlotMemory = (u8 *)malloc(SlotCount*SlotBytes);
+    if(DisAsm.Lanes && Slots && SlotMemory)
+    {
+        for(u32 SlotIndex = 0; SlotIndex < SlotCount; ++SlotIndex)
+        {
+            pipeline_slot *Slot = &Slots[SlotIndex];
+            u8 *Memory = SlotMemory + SlotIndex*SlotBytes;
+            Slot->Instructions = (instruction *)Memory;
+            Slot->Text = TextBuffer(TextBytes, (char *)(Memory + InstructionBytes));
+        }
+        
+        for(u32 LaneIndex = 0; LaneIndex < FormatThreadCount; ++LaneIndex)
+        {
+            DisAsm.Lanes[LaneIndex].Slots = Slots + LaneIndex*PipelineSlotsPerLane;
+        }
+        
+        RunInParallel(FormatThreadCount + 2, FormatThreadCount + 2, RunPipelineStage, &DisAsm);
+        
+        Stats->FormatThreadCount = FormatThreadCount;
+        Accumulate(&Stats->Decode, DisAsm.DecodeStats);
+        Accumulate(&Stats->Write, DisAsm.WriteStats);
+        for(u32 LaneIndex = 0; LaneIndex < FormatThreadCount; ++LaneIndex)
+        {
+            Accumulate(&Stats->Format, DisAsm.Lanes[LaneIndex].FormatStats);
+        }
+    }
+    else
+    {
+        fprintf(stderr, "ERROR: Unable to allocate memory for pipelined disassembly.\n");
+    }
+    
+    free(SlotMemory);
+    free(Slots);
+    free(DisAsm.Lanes);
+    
+    Stats->Seconds += GetWallClockSeconds() - StartTime;
+    
+    return DisAsm.Stop;
+}
+
+static void PrintPipelineStage(FILE *Dest, char const *Name, pipeline_stage_stats Stage, u32 ThreadCount)
+{
+    // NOTE: Throughput is per thread, over the time spent working rather than stalled, so
+    // it says how fast one thread of that stage goes when it never has to wait.
+    f64 Frequency = (f64)GetOSTimerFrequency();
+    f64 Seconds = (f64)Stage.Time / Frequency;
+    f64 StallSeconds = (f64)Stage.StallTime / Frequency;
+    f64 BusySeconds = Seconds - StallSeconds;
+    f64 MegabytesPerSecond = (BusySeconds > 0) ? ((f64)Stage.ByteCount / (1024.0*1024.0*BusySeconds)) : 0;
+    f64 StallPercent = (Seconds > 0) ? (100.0*StallSeconds / Seconds) : 0;
+    fprintf(Dest, "  %s (%u thread%s): %.1f MB/s per thread while busy, stalled %.3fs (%.0f%%)\n",
+            Name, ThreadCount, (ThreadCount == 1) ? "" : "s", MegabytesPerSecond, StallSeconds, StallPercent);
+}
+
+static void PrintPipelineStats(FILE *Dest, char const *FileName, u64 ImageSize, pipeline_disasm_stats *Stats)
+{
+    f64 MegabytesPerSecond = (Stats->Seconds > 0) ? ((f64)ImageSize / (1024.0*1024.0*Stats->Seconds)) : 0;
+    fprintf(Dest, "%s: %llu bytes, %.3fs (%.1f MB/s), %llu batches, %llu instructions\n",
+            FileName, ImageSize, Stats->Seconds, MegabytesPerSecond,
+            Stats->Decode.BatchCount, Stats->Decode.InstructionCount);
+    PrintPipelineStage(Dest, "decode", Stats->Decode, 1);
+    PrintPipelineStage(Dest, "format", Stats->Format, Stats->FormatThreadCount);
+    PrintPipelineStage(Dest, "write", Stats->Write, 1);
+}
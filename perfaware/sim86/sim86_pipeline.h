@@ -0,0 +1,70 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+struct pipeline_slot
+{
+    u64 ByteCount;
+    u32 InstructionCount;
+    instruction *Instructions;
+    text_buffer Text;
+};
+
+struct pipeline_stage_stats
+{
+    u64 BatchCount;
+    u64 ByteCount;
+    u64 InstructionCount;
+    u64 Time;
+    u64 StallTime;
+};
+
+struct pipeline_lane
+{
+    // NOTE: Each cursor counts the batches that have been through one stage, and is only
+    // ever written by that stage's thread. A batch's slot is its cursor value modulo
+    // PipelineSlotsPerLane.
+    u64 volatile Decoded;
+    u64 volatile Formatted;
+    u64 volatile Written;
+    u64 volatile FormatFinished;
+    
+    pipeline_slot *Slots;
+    pipeline_stage_stats FormatStats;
+};
+
+struct pipeline_disasm
+{
+    instruction_table Table;
+    decode_instruction *Decode;
+    output_format Format;
+    u64 ByteCount;
+    u8 *Bytes;
+    text_buffer *Output;
+    
+    u32 LaneCount;
+    pipeline_lane *Lanes;
+    
+    u64 volatile DecodeFinished;
+    disasm_stop Stop;
+    
+    pipeline_stage_stats DecodeStats;
+    pipeline_stage_stats WriteStats;
+};
+
+struct pipeline_disasm_stats
+{
+    u32 FormatThreadCount;
+    pipeline_stage_stats Decode;
+    pipeline_stage_stats Format; // NOTE: Summed over all the format threads
+    pipeline_stage_stats Write;
+    f64 Seconds;
+};
@@ -0,0 +1,387 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Everything that has to talk to the OS directly lives here, one implementation per
+   platform, so the rest of sim86 only ever uses the C runtime.
+   
+   Mapped files close their file handles as soon as the view exists, since the view alone
+   keeps the pages available. An empty file maps to a null Data with a Size of zero, because
+   neither OS will create a zero length mapping.
+   
+   ReadStandardInput returns as soon as any input is available, rather than waiting to fill
+   Dest the way fread does, and returns 0 only at the end of the input (or on an error).
+   
+   RunInParallel hands out JobIndex values 0..JobCount-1 to ThreadCount threads (the
+   calling thread being one of them) as each one finishes its previous job, and returns once
+   every job is done. Each job is also told which thread it is on (0..ThreadCount-1, with
+   the calling thread as 0), so jobs can use per-thread memory.
+   
+   LoadAcquire and StoreRelease are for values one thread publishes to others without a
+   lock: nothing written before a StoreRelease can be seen after it by a thread whose
+   LoadAcquire saw the new value. */
+
+struct parallel_work
+{
+    parallel_job *Job;
+    void *Context;
+    u32 JobCount;
+    u32 volatile NextJob;
+};
+
+struct parallel_worker
+{
+    parallel_work *Work;
+    u32 ThreadIndex;
+};
+
+static u32 TakeNextJob(parallel_work *Work);
+
+static void DoParallelWork(parallel_worker *Worker)
+{
+    parallel_work *Work = Worker->Work;
+    for(;;)
+    {
+        u32 JobIndex = TakeNextJob(Work);
+        if(JobIndex >= Work->JobCount)
+        {
+            break;
+        }
+        
+        Work->Job(Work->Context, Worker->ThreadIndex, JobIndex);
+    }
+}
+
+#if _WIN32
+
+static b32 MapFileReadOnly(char *FileName, mapped_file *Dest)
+{
+    b32 Result = false;
+    *Dest = {};
+    
+    HANDLE File = CreateFileA(FileName, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if(File != INVALID_HANDLE_VALUE)
+    {
+        LARGE_INTEGER Size;
+        if(GetFileSizeEx(File, &Size))
+        {
+            Dest->Size = (u64)Size.QuadPart;
+            if(Dest->Size)
+            {
+                HANDLE Mapping = CreateFileMappingA(File, 0, PAGE_READONLY, 0, 0, 0);
+                if(Mapping)
+                {
+                    Dest->Data = (u8 *)MapViewOfFile(Mapping, FILE_MAP_READ, 0, 0, 0);
+                    Result = (Dest->Data != 0);
+                    CloseHandle(Mapping);
+                }
+            }
+            else
+            {
+                Result = true;
+            }
+        }
+        
+        CloseHandle(File);
+    }
+    
+    if(!Result)
+    {
+        *Dest = {};
+    }
+    
+    return Result;
+}
+
+static void UnmapFile(mapped_file *File)
+{
+    if(File->Data)
+    {
+        UnmapViewOfFile(File->Data);
+    }
+    
+    *File = {};
+}
+
+static u8 *AllocateExecutableMemory(u64 Size)
+{
+    u8 *Result = (u8 *)VirtualAlloc(0, Size, MEM_RESERVE|MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+    return Result;
+}
+
+static void FreeExecutableMemory(u8 *Memory, u64 Size)
+{
+    if(Memory)
+    {
+        VirtualFree(Memory, 0, MEM_RELEASE);
+    }
+}
+
+static u32 ReadStandardInput(u32 Size, void *Dest)
+{
+    DWORD Result = 0;
+    if(!ReadFile(GetStdHandle(STD_INPUT_HANDLE), Dest, Size, &Result, 0))
+    {
+        // NOTE: A pipe whose writer has closed reports an error rather than a zero length
+        // read, but either way there is nothing more to read.
+        Result = 0;
+    }
+    
+    return Result;
+}
+
+static u32 TakeNextJob(parallel_work *Work)
+{
+    u32 Result = (u32)InterlockedIncrement((LONG volatile *)&Work->NextJob) - 1;
+    return Result;
+}
+
+static void YieldThread(void)
+{
+    SwitchToThread();
+}
+
+static u64 LoadAcquire(u64 volatile *Source)
+{
+    // NOTE: MSVC gives volatile accesses acquire and release semantics on x86 and x64.
+    u64 Result = *Source;
+    _ReadWriteBarrier();
+    return Result;
+}
+
+static void StoreRelease(u64 volatile *Dest, u64 Value)
+{
+    _ReadWriteBarrier();
+    *Dest = Value;
+}
+
+static DWORD WINAPI ParallelThreadProc(void *Param)
+{
+    DoParallelWork((parallel_worker *)Param);
+    return 0;
+}
+
+static void RunInParallel(u32 ThreadCount, u32 JobCount, parallel_job *Job, void *Context)
+{
+    parallel_work Work = {Job, Context, JobCount, 0};
+    parallel_worker Workers[256];
+    
+    HANDLE Threads[256];
+    u32 StartedCount = 0;
+    for(u32 ThreadIndex = 0; (ThreadIndex < ThreadCount) && (ThreadIndex < ArrayCount(Workers)); ++ThreadIndex)
+    {
+        Workers[ThreadIndex] = {&Work, ThreadIndex};
+        if(ThreadIndex)
+        {
+            HANDLE Thread = CreateThread(0, 0, ParallelThreadProc, &Workers[ThreadIndex], 0, 0);
+            if(Thread)
+            {
+                Threads[StartedCount++] = Thread;
+            }
+        }
+    }
+    
+    DoParallelWork(&Workers[0]);
+    
+    for(u32 ThreadIndex = 0; ThreadIndex < StartedCount; ++ThreadIndex)
+    {
+        WaitForSingleObject(Threads[ThreadIndex], INFINITE);
+        CloseHandle(Threads[ThreadIndex]);
+    }
+}
+
+static u64 GetOSTimerFrequency(void)
+{
+    LARGE_INTEGER Frequency;
+    QueryPerformanceFrequency(&Frequency);
+    return Frequency.QuadPart;
+}
+
+static u64 ReadOSTimer(void)
+{
+    LARGE_INTEGER Counter;
+    QueryPerformanceCounter(&Counter);
+    return Counter.QuadPart;
+}
+
+#else
+
+static b32 MapFileReadOnly(char *FileName, mapped_file *Dest)
+{
+    b32 Result = false;
+    *Dest = {};
+    
+    int File = open(FileName, O_RDONLY);
+    if(File >= 0)
+    {
+        struct stat Stat;
+        if(fstat(File, &Stat) == 0)
+        {
+            Dest->Size = (u64)Stat.st_size;
+            if(Dest->Size)
+            {
+                void *Data = mmap(0, Dest->Size, PROT_READ, MAP_PRIVATE, File, 0);
+                if(Data != MAP_FAILED)
+                {
+                    madvise(Data, Dest->Size, MADV_SEQUENTIAL);
+                    Dest->Data = (u8 *)Data;
+                    Result = true;
+                }
+            }
+            else
+            {
+                Result = true;
+            }
+        }
+        
+        close(File);
+    }
+    
+    if(!Result)
+    {
+        *Dest = {};
+    }
+    
+    return Result;
+}
+
+static void UnmapFile(mapped_file *File)
+{
+    if(File->Data)
+    {
+        munmap(File->Data, File->Size);
+    }
+    
+    *File = {};
+}
+
+static u8 *AllocateExecutableMemory(u64 Size)
+{
+    void *Result = mmap(0, Size, PROT_READ|PROT_WRITE|PROT_EXEC, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(Result == MAP_FAILED)
+    {
+        Result = 0;
+    }
+    
+    return (u8 *)Result;
+}
+
+static void FreeExecutableMemory(u8 *Memory, u64 Size)
+{
+    if(Memory)
+    {
+        munmap(Memory, Size);
+    }
+}
+
+static u32 ReadStandardInput(u32 Size, void *Dest)
+{
+    ssize_t Result;
+    do
+    {
+        Result = read(STDIN_FILENO, Dest, Size);
+    } while((Result < 0) && (errno == EINTR));
+    
+    if(Result < 0)
+    {
+        Result = 0;
+    }
+    
+    return (u32)Result;
+}
+
+static u32 TakeNextJob(parallel_work *Work)
+{
+    u32 Result = __sync_fetch_and_add(&Work->NextJob, 1);
+    return Result;
+}
+
+static void YieldThread(void)
+{
+    sched_yield();
+}
+
+static u64 LoadAcquire(u64 volatile *Source)
+{
+    u64 Result = __atomic_load_n(Source, __ATOMIC_ACQUIRE);
+    return Result;
+}
+
+static void StoreRelease(u64 volatile *Dest, u64 Value)
+{
+    __atomic_store_n(Dest, Value, __ATOMIC_RELEASE);
+}
+
+static void *ParallelThreadProc(void *Param)
+{
+    DoParallelWork((parallel_worker *)Param);
+    return 0;
+}
+
+static void RunInParallel(u32 ThreadCount, u32 JobCount, parallel_job *Job, void *Context)
+{
+    parallel_work Work = {Job, Context, JobCount, 0};
+    parallel_worker Workers[256];
+    
+    pthread_t Threads[256];
+    u32 StartedCount = 0;
+    for(u32 ThreadIndex = 0; (ThreadIndex < ThreadCount) && (ThreadIndex < ArrayCount(Workers)); ++ThreadIndex)
+    {
+        Workers[ThreadIndex] = {&Work, ThreadIndex};
+        if(ThreadIndex)
+        {
+            if(pthread_create(&Threads[StartedCount], 0, ParallelThreadProc, &Workers[ThreadIndex]) == 0)
+            {
+                ++StartedCount;
+            }
+        }
+    }
+    
+    DoParallelWork(&Workers[0]);
+    
+    for(u32 ThreadIndex = 0; ThreadIndex < StartedCount; ++ThreadIndex)
+    {
+        pthread_join(Threads[ThreadIndex], 0);
+    }
+}
+
+static u64 GetOSTimerFrequency(void)
+{
+    return 1000000000;
+}
+
+static u64 ReadOSTimer(void)
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    
+    u64 Result = GetOSTimerFrequency()*(u64)Time.tv_sec + (u64)Time.tv_nsec;
+    return Result;
+}
+
+#endif
+
+static force_inline u64 ReadCPUTimer(void)
+{
+    // NOTE: On anything without a time stamp counter, the OS timer stands in for it.
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return ReadOSTimer();
+#endif
+}
+
+static f64 GetWallClockSeconds(void)
+{
+    f64 Result = (f64)ReadOSTimer() / (f64)GetOSTimerFrequency();
+    return Result;
+}
@@ -0,0 +1,62 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+#if _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <intrin.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#if __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+struct mapped_file
+{
+    u8 *Data;
+    u64 Size;
+};
+
+static b32 MapFileReadOnly(char *FileName, mapped_file *Dest);
+static void UnmapFile(mapped_file *File);
+static u32 ReadStandardInput(u32 Size, void *Dest);
+
+// NOTE: Memory that can be written and then executed, for generated code. Returns 0 if the
+// OS will not hand out memory that is both.
+static u8 *AllocateExecutableMemory(u64 Size);
+static void FreeExecutableMemory(u8 *Memory, u64 Size);
+
+typedef void parallel_job(void *Context, u32 ThreadIndex, u32 JobIndex);
+
+static void RunInParallel(u32 ThreadCount, u32 JobCount, parallel_job *Job, void *Context);
+static void YieldThread(void);
+
+static u64 LoadAcquire(u64 volatile *Source);
+static void StoreRelease(u64 volatile *Dest, u64 Value);
+
+static u64 GetOSTimerFrequency(void);
+static u64 ReadOSTimer(void);
+static force_inline u64 ReadCPUTimer(void);
+static f64 GetWallClockSeconds(void);
@@ -0,0 +1,87 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+#if SIM86_PROFILER
+
+struct profiler
+{
+    u64 StartTSC;
+    u64 EndTSC;
+    u64 StartOSTime;
+    u64 EndOSTime;
+};
+static profiler GlobalProfiler;
+
+static void BeginProfile(void)
+{
+    GlobalProfiler.StartOSTime = ReadOSTimer();
+    GlobalProfiler.StartTSC = ReadCPUTimer();
+}
+
+static void PrintTimeElapsed(FILE *Dest, u64 TotalTSCElapsed, u64 TimerFreq, profile_anchor *Anchor)
+{
+    f64 Percent = 100.0 * ((f64)Anchor->TSCElapsedExclusive / (f64)TotalTSCElapsed);
+    fprintf(Dest, "  %s[%llu]: %llu (%.2f%%", Anchor->Label, Anchor->HitCount, Anchor->TSCElapsedExclusive, Percent);
+    if(Anchor->TSCElapsedInclusive != Anchor->TSCElapsedExclusive)
+    {
+        f64 PercentWithChildren = 100.0 * ((f64)Anchor->TSCElapsedInclusive / (f64)TotalTSCElapsed);
+        fprintf(Dest, ", %.2f%% w/children", PercentWithChildren);
+    }
+    fprintf(Dest, ")");
+    
+    if(Anchor->ProcessedByteCount && TimerFreq)
+    {
+        // NOTE: Throughput is over the inclusive time, since that is what it took to get
+        // through those bytes.
+        f64 Megabyte = 1024.0*1024.0;
+        
+        f64 Seconds = (f64)Anchor->TSCElapsedInclusive / (f64)TimerFreq;
+        f64 Megabytes = (f64)Anchor->ProcessedByteCount / Megabyte;
+        f64 MegabytesPerSecond = Megabytes / Seconds;
+        
+        fprintf(Dest, "  %.3fmb at %.2fmb/s", Megabytes, MegabytesPerSecond);
+    }
+    
+    fprintf(Dest, "\n");
+}
+
+static void EndAndPrintProfile(FILE *Dest)
+{
+    GlobalProfiler.EndTSC = ReadCPUTimer();
+    GlobalProfiler.EndOSTime = ReadOSTimer();
+    
+    // NOTE: The whole profiled run doubles as the measurement of the time stamp counter's
+    // rate, so there is no separate busy wait at the end.
+    u64 TotalCPUElapsed = GlobalProfiler.EndTSC - GlobalProfiler.StartTSC;
+    u64 TotalOSElapsed = GlobalProfiler.EndOSTime - GlobalProfiler.StartOSTime;
+    u64 CPUFreq = 0;
+    if(TotalOSElapsed)
+    {
+        CPUFreq = (u64)((f64)GetOSTimerFrequency() * (f64)TotalCPUElapsed / (f64)TotalOSElapsed);
+    }
+    
+    if(CPUFreq)
+    {
+        fprintf(Dest, "\nTotal time: %0.4fms (CPU freq %llu)\n", 1000.0 * (f64)TotalCPUElapsed / (f64)CPUFreq, CPUFreq);
+    }
+    
+    for(u32 AnchorIndex = 0; AnchorIndex < ArrayCount(GlobalProfilerAnchors); ++AnchorIndex)
+    {
+        profile_anchor *Anchor = GlobalProfilerAnchors + AnchorIndex;
+        if(Anchor->TSCElapsedInclusive)
+        {
+            PrintTimeElapsed(Dest, TotalCPUElapsed, CPUFreq, Anchor);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,105 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Profiling is compiled in with -DSIM86_PROFILER=1. Otherwise every macro below
+   expands to nothing, so the marked code is exactly what it would be without them.
+   
+   TimeFunction / TimeBlock(Name) time the rest of the enclosing scope. Each one gets its own
+   anchor at compile time (through __COUNTER__), so recording a hit is a couple of adds into
+   a fixed array, with no lookup, allocation or lock. Time is kept both inclusive of nested
+   blocks and exclusive of them, by having each block subtract its time from its parent's.
+   
+   CountProfileBytes adds to the byte count of the innermost block that is open, for blocks
+   whose size is only known once they have done their work.
+   
+   The anchors are per thread, so blocks run on worker threads (-j, --threads) do not race
+   with the main thread, but they are not included in the printed profile either. The
+   profiled build times the thread that calls BeginProfile. */
+
+#ifndef SIM86_PROFILER
+#define SIM86_PROFILER 0
+#endif
+
+#if SIM86_PROFILER
+
+struct profile_anchor
+{
+    u64 TSCElapsedExclusive;
+    u64 TSCElapsedInclusive;
+    u64 HitCount;
+    u64 ProcessedByteCount;
+    char const *Label;
+};
+
+// NOTE: Anchor 0 is never used by a block. It is the parent of the outermost blocks.
+static thread_local profile_anchor GlobalProfilerAnchors[256];
+static thread_local u32 GlobalProfilerParent;
+
+struct profile_block
+{
+    profile_block(char const *Label_, u32 AnchorIndex_)
+    {
+        ParentIndex = GlobalProfilerParent;
+        AnchorIndex = AnchorIndex_;
+        Label = Label_;
+        
+        // NOTE: A block that is re-entered (recursion) would otherwise count its time
+        // once per level, so the outermost entry's inclusive time is the one kept.
+        profile_anchor *Anchor = GlobalProfilerAnchors + AnchorIndex;
+        OldTSCElapsedInclusive = Anchor->TSCElapsedInclusive;
+        
+        GlobalProfilerParent = AnchorIndex;
+        StartTSC = ReadCPUTimer();
+    }
+    
+    ~profile_block()
+    {
+        u64 Elapsed = ReadCPUTimer() - StartTSC;
+        GlobalProfilerParent = ParentIndex;
+        
+        profile_anchor *Parent = GlobalProfilerAnchors + ParentIndex;
+        profile_anchor *Anchor = GlobalProfilerAnchors + AnchorIndex;
+        
+        Parent->TSCElapsedExclusive -= Elapsed;
+        Anchor->TSCElapsedExclusive += Elapsed;
+        Anchor->TSCElapsedInclusive = OldTSCElapsedInclusive + Elapsed;
+        ++Anchor->HitCount;
+        Anchor->Label = Label;
+    }
+    
+    char const *Label;
+    u64 OldTSCElapsedInclusive;
+    u64 StartTSC;
+    u32 ParentIndex;
+    u32 AnchorIndex;
+};
+
+#define ProfileNameConcat2(A, B) A##B
+#define ProfileNameConcat(A, B) ProfileNameConcat2(A, B)
+#define TimeBlock(Name) profile_block ProfileNameConcat(Block, __LINE__)(Name, __COUNTER__ + 1)
+#define TimeFunction TimeBlock(__func__)
+#define CountProfileBytes(ByteCount) (GlobalProfilerAnchors[GlobalProfilerParent].ProcessedByteCount += (ByteCount))
+#define ProfilerEndOfCompilationUnit static_assert(__COUNTER__ < ArrayCount(GlobalProfilerAnchors), "Number of profile points exceeds the size of GlobalProfilerAnchors")
+
+static void BeginProfile(void);
+static void EndAndPrintProfile(FILE *Dest);
+
+#else
+
+#define TimeBlock(...)
+#define TimeFunction
+#define CountProfileBytes(...)
+#define ProfilerEndOfCompilationUnit
+#define BeginProfile(...)
+#define EndAndPrintProfile(...)
+
+#endif
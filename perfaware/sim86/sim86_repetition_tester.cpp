@@ -0,0 +1,237 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: A test is repeated until it has gone TryForTime without setting a new minimum. The
+   minimum is the number to watch for regressions, since it is the run least disturbed by
+   everything else on the machine. Max and mean are printed alongside it so that noisy
+   runs can be recognized as such. */
+
+static f64 SecondsFromCPUTime(f64 CPUTime, u64 CPUTimerFreq)
+{
+    f64 Result = 0.0;
+    if(CPUTimerFreq)
+    {
+        Result = CPUTime / (f64)CPUTimerFreq;
+    }
+    
+    return Result;
+}
+
+static void PrintTime(char const *Label, f64 CPUTime, u64 CPUTimerFreq, u64 ByteCount, u64 InstructionCount)
+{
+    printf("%s: %.0f", Label, CPUTime);
+    if(CPUTimerFreq)
+    {
+        f64 Seconds = SecondsFromCPUTime(CPUTime, CPUTimerFreq);
+        printf(" (%fms)", 1000.0f*Seconds);
+        
+        if(Seconds > 0)
+        {
+            if(ByteCount)
+            {
+                f64 Gigabyte = (1024.0f * 1024.0f * 1024.0f);
+                f64 BestBandwidth = (f64)ByteCount / (Gigabyte * Seconds);
+                printf(" %fgb/s", BestBandwidth);
+            }
+            
+            if(InstructionCount)
+            {
+                f64 InstructionsPerSecond = (f64)InstructionCount / Seconds;
+                printf(" %.2fM instructions/s %.1f cycles/instruction",
+                       InstructionsPerSecond / 1000000.0, CPUTime / (f64)InstructionCount);
+            }
+        }
+    }
+}
+
+static void PrintTime(char const *Label, u64 CPUTime, u64 CPUTimerFreq, u64 ByteCount, u64 InstructionCount)
+{
+    PrintTime(Label, (f64)CPUTime, CPUTimerFreq, ByteCount, InstructionCount);
+}
+
+static void PrintResults(repetition_test_results Results, u64 CPUTimerFreq, u64 ByteCount, u64 InstructionCount)
+{
+    PrintTime("Min", (f64)Results.MinTime, CPUTimerFreq, ByteCount, InstructionCount);
+    printf("\n");
+    
+    PrintTime("Max", (f64)Results.MaxTime, CPUTimerFreq, ByteCount, InstructionCount);
+    printf("\n");
+    
+    if(Results.TestCount)
+    {
+        PrintTime("Avg", (f64)Results.TotalTime / (f64)Results.TestCount, CPUTimerFreq, ByteCount, InstructionCount);
+        printf("\n");
+    }
+}
+
+static void Error(repetition_tester *Tester, char const *Message)
+{
+    Tester->Mode = TestMode_Error;
+    fprintf(stderr, "ERROR: %s\n", Message);
+}
+
+static void NewTestWave(repetition_tester *Tester, u64 TargetProcessedByteCount, u64 TargetInstructionCount,
+                        u64 CPUTimerFreq, u32 SecondsToTry)
+{
+    if(Tester->Mode == TestMode_Uninitialized)
+    {
+        Tester->Mode = TestMode_Testing;
+        Tester->TargetProcessedByteCount = TargetProcessedByteCount;
+        Tester->TargetInstructionCount = TargetInstructionCount;
+        Tester->CPUTimerFreq = CPUTimerFreq;
+        Tester->PrintNewMinimums = true;
+        Tester->Results.MinTime = (u64)-1;
+    }
+    else if(Tester->Mode == TestMode_Completed)
+    {
+        Tester->Mode = TestMode_Testing;
+        
+        if(Tester->TargetProcessedByteCount != TargetProcessedByteCount)
+        {
+            Error(Tester, "TargetProcessedByteCount changed");
+        }
+        
+        if(Tester->TargetInstructionCount != TargetInstructionCount)
+        {
+            Error(Tester, "TargetInstructionCount changed");
+        }
+        
+        if(Tester->CPUTimerFreq != CPUTimerFreq)
+        {
+            Error(Tester, "CPU frequency changed");
+        }
+    }
+    
+    Tester->TryForTime = SecondsToTry*CPUTimerFreq;
+    Tester->TestsStartedAt = ReadCPUTimer();
+}
+
+static void BeginTime(repetition_tester *Tester)
+{
+    ++Tester->OpenBlockCount;
+    
+    // NOTE: The counters are read outside the timed region on both ends, so that the
+    // syscalls to read them are not charged to the test.
+    if(Tester->Counters)
+    {
+        Tester->CountersAtBeginTime = ReadPerfCounters(Tester->Counters);
+    }
+    
+    Tester->TimeAccumulatedOnThisTest -= ReadCPUTimer();
+}
+
+static void EndTime(repetition_tester *Tester)
+{
+    Tester->TimeAccumulatedOnThisTest += ReadCPUTimer();
+    
+    if(Tester->Counters)
+    {
+        perf_counter_values CountersAtEndTime = ReadPerfCounters(Tester->Counters);
+        Tester->CountersAccumulatedOnThisTest = Tester->CountersAccumulatedOnThisTest +
+            (CountersAtEndTime - Tester->CountersAtBeginTime);
+    }
+    
+    ++Tester->CloseBlockCount;
+}
+
+static void CountBytes(repetition_tester *Tester, u64 ByteCount)
+{
+    Tester->BytesAccumulatedOnThisTest += ByteCount;
+}
+
+static void CountInstructions(repetition_tester *Tester, u64 InstructionCount)
+{
+    Tester->InstructionsAccumulatedOnThisTest += InstructionCount;
+}
+
+static b32 IsTesting(repetition_tester *Tester)
+{
+    if(Tester->Mode == TestMode_Testing)
+    {
+        u64 CurrentTime = ReadCPUTimer();
+        
+        // NOTE: Nothing is checked until at least one BeginTime/EndTime pair has happened,
+        // so that the first call (before the test has run at all) does not count.
+        if(Tester->OpenBlockCount)
+        {
+            if(Tester->OpenBlockCount != Tester->CloseBlockCount)
+            {
+                Error(Tester, "Unbalanced BeginTime/EndTime");
+            }
+            
+            if(Tester->BytesAccumulatedOnThisTest != Tester->TargetProcessedByteCount)
+            {
+                Error(Tester, "Processed byte count mismatch");
+            }
+            
+            if(Tester->InstructionsAccumulatedOnThisTest != Tester->TargetInstructionCount)
+            {
+                Error(Tester, "Instruction count mismatch");
+            }
+            
+            if(Tester->Mode == TestMode_Testing)
+            {
+                repetition_test_results *Results = &Tester->Results;
+                u64 ElapsedTime = Tester->TimeAccumulatedOnThisTest;
+                Results->TestCount += 1;
+                Results->TotalTime += ElapsedTime;
+                if(Results->MaxTime < ElapsedTime)
+                {
+                    Results->MaxTime = ElapsedTime;
+                }
+                
+                if(Results->MinTime > ElapsedTime)
+                {
+                    Results->MinTime = ElapsedTime;
+                    Results->MinTimeCounters = Tester->CountersAccumulatedOnThisTest;
+                    
+                    // NOTE: Any new minimum restarts the clock, so testing only stops once
+                    // the result has held steady for the whole TryForTime.
+                    Tester->TestsStartedAt = CurrentTime;
+                    
+                    if(Tester->PrintNewMinimums)
+                    {
+                        PrintTime("Min", Results->MinTime, Tester->CPUTimerFreq,
+                                  Tester->TargetProcessedByteCount, Tester->TargetInstructionCount);
+                        printf("               \r");
+                        fflush(stdout);
+                    }
+                }
+                
+                Tester->OpenBlockCount = 0;
+                Tester->CloseBlockCount = 0;
+                Tester->TimeAccumulatedOnThisTest = 0;
+                Tester->BytesAccumulatedOnThisTest = 0;
+                Tester->InstructionsAccumulatedOnThisTest = 0;
+                Tester->CountersAccumulatedOnThisTest = {};
+            }
+        }
+        
+        if((CurrentTime - Tester->TestsStartedAt) > Tester->TryForTime)
+        {
+            Tester->Mode = TestMode_Completed;
+            
+            printf("                                                                                                  \r");
+            PrintResults(Tester->Results, Tester->CPUTimerFreq, Tester->TargetProcessedByteCount,
+                         Tester->TargetInstructionCount);
+            
+            if(Tester->Counters)
+            {
+                printf("Counters on the Min run:\n");
+                PrintPerfCounters(stdout, Tester->Counters, Tester->Results.MinTimeCounters, Tester->TargetInstructionCount);
+            }
+        }
+    }
+    
+    b32 Result = (Tester->Mode == TestMode_Testing);
+    return Result;
+}
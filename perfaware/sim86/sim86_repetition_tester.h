@@ -0,0 +1,67 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+enum test_mode : u32
+{
+    TestMode_Uninitialized,
+    TestMode_Testing,
+    TestMode_Completed,
+    TestMode_Error,
+};
+
+struct repetition_test_results
+{
+    u64 TestCount;
+    u64 TotalTime;
+    u64 MaxTime;
+    u64 MinTime;
+    
+    // NOTE: Counters are kept for the fastest run only, to match the time that gets quoted.
+    perf_counter_values MinTimeCounters;
+};
+
+struct repetition_tester
+{
+    // NOTE: Every repetition must process exactly this much, so that a test which quietly
+    // did less work (and so looks faster) is caught rather than reported.
+    u64 TargetProcessedByteCount;
+    u64 TargetInstructionCount;
+    
+    u64 CPUTimerFreq;
+    u64 TryForTime;
+    
+    // NOTE: Optional. When set, the hardware counters are read at every BeginTime/EndTime
+    // alongside the CPU timer.
+    perf_counters *Counters;
+    u64 TestsStartedAt;
+    
+    test_mode Mode;
+    b32 PrintNewMinimums;
+    u32 OpenBlockCount;
+    u32 CloseBlockCount;
+    u64 TimeAccumulatedOnThisTest;
+    u64 BytesAccumulatedOnThisTest;
+    u64 InstructionsAccumulatedOnThisTest;
+    perf_counter_values CountersAtBeginTime;
+    perf_counter_values CountersAccumulatedOnThisTest;
+    
+    repetition_test_results Results;
+};
+
+static void NewTestWave(repetition_tester *Tester, u64 TargetProcessedByteCount, u64 TargetInstructionCount,
+                        u64 CPUTimerFreq, u32 SecondsToTry = 10);
+static b32 IsTesting(repetition_tester *Tester);
+static void BeginTime(repetition_tester *Tester);
+static void EndTime(repetition_tester *Tester);
+static void CountBytes(repetition_tester *Tester, u64 ByteCount);
+static void CountInstructions(repetition_tester *Tester, u64 InstructionCount);
+static void PrintResults(repetition_test_results Results, u64 CPUTimerFreq, u64 ByteCount, u64 InstructionCount);
@@ -19,45 +19,165 @@ char const *OpcodeMnemonics[] =
 #include "sim86_instruction_table.inl"
 };
 
-static char const *GetMnemonic(operation_type Op)
+static u8 const OpcodeMnemonicLengths[] =
 {
-    char const *Result = "";
-    if(Op < Op_Count)
+    0,
+
+#define INST(Mnemonic, ...) sizeof(#Mnemonic) - 1,
+#define INSTALT(...)
+#include "sim86_instruction_table.inl"
+};
+
+struct text_span
+{
+    char const *Data;
+    u32 Length;
+};
+
+#define TEXT_SPAN(String) {String, sizeof(String) - 1}
+
+static text_span const RegisterNames[][3] =
+{
+    {TEXT_SPAN(""), TEXT_SPAN(""), TEXT_SPAN("")},
+    {TEXT_SPAN("al"), TEXT_SPAN("ah"), TEXT_SPAN("ax")},
+    {TEXT_SPAN("bl"), TEXT_SPAN("bh"), TEXT_SPAN("bx")},
+    {TEXT_SPAN("cl"), TEXT_SPAN("ch"), TEXT_SPAN("cx")},
+    {TEXT_SPAN("dl"), TEXT_SPAN("dh"), TEXT_SPAN("dx")},
+    {TEXT_SPAN("sp"), TEXT_SPAN("sp"), TEXT_SPAN("sp")},
+    {TEXT_SPAN("bp"), TEXT_SPAN("bp"), TEXT_SPAN("bp")},
+    {TEXT_SPAN("si"), TEXT_SPAN("si"), TEXT_SPAN("si")},
+    {TEXT_SPAN("di"), TEXT_SPAN("di"), TEXT_SPAN("di")},
+    {TEXT_SPAN("es"), TEXT_SPAN("es"), TEXT_SPAN("es")},
+    {TEXT_SPAN("cs"), TEXT_SPAN("cs"), TEXT_SPAN("cs")},
+    {TEXT_SPAN("ss"), TEXT_SPAN("ss"), TEXT_SPAN("ss")},
+    {TEXT_SPAN("ds"), TEXT_SPAN("ds"), TEXT_SPAN("ds")},
+    {TEXT_SPAN("ip"), TEXT_SPAN("ip"), TEXT_SPAN("ip")},
+    {TEXT_SPAN("flags"), TEXT_SPAN("flags"), TEXT_SPAN("flags")}
+};
+
+static text_span GetRegNameSpan(register_access Reg)
+{
+    text_span Result = RegisterNames[Reg.Index % ArrayCount(RegisterNames)][(Reg.Count == 2) ? 2 : Reg.Offset&1];
+    return Result;
+}
+
+#if SIM86_TEXT_FORMATTING
+
+static text_buffer TextBuffer(u32 Size, char *Memory, FILE *FlushTo)
+{
+    text_buffer Result = {};
+    
+    Result.Memory = Memory;
+    Result.Size = Size;
+    Result.FlushTo = FlushTo;
+    
+    return Result;
+}
+
+static void FlushTextBuffer(text_buffer *Buffer)
+{
+    if(Buffer->FlushTo && Buffer->Used)
     {
-        Result = OpcodeMnemonics[Op];
+        fwrite(Buffer->Memory, 1, Buffer->Used, Buffer->FlushTo);
+        Buffer->Used = 0;
+    }
+}
+
+static char *ReserveText(text_buffer *Buffer, u32 Count)
+{
+    char *Result = 0;
+    
+    if((Buffer->Size - Buffer->Used) < Count)
+    {
+        FlushTextBuffer(Buffer);
+    }
+    
+    if((Buffer->Size - Buffer->Used) >= Count)
+    {
+        Result = Buffer->Memory + Buffer->Used;
+        Buffer->Used += Count;
+    }
+    else
+    {
+        Buffer->Overflowed = true;
     }
     
     return Result;
 }
 
-static char const *GetRegName(register_access Reg)
-{
-    char const *Names[][3] =
-    {
-        {"", "", ""},
-        {"al", "ah", "ax"},
-        {"bl", "bh", "bx"},
-        {"cl", "ch", "cx"},
-        {"dl", "dh", "dx"},
-        {"sp", "sp", "sp"},
-        {"bp", "bp", "bp"},
-        {"si", "si", "si"},
-        {"di", "di", "di"},
-        {"es", "es", "es"},
-        {"cs", "cs", "cs"},
-        {"ss", "ss", "ss"},
-        {"ds", "ds", "ds"},
-        {"ip", "ip", "ip"},
-        {"flags", "flags", "flags"}
-    };
+static void AppendText(text_buffer *Buffer, u32 Count, char const *Text)
+{
+    if(Buffer->FlushTo && (Count > Buffer->Size))
+    {
+        // NOTE: Too big for the buffer even when empty, so it goes straight to the file.
+        FlushTextBuffer(Buffer);
+        fwrite(Text, 1, Count, Buffer->FlushTo);
+    }
+    else
+    {
+        char *Dest = ReserveText(Buffer, Count);
+        if(Dest)
+        {
+            memcpy(Dest, Text, Count);
+        }
+    }
+}
+
+static void AppendText(text_buffer *Buffer, text_span Span)
+{
+    AppendText(Buffer, Span.Length, Span.Data);
+}
+
+static void AppendString(text_buffer *Buffer, char const *String)
+{
+    AppendText(Buffer, (u32)strlen(String), String);
+}
+
+static void AppendChar(text_buffer *Buffer, char Char)
+{
+    char *Dest = ReserveText(Buffer, 1);
+    if(Dest)
+    {
+        *Dest = Char;
+    }
+}
+
+static void AppendU32(text_buffer *Buffer, u32 Value)
+{
+    // NOTE: Digits are produced least significant first, so they are written backwards
+    // into the end of Digits and then copied out in one go.
+    char Digits[10];
+    u32 Start = ArrayCount(Digits);
+    do
+    {
+        Digits[--Start] = (char)('0' + (Value % 10));
+        Value /= 10;
+    } while(Value);
     
-    char const *Result = Names[Reg.Index % ArrayCount(Names)][(Reg.Count == 2) ? 2 : Reg.Offset&1];
-    return Result;
+    AppendText(Buffer, ArrayCount(Digits) - Start, Digits + Start);
 }
 
-static void PrintEffectiveAddressExpression(effective_address_expression Address, FILE *Dest)
+static void AppendS32(text_buffer *Buffer, s32 Value, b32 ForceSign)
 {
-    char const *Separator = "";
+    // NOTE: Matches printf's %d, or %+d if ForceSign is set.
+    if(Value < 0)
+    {
+        AppendChar(Buffer, '-');
+        AppendU32(Buffer, 0 - (u32)Value);
+    }
+    else
+    {
+        if(ForceSign)
+        {
+            AppendChar(Buffer, '+');
+        }
+        AppendU32(Buffer, (u32)Value);
+    }
+}
+
+static void FormatEffectiveAddressExpression(text_buffer *Buffer, effective_address_expression Address)
+{
+    b32 NeedSeparator = false;
     for(u32 Index = 0; Index < ArrayCount(Address.Terms); ++Index)
     {
         effective_address_term Term = Address.Terms[Index];
@@ -65,24 +185,30 @@ static void PrintEffectiveAddressExpression(effective_address_expression Address
         
         if(Reg.Index)
         {
-            fprintf(Dest, "%s", Separator);
+            if(NeedSeparator)
+            {
+                AppendChar(Buffer, '+');
+            }
             if(Term.Scale != 1)
             {
-                fprintf(Dest, "%d*", Term.Scale);
+                AppendS32(Buffer, Term.Scale);
+                AppendChar(Buffer, '*');
             }
-            fprintf(Dest, "%s", GetRegName(Reg));
-            Separator = "+";
+            AppendText(Buffer, GetRegNameSpan(Reg));
+            NeedSeparator = true;
         }
     }
     
     if(Address.Displacement != 0)
     {
-        fprintf(Dest, "%+d", Address.Displacement);
+        AppendS32(Buffer, Address.Displacement, true);
     }
 }
 
-static void PrintInstruction(instruction Instruction, FILE *Dest)
+static void FormatInstruction(text_buffer *Buffer, instruction Instruction)
 {
+    TimeFunction;
+    
     u32 Flags = Instruction.Flags;
     u32 W = Flags & Inst_Wide;
     
@@ -95,26 +221,44 @@ static void PrintInstruction(instruction Instruction, FILE *Dest)
             Instruction.Operands[0] = Instruction.Operands[1];
             Instruction.Operands[1] = Temp;
         }
-        fprintf(Dest, "lock ");
+        AppendText(Buffer, TEXT_SPAN("lock "));
     }
     
-    char const *MnemonicSuffix = "";
+    char MnemonicSuffix = 0;
     if(Flags & Inst_Rep)
     {
-        fprintf(Dest, "rep ");
-        MnemonicSuffix = W ? "w" : "b";
+        if(Flags & Inst_RepNE)
+        {
+            AppendText(Buffer, TEXT_SPAN("repne "));
+        }
+        else
+        {
+            AppendText(Buffer, TEXT_SPAN("rep "));
+        }
+        MnemonicSuffix = W ? 'w' : 'b';
     }
     
-    fprintf(Dest, "%s%s ", GetMnemonic(Instruction.Op), MnemonicSuffix);
+    if(Instruction.Op < Op_Count)
+    {
+        AppendText(Buffer, OpcodeMnemonicLengths[Instruction.Op], OpcodeMnemonics[Instruction.Op]);
+    }
+    if(MnemonicSuffix)
+    {
+        AppendChar(Buffer, MnemonicSuffix);
+    }
+    AppendChar(Buffer, ' ');
     
-    char const *Separator = "";
+    b32 NeedSeparator = false;
     for(u32 OperandIndex = 0; OperandIndex < ArrayCount(Instruction.Operands); ++OperandIndex)
     {
         instruction_operand Operand = Instruction.Operands[OperandIndex];
         if(Operand.Type != Operand_None)
         {
-            fprintf(Dest, "%s", Separator);
-            Separator = ", ";
+            if(NeedSeparator)
+            {
+                AppendText(Buffer, TEXT_SPAN(", "));
+            }
+            NeedSeparator = true;
             
             switch(Operand.Type)
             {
@@ -122,7 +266,7 @@ static void PrintInstruction(instruction Instruction, FILE *Dest)
                 
                 case Operand_Register:
                 {
-                    fprintf(Dest, "%s", GetRegName(Operand.Register));
+                    AppendText(Buffer, GetRegNameSpan(Operand.Register));
                 } break;
                 
                 case Operand_Memory:
@@ -131,28 +275,216 @@ static void PrintInstruction(instruction Instruction, FILE *Dest)
 
                     if(Flags & Inst_Far)
                     {
-                        fprintf(Dest, "far ");
+                        AppendText(Buffer, TEXT_SPAN("far "));
                     }
                     
                     if(Address.Flags & Address_ExplicitSegment)
                     {
-                        fprintf(Dest, "%u:%u", Address.ExplicitSegment, Address.Displacement);
+                        AppendU32(Buffer, Address.ExplicitSegment);
+                        AppendChar(Buffer, ':');
+                        AppendU32(Buffer, (u32)Address.Displacement);
                     }
                     else
                     {
                         if(Instruction.Operands[0].Type != Operand_Register)
                         {
-                            fprintf(Dest, "%s ", W ? "word" : "byte");
+                            if(W)
+                            {
+                                AppendText(Buffer, TEXT_SPAN("word "));
+                            }
+                            else
+                            {
+                                AppendText(Buffer, TEXT_SPAN("byte "));
+                            }
                         }
                         
                         if(Flags & Inst_Segment)
                         {
-                            fprintf(Dest, "%s:", GetRegName({Instruction.SegmentOverride, 0, 2}));
+                            AppendText(Buffer, GetRegNameSpan({Instruction.SegmentOverride, 0, 2}));
+                            AppendChar(Buffer, ':');
+                        }
+                        
+                        AppendChar(Buffer, '[');
+                        FormatEffectiveAddressExpression(Buffer, Address);
+                        AppendChar(Buffer, ']');
+                    }
+                } break;
+                
+                case Operand_Immediate:
+                {
+                    immediate Immediate = Operand.Immediate;
+                    if(Immediate.Flags & Immediate_RelativeJumpDisplacement)
+                    {
+                        AppendChar(Buffer, '$');
+                        AppendS32(Buffer, (s32)(Immediate.Value + Instruction.Size), true);
+                    }
+                    else
+                    {
+                        AppendS32(Buffer, Immediate.Value);
+                    }
+                } break;
+            }
+        }
+    }
+}
+
+static void AppendFileHeader(text_buffer *Output, char const *FileName)
+{
+    AppendText(Output, TEXT_SPAN("; "));
+    AppendString(Output, FileName);
+    AppendText(Output, TEXT_SPAN(" disassembly:\n"));
+    AppendText(Output, TEXT_SPAN("bits 16\n"));
+}
+
+#if SIM86_TEXT_JSON
+
+static void AppendJSONString(text_buffer *Buffer, char const *String)
+{
+    AppendChar(Buffer, '"');
+    for(char const *At = String; *At; ++At)
+    {
+        char Char = *At;
+        if((Char == '"') || (Char == '\\'))
+        {
+            AppendChar(Buffer, '\\');
+            AppendChar(Buffer, Char);
+        }
+        else if((u8)Char < 0x20)
+        {
+            char const Hex[] = "0123456789abcdef";
+            AppendText(Buffer, TEXT_SPAN("\\u00"));
+            AppendChar(Buffer, Hex[(u8)Char >> 4]);
+            AppendChar(Buffer, Hex[(u8)Char & 0xf]);
+        }
+        else
+        {
+            AppendChar(Buffer, Char);
+        }
+    }
+    AppendChar(Buffer, '"');
+}
+
+static void AppendJSONName(text_buffer *Buffer, text_span Name)
+{
+    AppendChar(Buffer, '"');
+    AppendText(Buffer, Name);
+    AppendChar(Buffer, '"');
+}
+
+static void FormatInstructionJSON(text_buffer *Buffer, instruction Instruction)
+{
+    /* NOTE: One object per instruction, on one line, with no whitespace:
+       
+           {"address":0,"size":3,"op":"mov","flags":["wide"],"operands":[...]}
+       
+       where each operand is one of
+       
+           {"register":"ax"}
+           {"memory":{"terms":["bx","si"],"displacement":-4,"segment":"es"}}
+           {"far":{"segment":4660,"offset":22136}}
+           {"immediate":12}
+           {"relative":-2}    (a jump displacement, from the end of the instruction)
+       
+       Names are the ones the text output uses. Unlike the text output, nothing is
+       rearranged for the assembler's sake, so operands are in decode order. */
+    
+    u32 Flags = Instruction.Flags;
+    
+    AppendText(Buffer, TEXT_SPAN("{\"address\":"));
+    AppendU32(Buffer, Instruction.Address);
+    AppendText(Buffer, TEXT_SPAN(",\"size\":"));
+    AppendU32(Buffer, Instruction.Size);
+    AppendText(Buffer, TEXT_SPAN(",\"op\":\""));
+    if(Instruction.Op < Op_Count)
+    {
+        AppendText(Buffer, OpcodeMnemonicLengths[Instruction.Op], OpcodeMnemonics[Instruction.Op]);
+    }
+    AppendText(Buffer, TEXT_SPAN("\",\"flags\":["));
+    
+    text_span const FlagNames[] =
+    {
+        TEXT_SPAN("lock"),
+        TEXT_SPAN("rep"),
+        TEXT_SPAN("segment"),
+        TEXT_SPAN("wide"),
+        TEXT_SPAN("far"),
+        TEXT_SPAN("repne"),
+    };
+    b32 NeedSeparator = false;
+    for(u32 FlagIndex = 0; FlagIndex < ArrayCount(FlagNames); ++FlagIndex)
+    {
+        if(Flags & (1 << FlagIndex))
+        {
+            if(NeedSeparator)
+            {
+                AppendChar(Buffer, ',');
+            }
+            AppendJSONName(Buffer, FlagNames[FlagIndex]);
+            NeedSeparator = true;
+        }
+    }
+    
+    AppendText(Buffer, TEXT_SPAN("],\"operands\":["));
+    NeedSeparator = false;
+    for(u32 OperandIndex = 0; OperandIndex < ArrayCount(Instruction.Operands); ++OperandIndex)
+    {
+        instruction_operand Operand = Instruction.Operands[OperandIndex];
+        if(Operand.Type != Operand_None)
+        {
+            if(NeedSeparator)
+            {
+                AppendChar(Buffer, ',');
+            }
+            NeedSeparator = true;
+            
+            switch(Operand.Type)
+            {
+                case Operand_None: {} break;
+                
+                case Operand_Register:
+                {
+                    AppendText(Buffer, TEXT_SPAN("{\"register\":"));
+                    AppendJSONName(Buffer, GetRegNameSpan(Operand.Register));
+                    AppendChar(Buffer, '}');
+                } break;
+                
+                case Operand_Memory:
+                {
+                    effective_address_expression Address = Operand.Address;
+                    if(Address.Flags & Address_ExplicitSegment)
+                    {
+                        AppendText(Buffer, TEXT_SPAN("{\"far\":{\"segment\":"));
+                        AppendU32(Buffer, Address.ExplicitSegment);
+                        AppendText(Buffer, TEXT_SPAN(",\"offset\":"));
+                        AppendU32(Buffer, (u32)Address.Displacement);
+                        AppendText(Buffer, TEXT_SPAN("}}"));
+                    }
+                    else
+                    {
+                        AppendText(Buffer, TEXT_SPAN("{\"memory\":{\"terms\":["));
+                        b32 NeedTermSeparator = false;
+                        for(u32 Index = 0; Index < ArrayCount(Address.Terms); ++Index)
+                        {
+                            register_access Reg = Address.Terms[Index].Register;
+                            if(Reg.Index)
+                            {
+                                if(NeedTermSeparator)
+                                {
+                                    AppendChar(Buffer, ',');
+                                }
+                                AppendJSONName(Buffer, GetRegNameSpan(Reg));
+                                NeedTermSeparator = true;
+                            }
                         }
+                        AppendText(Buffer, TEXT_SPAN("],\"displacement\":"));
+                        AppendS32(Buffer, Address.Displacement);
                         
-                        fprintf(Dest, "[");
-                        PrintEffectiveAddressExpression(Address, Dest);
-                        fprintf(Dest, "]");
+                        if(Flags & Inst_Segment)
+                        {
+                            AppendText(Buffer, TEXT_SPAN(",\"segment\":"));
+                            AppendJSONName(Buffer, GetRegNameSpan({Instruction.SegmentOverride, 0, 2}));
+                        }
+                        AppendText(Buffer, TEXT_SPAN("}}"));
                     }
                 } break;
                 
@@ -161,14 +493,22 @@ static void PrintInstruction(instruction Instruction, FILE *Dest)
                     immediate Immediate = Operand.Immediate;
                     if(Immediate.Flags & Immediate_RelativeJumpDisplacement)
                     {
-                        fprintf(Dest, "$%+d", Immediate.Value + Instruction.Size);
+                        AppendText(Buffer, TEXT_SPAN("{\"relative\":"));
                     }
                     else
                     {
-                        fprintf(Dest, "%d", Immediate.Value);
+                        AppendText(Buffer, TEXT_SPAN("{\"immediate\":"));
                     }
+                    AppendS32(Buffer, Immediate.Value);
+                    AppendChar(Buffer, '}');
                 } break;
             }
         }
     }
+    
+    AppendText(Buffer, TEXT_SPAN("]}"));
 }
+
+#endif
+
+#endif
@@ -10,4 +10,48 @@
    
    ======================================================================== */
 
-static void PrintInstruction(instruction Instruction, FILE *Dest);
+/* NOTE: A program that only needs mnemonic and register names (sim86_lib) builds with
+   SIM86_TEXT_FORMATTING=0, which leaves out everything that formats into a text_buffer.
+   A program that never writes --format=json/jsonl output builds with SIM86_TEXT_JSON=0,
+   which leaves out just the JSON formatter. */
+
+#ifndef SIM86_TEXT_FORMATTING
+#define SIM86_TEXT_FORMATTING 1
+#endif
+
+#ifndef SIM86_TEXT_JSON
+#define SIM86_TEXT_JSON SIM86_TEXT_FORMATTING
+#endif
+
+struct text_buffer
+{
+    // NOTE: Text is formatted into Memory. When it fills up, it is written to FlushTo in one
+    // fwrite, or if there is no FlushTo, anything that does not fit is dropped and Overflowed
+    // is set, so the same formatter can fill a caller's buffer or stream to a file.
+    char *Memory;
+    u32 Size;
+    u32 Used;
+    FILE *FlushTo;
+    b32 Overflowed;
+};
+
+#if SIM86_TEXT_FORMATTING
+
+static text_buffer TextBuffer(u32 Size, char *Memory, FILE *FlushTo = 0);
+static void FlushTextBuffer(text_buffer *Buffer);
+
+static void AppendText(text_buffer *Buffer, u32 Count, char const *Text);
+static void AppendString(text_buffer *Buffer, char const *String);
+static void AppendChar(text_buffer *Buffer, char Char);
+static void AppendU32(text_buffer *Buffer, u32 Value);
+static void AppendS32(text_buffer *Buffer, s32 Value, b32 ForceSign = false);
+
+static void FormatInstruction(text_buffer *Buffer, instruction Instruction);
+static void AppendFileHeader(text_buffer *Output, char const *FileName);
+
+#if SIM86_TEXT_JSON
+static void AppendJSONString(text_buffer *Buffer, char const *String);
+static void FormatInstructionJSON(text_buffer *Buffer, instruction Instruction);
+#endif
+
+#endif
@@ -0,0 +1,298 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIM86_COMPUTED_GOTO 1
+#else
+#define SIM86_COMPUTED_GOTO 0
+#endif
+
+static void *GetRegisterPointer(cpu_8086 *CPU, register_access Reg)
+{
+    void *Result = (u8 *)&CPU->Registers[Reg.Index] + Reg.Offset;
+    return Result;
+}
+
+static b32 BindOperand(cpu_8086 *CPU, threaded_op *Op, instruction_operand Operand, b32 Wide, void **Dest)
+{
+    b32 Result = false;
+    if((Operand.Type == Operand_Register) && (Operand.Register.Count == (Wide ? 2u : 1u)))
+    {
+        *Dest = GetRegisterPointer(CPU, Operand.Register);
+        Result = true;
+    }
+    else if(Operand.Type == Operand_Immediate)
+    {
+        // NOTE: 8-bit forms read the low byte, which is the first one on a little-endian host.
+        Op->Immediate = (u16)(Operand.Immediate.Value & GetWidthMask(Wide));
+        *Dest = &Op->Immediate;
+        Result = true;
+    }
+    
+    return Result;
+}
+
+static threaded_handler GetRegisterFormHandler(operation_type Op, b32 Wide)
+{
+    threaded_handler Result = Threaded_Generic;
+    switch(Op)
+    {
+        case Op_mov: {Result = Wide ? Threaded_Mov16 : Threaded_Mov8;} break;
+        case Op_add: {Result = Wide ? Threaded_Add16 : Threaded_Add8;} break;
+        case Op_adc: {Result = Wide ? Threaded_Adc16 : Threaded_Adc8;} break;
+        case Op_sub: {Result = Wide ? Threaded_Sub16 : Threaded_Sub8;} break;
+        case Op_sbb: {Result = Wide ? Threaded_Sbb16 : Threaded_Sbb8;} break;
+        case Op_cmp: {Result = Wide ? Threaded_Cmp16 : Threaded_Cmp8;} break;
+        case Op_and: {Result = Wide ? Threaded_And16 : Threaded_And8;} break;
+        case Op_or: {Result = Wide ? Threaded_Or16 : Threaded_Or8;} break;
+        case Op_xor: {Result = Wide ? Threaded_Xor16 : Threaded_Xor8;} break;
+        case Op_test: {Result = Wide ? Threaded_Test16 : Threaded_Test8;} break;
+        case Op_inc: {Result = Wide ? Threaded_Inc16 : Threaded_Inc8;} break;
+        case Op_dec: {Result = Wide ? Threaded_Dec16 : Threaded_Dec8;} break;
+        default: {} break;
+    }
+    
+    return Result;
+}
+
+static void BuildThreadedOp(cpu_8086 *CPU, instruction *Instruction, threaded_op *Op)
+{
+    // NOTE: Built in place, since immediate operands are bound to the op's own Immediate.
+    *Op = {};
+    Op->Handler = Threaded_Generic;
+    Op->Size = (u8)Instruction->Size;
+    Op->Instruction = Instruction;
+    
+    b32 Wide = (Instruction->Flags & Inst_Wide);
+    instruction_operand Dest = Instruction->Operands[0];
+    instruction_operand Source = Instruction->Operands[1];
+    if(Dest.Type == Operand_None)
+    {
+        // NOTE: One-register forms, as in ExecuteInstruction.
+        Dest = Source;
+        Source = {};
+    }
+    
+    switch(Instruction->Op)
+    {
+        case Op_mov: case Op_add: case Op_adc: case Op_sub: case Op_sbb: case Op_cmp:
+        case Op_and: case Op_or: case Op_xor: case Op_test:
+        {
+            // NOTE: Anything with a memory operand (or a segment prefix, lock and so on that
+            // only matter to one) stays generic.
+            if((Dest.Type == Operand_Register) &&
+               BindOperand(CPU, Op, Dest, Wide, &Op->Dest) &&
+               BindOperand(CPU, Op, Source, Wide, &Op->Source))
+            {
+                Op->Handler = GetRegisterFormHandler(Instruction->Op, Wide);
+            }
+        } break;
+        
+        case Op_inc:
+        case Op_dec:
+        {
+            if((Dest.Type == Operand_Register) && BindOperand(CPU, Op, Dest, Wide, &Op->Dest))
+            {
+                Op->Handler = GetRegisterFormHandler(Instruction->Op, Wide);
+            }
+        } break;
+        
+        case Op_jmp:
+        case Op_je: case Op_jne: case Op_jl: case Op_jnl: case Op_jle: case Op_jg: case Op_jb: case Op_jnb:
+        case Op_jbe: case Op_ja: case Op_jp: case Op_jnp: case Op_jo: case Op_jno: case Op_js: case Op_jns:
+        case Op_loop:
+        case Op_jcxz:
+        {
+            // NOTE: Only relative targets are immediates (far jumps to a fixed address decode
+            // as memory operands).
+            if(Dest.Type == Operand_Immediate)
+            {
+                Op->Immediate = (u16)Dest.Immediate.Value;
+                switch(Instruction->Op)
+                {
+                    case Op_jmp: {Op->Handler = Threaded_Jmp;} break;
+                    case Op_loop: {Op->Handler = Threaded_Loop;} break;
+                    case Op_jcxz: {Op->Handler = Threaded_Jcxz;} break;
+                    default: {Op->Handler = Threaded_Jcc;} break;
+                }
+            }
+        } break;
+        
+        default: {} break;
+    }
+}
+
+static void BuildThreadedBlock(threaded_code *Threaded, block_cache *Cache, cached_block *Block, cpu_8086 *CPU)
+{
+    threaded_stats *Stats = &Threaded->Stats;
+    
+    threaded_op *Ops = Threaded->Ops + Block->FirstInstruction;
+    instruction *Instructions = Cache->Instructions + Block->FirstInstruction;
+    for(u32 InstructionIndex = 0; InstructionIndex < Block->InstructionCount; ++InstructionIndex)
+    {
+        BuildThreadedOp(CPU, &Instructions[InstructionIndex], &Ops[InstructionIndex]);
+        if(Ops[InstructionIndex].Handler == Threaded_Generic)
+        {
+            ++Stats->GenericInstructions;
+        }
+    }
+    Ops[Block->InstructionCount] = {};
+    
+    ++Stats->BlocksBuilt;
+    Stats->InstructionsBuilt += Block->InstructionCount;
+    Block->Threaded = true;
+}
+
+/* NOTE: Every handler is both a case of the switch and, with computed goto, a label of its
+   own. ThreadedHandler moves ip past the instruction (the End op has a Size of zero), and
+   ThreadedNext moves on to the next op, either by jumping straight to its handler or by going
+   back around to the switch. */
+#if SIM86_COMPUTED_GOTO
+#define ThreadedHandler(Name) case Threaded_##Name: Handle_##Name: CPU->Registers[Register_ip] += Op->Size;
+#define ThreadedNext ++Op; goto *Handlers[Op->Handler]
+#else
+#define ThreadedHandler(Name) case Threaded_##Name: CPU->Registers[Register_ip] += Op->Size;
+#define ThreadedNext ++Op; break
+#endif
+
+#define ThreadedReg16(Pointer) (*(u16 *)(Pointer))
+#define ThreadedReg8(Pointer) (*(u8 *)(Pointer))
+
+static execute_stop RunThreadedBlock(threaded_code *Threaded, block_cache *Cache, cached_block *Block, cpu_8086 *CPU,
+                                     u32 InstructionIndex)
+{
+    execute_stop Result = ExecuteStop_None;
+    
+#if SIM86_COMPUTED_GOTO
+    // NOTE: In the same order as threaded_handler.
+    static void *Handlers[Threaded_HandlerCount] =
+    {
+        &&Handle_End, &&Handle_Generic,
+        &&Handle_Mov16, &&Handle_Mov8, &&Handle_Add16, &&Handle_Add8, &&Handle_Adc16, &&Handle_Adc8,
+        &&Handle_Sub16, &&Handle_Sub8, &&Handle_Sbb16, &&Handle_Sbb8, &&Handle_Cmp16, &&Handle_Cmp8,
+        &&Handle_And16, &&Handle_And8, &&Handle_Or16, &&Handle_Or8, &&Handle_Xor16, &&Handle_Xor8,
+        &&Handle_Test16, &&Handle_Test8, &&Handle_Inc16, &&Handle_Inc8, &&Handle_Dec16, &&Handle_Dec8,
+        &&Handle_Jmp, &&Handle_Jcc, &&Handle_Loop, &&Handle_Jcxz,
+    };
+#endif
+    
+    if(!Block->Threaded)
+    {
+        BuildThreadedBlock(Threaded, Cache, Block, CPU);
+    }
+    
+    u32 Generation = Cache->Generation;
+    threaded_op *FirstOp = Threaded->Ops + Block->FirstInstruction + InstructionIndex;
+    threaded_op *Op = FirstOp;
+    u16 *Registers = CPU->Registers;
+    
+    for(;;)
+    {
+        switch(Op->Handler)
+        {
+            ThreadedHandler(End)
+            {
+                goto Done;
+            }
+            
+            ThreadedHandler(Generic)
+            {
+                // NOTE: As in ExecuteBlock, the rest of the block may be stale once anything
+                // invalidates cached code.
+                Result = ExecuteInstruction(CPU, Op->Instruction);
+                if(Result || (Cache->Generation != Generation))
+                {
+                    ++Op;
+                    goto Done;
+                }
+            } ThreadedNext;
+            
+            ThreadedHandler(Mov16) {ThreadedReg16(Op->Dest) = ThreadedReg16(Op->Source);} ThreadedNext;
+            ThreadedHandler(Mov8) {ThreadedReg8(Op->Dest) = ThreadedReg8(Op->Source);} ThreadedNext;
+            
+            ThreadedHandler(Add16) {ThreadedReg16(Op->Dest) = (u16)Add(CPU, true, ThreadedReg16(Op->Dest), ThreadedReg16(Op->Source), 0);} ThreadedNext;
+            ThreadedHandler(Add8) {ThreadedReg8(Op->Dest) = (u8)Add(CPU, false, ThreadedReg8(Op->Dest), ThreadedReg8(Op->Source), 0);} ThreadedNext;
+            ThreadedHandler(Adc16) {ThreadedReg16(Op->Dest) = (u16)Add(CPU, true, ThreadedReg16(Op->Dest), ThreadedReg16(Op->Source), GetCarry(CPU));} ThreadedNext;
+            ThreadedHandler(Adc8) {ThreadedReg8(Op->Dest) = (u8)Add(CPU, false, ThreadedReg8(Op->Dest), ThreadedReg8(Op->Source), GetCarry(CPU));} ThreadedNext;
+            
+            ThreadedHandler(Sub16) {ThreadedReg16(Op->Dest) = (u16)Subtract(CPU, true, ThreadedReg16(Op->Dest), ThreadedReg16(Op->Source), 0);} ThreadedNext;
+            ThreadedHandler(Sub8) {ThreadedReg8(Op->Dest) = (u8)Subtract(CPU, false, ThreadedReg8(Op->Dest), ThreadedReg8(Op->Source), 0);} ThreadedNext;
+            ThreadedHandler(Sbb16) {ThreadedReg16(Op->Dest) = (u16)Subtract(CPU, true, ThreadedReg16(Op->Dest), ThreadedReg16(Op->Source), GetCarry(CPU));} ThreadedNext;
+            ThreadedHandler(Sbb8) {ThreadedReg8(Op->Dest) = (u8)Subtract(CPU, false, ThreadedReg8(Op->Dest), ThreadedReg8(Op->Source), GetCarry(CPU));} ThreadedNext;
+            ThreadedHandler(Cmp16) {Subtract(CPU, true, ThreadedReg16(Op->Dest), ThreadedReg16(Op->Source), 0);} ThreadedNext;
+            ThreadedHandler(Cmp8) {Subtract(CPU, false, ThreadedReg8(Op->Dest), ThreadedReg8(Op->Source), 0);} ThreadedNext;
+            
+            ThreadedHandler(And16) {ThreadedReg16(Op->Dest) = (u16)Logic(CPU, true, ThreadedReg16(Op->Dest) & ThreadedReg16(Op->Source));} ThreadedNext;
+            ThreadedHandler(And8) {ThreadedReg8(Op->Dest) = (u8)Logic(CPU, false, ThreadedReg8(Op->Dest) & ThreadedReg8(Op->Source));} ThreadedNext;
+            ThreadedHandler(Or16) {ThreadedReg16(Op->Dest) = (u16)Logic(CPU, true, ThreadedReg16(Op->Dest) | ThreadedReg16(Op->Source));} ThreadedNext;
+            ThreadedHandler(Or8) {ThreadedReg8(Op->Dest) = (u8)Logic(CPU, false, ThreadedReg8(Op->Dest) | ThreadedReg8(Op->Source));} ThreadedNext;
+            ThreadedHandler(Xor16) {ThreadedReg16(Op->Dest) = (u16)Logic(CPU, true, ThreadedReg16(Op->Dest) ^ ThreadedReg16(Op->Source));} ThreadedNext;
+            ThreadedHandler(Xor8) {ThreadedReg8(Op->Dest) = (u8)Logic(CPU, false, ThreadedReg8(Op->Dest) ^ ThreadedReg8(Op->Source));} ThreadedNext;
+            ThreadedHandler(Test16) {Logic(CPU, true, ThreadedReg16(Op->Dest) & ThreadedReg16(Op->Source));} ThreadedNext;
+            ThreadedHandler(Test8) {Logic(CPU, false, ThreadedReg8(Op->Dest) & ThreadedReg8(Op->Source));} ThreadedNext;
+            
+            ThreadedHandler(Inc16) {ThreadedReg16(Op->Dest) = (u16)IncrementOrDecrement(CPU, true, true, ThreadedReg16(Op->Dest));} ThreadedNext;
+            ThreadedHandler(Inc8) {ThreadedReg8(Op->Dest) = (u8)IncrementOrDecrement(CPU, true, false, ThreadedReg8(Op->Dest));} ThreadedNext;
+            ThreadedHandler(Dec16) {ThreadedReg16(Op->Dest) = (u16)IncrementOrDecrement(CPU, false, true, ThreadedReg16(Op->Dest));} ThreadedNext;
+            ThreadedHandler(Dec8) {ThreadedReg8(Op->Dest) = (u8)IncrementOrDecrement(CPU, false, false, ThreadedReg8(Op->Dest));} ThreadedNext;
+            
+            ThreadedHandler(Jmp)
+            {
+                Registers[Register_ip] += Op->Immediate;
+            } ThreadedNext;
+            
+            ThreadedHandler(Jcc)
+            {
+                if(IsConditionMet(CPU, Op->Instruction->Op))
+                {
+                    Registers[Register_ip] += Op->Immediate;
+                }
+            } ThreadedNext;
+            
+            ThreadedHandler(Loop)
+            {
+                if(--Registers[Register_c])
+                {
+                    Registers[Register_ip] += Op->Immediate;
+                }
+            } ThreadedNext;
+            
+            ThreadedHandler(Jcxz)
+            {
+                if(Registers[Register_c] == 0)
+                {
+                    Registers[Register_ip] += Op->Immediate;
+                }
+            } ThreadedNext;
+            
+            default: {goto Done;}
+        }
+    }
+    
+Done:
+    CPU->InstructionCount += (u64)(Op - FirstOp);
+    
+    return Result;
+}
+
+#undef ThreadedHandler
+#undef ThreadedNext
+#undef ThreadedReg16
+#undef ThreadedReg8
+
+static void PrintThreadedStats(FILE *Dest, char const *FileName, threaded_stats *Stats)
+{
+    f64 GenericPercent = Stats->InstructionsBuilt ? (100.0*(f64)Stats->GenericInstructions / (f64)Stats->InstructionsBuilt) : 0;
+    fprintf(Dest, "%s: threaded code for %llu blocks (%llu instructions) built, %.2f%% of instructions with the generic handler (%s dispatch)\n",
+            FileName, Stats->BlocksBuilt, Stats->InstructionsBuilt, GenericPercent,
+            SIM86_COMPUTED_GOTO ? "computed goto" : "switch");
+}
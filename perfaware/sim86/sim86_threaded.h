@@ -0,0 +1,83 @@
+/* ========================================================================
+
+   (C) Copyright 2023 by Molly Rocket, Inc., All Rights Reserved.
+   
+   This software is provided 'as-is', without any express or implied
+   warranty. In no event will the authors be held liable for any damages
+   arising from the use of this software.
+   
+   Please see https://computerenhance.com for more information
+   
+   ======================================================================== */
+
+/* NOTE: Threaded code for the executor. The first time a cached block runs this way, each of
+   its decoded instructions is turned into a threaded_op: the handler for that particular
+   form of the instruction, with its operands already resolved to pointers (a register in
+   the CPU, or the op's own immediate). Running the block then goes straight from one
+   handler to the next, and with GCC or Clang each handler ends in its own computed goto to
+   the next one, so the host's branch predictor sees one indirect branch per handler instead
+   of one shared by every instruction. Other compilers dispatch the same handlers through a
+   switch.
+   
+   Only register and immediate forms of the common instructions, and the relative jumps and
+   loops that end blocks, get their own handlers. Everything else is run by a generic
+   handler that hands the decoded instruction to ExecuteInstruction, which is also the only
+   handler that can stop the block early (when the instruction stops execution, or writes to
+   cached code).
+   
+   Operands are bound to the registers of the CPU that first runs the block, which is fine
+   since Execute8086 resets the block cache before every run. */
+
+enum threaded_handler : u8
+{
+    Threaded_End, // NOTE: Follows the last instruction of every block
+    Threaded_Generic,
+    
+    Threaded_Mov16, Threaded_Mov8,
+    Threaded_Add16, Threaded_Add8,
+    Threaded_Adc16, Threaded_Adc8,
+    Threaded_Sub16, Threaded_Sub8,
+    Threaded_Sbb16, Threaded_Sbb8,
+    Threaded_Cmp16, Threaded_Cmp8,
+    Threaded_And16, Threaded_And8,
+    Threaded_Or16, Threaded_Or8,
+    Threaded_Xor16, Threaded_Xor8,
+    Threaded_Test16, Threaded_Test8,
+    Threaded_Inc16, Threaded_Inc8,
+    Threaded_Dec16, Threaded_Dec8,
+    
+    Threaded_Jmp,
+    Threaded_Jcc,
+    Threaded_Loop,
+    Threaded_Jcxz,
+    
+    Threaded_HandlerCount,
+};
+
+struct threaded_op
+{
+    threaded_handler Handler;
+    u8 Size; // NOTE: How far ip moves before the instruction runs
+    u16 Immediate; // NOTE: The source for immediate forms, and the displacement for jumps
+    void *Dest;
+    void *Source;
+    instruction *Instruction;
+};
+
+struct threaded_stats
+{
+    u64 BlocksBuilt;
+    u64 InstructionsBuilt;
+    u64 GenericInstructions; // NOTE: Built with the generic handler
+};
+
+struct threaded_code
+{
+    // NOTE: Indexed the same way as the block cache's Instructions.
+    threaded_op Ops[BlockCacheInstructionCount];
+    threaded_stats Stats;
+};
+
+static execute_stop RunThreadedBlock(threaded_code *Threaded, block_cache *Cache, cached_block *Block, cpu_8086 *CPU,
+                                     u32 InstructionIndex);
+static void PrintThreadedStats(FILE *Dest, char const *FileName, threaded_stats *Stats);